@@ -0,0 +1,189 @@
+#include "AllocationProfiler.h"
+#include "Urho3DAliases.h"
+#include <cassert>
+
+AllocationProfiler::AllocationProfiler(Context* context) :
+    Object(context)
+{
+    for (unsigned i = 0; i < MAX_ALLOCATION_SITES; i++)
+    {
+        windowCounts_[i] = 0;
+        windowBytes_[i] = 0;
+    }
+}
+
+AllocationProfiler::~AllocationProfiler()
+{
+    EnableAllocationSites(false);
+}
+
+bool AllocationProfiler::Start(bool strict)
+{
+    // Без подсчета счетчики нулевые и проверка strict проходила бы всегда.
+    if (!IsAllocationTrackingEnabled())
+    {
+        URHO3D_LOGERROR("Allocation profiler requires a build with SOULMATES_TRACK_ALLOCATIONS");
+        return false;
+    }
+
+    strict_ = strict;
+    EnableAllocationSites(true);
+    windowStart_ = Time::GetSystemTime();
+
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(AllocationProfiler, HandleBeginFrame));
+    SubscribeToEvent(E_KEYDOWN, URHO3D_HANDLER(AllocationProfiler, HandleInput));
+    SubscribeToEvent(E_KEYUP, URHO3D_HANDLER(AllocationProfiler, HandleInput));
+    SubscribeToEvent(E_MOUSEBUTTONDOWN, URHO3D_HANDLER(AllocationProfiler, HandleInput));
+    SubscribeToEvent(E_MOUSEBUTTONUP, URHO3D_HANDLER(AllocationProfiler, HandleInput));
+    SubscribeToEvent(E_MOUSEMOVE, URHO3D_HANDLER(AllocationProfiler, HandleInput));
+    SubscribeToEvent(E_MOUSEWHEEL, URHO3D_HANDLER(AllocationProfiler, HandleInput));
+    SubscribeToEvent(E_TOUCHBEGIN, URHO3D_HANDLER(AllocationProfiler, HandleInput));
+    SubscribeToEvent(E_TOUCHEND, URHO3D_HANDLER(AllocationProfiler, HandleInput));
+
+    URHO3D_LOGINFO(String("Allocation profiler started") + (strict_ ? " (strict)" : ""));
+    return true;
+}
+
+void AllocationProfiler::BeginMeasure()
+{
+    GetAllocationSites(frameStart_);
+    frameStartCount_ = GetAllocationCount();
+    frameStartBytes_ = GetAllocatedBytes();
+    frameStartThreadCount_ = GetThreadAllocationCount();
+}
+
+bool AllocationProfiler::IsQuietFrame() const
+{
+    if (inputThisFrame_ || BOARD_LOGIC->needBreakUpdate_)
+        return false;
+
+    if (GLOBAL->gameState_ != GLOBAL->neededGameState_)
+        return false;
+
+    // Отладочный худ обновляет свои надписи каждый кадр.
+    DebugHud* debugHud = DEBUG_HUD;
+    return !debugHud || debugHud->GetMode() == DEBUGHUD_SHOW_NONE;
+}
+
+void AllocationProfiler::FinishFrame()
+{
+    // Выделения главного потока берутся до того, как профайлер сам что-то выделит.
+    unsigned long long mainThreadAllocs = GetThreadAllocationCount() - frameStartThreadCount_;
+    unsigned long long allocs = GetAllocationCount() - frameStartCount_;
+    unsigned long long bytes = GetAllocatedBytes() - frameStartBytes_;
+    GetAllocationSites(frameEnd_);
+
+    unsigned long long frameCounts[MAX_ALLOCATION_SITES];
+    unsigned long long frameBytes[MAX_ALLOCATION_SITES];
+    for (unsigned i = 0; i < MAX_ALLOCATION_SITES; i++)
+    {
+        frameCounts[i] = frameEnd_[i].count_ - frameStart_[i].count_;
+        frameBytes[i] = frameEnd_[i].bytes_ - frameStart_[i].bytes_;
+        windowCounts_[i] += frameCounts[i];
+        windowBytes_[i] += frameBytes[i];
+    }
+
+    windowFrames_++;
+    windowAllocs_ += allocs;
+    windowAllocBytes_ += bytes;
+    windowMaxAllocs_ = Max(windowMaxAllocs_, allocs);
+
+    numQuietFrames_ = IsQuietFrame() ? numQuietFrames_ + 1 : 0;
+    inputThisFrame_ = false;
+
+    if (!strict_ || numQuietFrames_ <= ALLOCATION_IDLE_FRAMES || !mainThreadAllocs)
+        return;
+
+    numViolations_++;
+    URHO3D_LOGERROR("Idle frame allocated memory " + String((unsigned)mainThreadAllocs) + " times in the main thread");
+    LogTopSites(frameCounts, frameBytes, 1);
+
+    // Следующая проверка - после очередной серии спокойных кадров.
+    numQuietFrames_ = 0;
+    assert(!"Idle frame allocated memory");
+}
+
+void AllocationProfiler::LogTopSites(const unsigned long long* counts, const unsigned long long* bytes,
+    unsigned numFrames)
+{
+    // Одинаковые имена из разных единиц трансляции объединяются.
+    Vector<String> names;
+    PODVector<unsigned long long> siteCounts;
+    PODVector<unsigned long long> siteBytes;
+
+    for (unsigned i = 0; i < MAX_ALLOCATION_SITES; i++)
+    {
+        if (!counts[i])
+            continue;
+
+        String name = frameEnd_[i].name_ ? String(frameEnd_[i].name_) : String("(no scope)");
+        unsigned index = (unsigned)(names.Find(name) - names.Begin());
+        if (index == names.Size())
+        {
+            names.Push(name);
+            siteCounts.Push(0);
+            siteBytes.Push(0);
+        }
+
+        siteCounts[index] += counts[i];
+        siteBytes[index] += bytes[i];
+    }
+
+    for (unsigned n = 0; n < ALLOCATION_REPORT_TOP && !names.Empty(); n++)
+    {
+        unsigned best = 0;
+        for (unsigned i = 1; i < names.Size(); i++)
+        {
+            if (siteCounts[i] > siteCounts[best])
+                best = i;
+        }
+
+        URHO3D_LOGINFO("  " + names[best] + ": " + String((float)siteCounts[best] / numFrames) +
+            " allocs/frame, " + String((float)siteBytes[best] / numFrames / 1024.0f) + " KB/frame");
+
+        names.Erase(best);
+        siteCounts.Erase(best);
+        siteBytes.Erase(best);
+    }
+}
+
+void AllocationProfiler::Report()
+{
+    if (!windowFrames_)
+        return;
+
+    URHO3D_LOGINFO("Allocations in " + String(windowFrames_) + " frames: " +
+        String((float)windowAllocs_ / windowFrames_) + " allocs/frame (max " + String((unsigned)windowMaxAllocs_) +
+        "), " + String((float)windowAllocBytes_ / windowFrames_ / 1024.0f) + " KB/frame");
+    LogTopSites(windowCounts_, windowBytes_, windowFrames_);
+
+    for (unsigned i = 0; i < MAX_ALLOCATION_SITES; i++)
+    {
+        windowCounts_[i] = 0;
+        windowBytes_[i] = 0;
+    }
+
+    windowFrames_ = 0;
+    windowAllocs_ = 0;
+    windowAllocBytes_ = 0;
+    windowMaxAllocs_ = 0;
+    windowStart_ = Time::GetSystemTime();
+}
+
+void AllocationProfiler::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (frameStarted_)
+        FinishFrame();
+
+    if (Time::GetSystemTime() - windowStart_ >= ALLOCATION_REPORT_INTERVAL)
+        Report();
+
+    // Отчеты выше тоже выделяют память, поэтому замер кадра начинается после них.
+    BeginMeasure();
+    frameStarted_ = true;
+}
+
+void AllocationProfiler::HandleInput(StringHash eventType, VariantMap& eventData)
+{
+    inputThisFrame_ = true;
+}
@@ -0,0 +1,85 @@
+/*
+Профайлер выделений памяти по кадрам.
+
+Запуск (игра должна быть собрана с SOULMATES_TRACK_ALLOCATIONS, см. AllocationTracker.h):
+    Soulmates -alloc-profile report
+    Soulmates -alloc-profile strict
+
+В режиме report каждые ALLOCATION_REPORT_INTERVAL мс и при выходе в лог выводится
+количество выделений памяти за кадр (среднее и максимум по всем потокам) и места
+(области GAME_PROFILE, см. AllocationTracker.h), которые выделяют больше всего.
+
+Режим strict дополнительно проверяет, что спокойный кадр не выделяет память
+в главном потоке. Кадр спокойный, если уже ALLOCATION_IDLE_FRAMES кадров подряд
+игрок ничего не нажимал и не двигал мышь, юниты основной доски не двигались,
+игровое состояние не менялось и отладочный худ скрыт. Выделение в таком кадре
+выводит в лог места выделений этого кадра, а в отладочной сборке срабатывает assert.
+При выходе игра возвращает код ошибки, если были нарушения.
+*/
+
+#pragma once
+#include "Global.h"
+#include "AllocationTracker.h"
+
+#define ALLOCATION_PROFILER GetSubsystem<AllocationProfiler>()
+
+// Интервал между отчетами в лог (мс).
+#define ALLOCATION_REPORT_INTERVAL 10000
+
+// Количество мест в отчете.
+#define ALLOCATION_REPORT_TOP 10
+
+// Сколько кадров подряд должно пройти без ввода и движения юнитов,
+// чтобы кадр считался спокойным (успевают закончиться анимации кнопок и т.п.).
+#define ALLOCATION_IDLE_FRAMES 60
+
+class AllocationProfiler : public Object
+{
+    URHO3D_OBJECT(AllocationProfiler, Object);
+
+public:
+    AllocationProfiler(Context* context);
+    ~AllocationProfiler();
+
+    // Возвращает false, если игра собрана без подсчета выделений.
+    bool Start(bool strict);
+
+    // Выводит в лог отчет за время с предыдущего отчета.
+    void Report();
+
+    // Спокойные кадры выделяли память (только в режиме strict).
+    unsigned GetNumViolations() const { return numViolations_; }
+
+private:
+    bool strict_ = false;
+    bool frameStarted_ = false;
+
+    // Счетчики мест на начало кадра и их приращения за кадр.
+    AllocationSite frameStart_[MAX_ALLOCATION_SITES];
+    AllocationSite frameEnd_[MAX_ALLOCATION_SITES];
+    unsigned long long frameStartCount_ = 0;
+    unsigned long long frameStartBytes_ = 0;
+    unsigned long long frameStartThreadCount_ = 0;
+
+    // Накопленное за время с предыдущего отчета.
+    unsigned long long windowCounts_[MAX_ALLOCATION_SITES];
+    unsigned long long windowBytes_[MAX_ALLOCATION_SITES];
+    unsigned windowFrames_ = 0;
+    unsigned long long windowAllocs_ = 0;
+    unsigned long long windowAllocBytes_ = 0;
+    unsigned long long windowMaxAllocs_ = 0;
+    unsigned windowStart_ = 0;
+
+    unsigned numQuietFrames_ = 0;
+    bool inputThisFrame_ = false;
+    unsigned numViolations_ = 0;
+
+    void BeginMeasure();
+    void FinishFrame();
+    bool IsQuietFrame() const;
+    // Выводит в лог места с наибольшим количеством выделений.
+    void LogTopSites(const unsigned long long* counts, const unsigned long long* bytes, unsigned numFrames);
+
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    void HandleInput(StringHash eventType, VariantMap& eventData);
+};
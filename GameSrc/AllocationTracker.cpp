@@ -0,0 +1,267 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+bool IsAllocationTrackingEnabled()
+{
+#ifdef SOULMATES_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+static std::atomic<unsigned long long> allocationCount(0);
+static std::atomic<unsigned long long> allocatedBytes(0);
+
+unsigned long long GetAllocationCount()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+unsigned long long GetAllocatedBytes()
+{
+    return allocatedBytes.load(std::memory_order_relaxed);
+}
+
+// Тривиальные типы, поэтому доступны в операторе new до инициализации потока.
+static thread_local unsigned long long threadAllocationCount = 0;
+static thread_local const char* threadAllocationScope = nullptr;
+
+unsigned long long GetThreadAllocationCount()
+{
+    return threadAllocationCount;
+}
+
+struct SiteSlot
+{
+    std::atomic<const char*> name_;
+    std::atomic<unsigned long long> count_;
+    std::atomic<unsigned long long> bytes_;
+};
+
+static std::atomic<bool> sitesEnabled(false);
+// Нулевой слот - выделения вне областей и в областях, не поместившихся в таблицу.
+static SiteSlot siteSlots[MAX_ALLOCATION_SITES];
+
+void EnableAllocationSites(bool enable)
+{
+    sitesEnabled.store(enable, std::memory_order_relaxed);
+}
+
+const char* SetAllocationScope(const char* name)
+{
+    const char* previous = threadAllocationScope;
+    threadAllocationScope = name;
+    return previous;
+}
+
+void GetAllocationSites(AllocationSite result[MAX_ALLOCATION_SITES])
+{
+    for (unsigned i = 0; i < MAX_ALLOCATION_SITES; i++)
+    {
+        const SiteSlot& slot = siteSlots[i];
+        AllocationSite& site = result[i];
+        site.name_ = slot.name_.load(std::memory_order_acquire);
+        site.count_ = slot.count_.load(std::memory_order_relaxed);
+        site.bytes_ = slot.bytes_.load(std::memory_order_relaxed);
+    }
+}
+
+#ifdef SOULMATES_TRACK_ALLOCATIONS
+
+// Имена - строковые константы, поэтому сравниваются указатели.
+// Слот занимается атомарно, так как новое место могут встретить несколько потоков сразу.
+static SiteSlot& FindSiteSlot(const char* name)
+{
+    if (!name)
+        return siteSlots[0];
+
+    size_t hash = reinterpret_cast<size_t>(name) >> 3;
+    for (unsigned i = 0; i < MAX_ALLOCATION_SITES - 1; i++)
+    {
+        SiteSlot& slot = siteSlots[1 + (hash + i) % (MAX_ALLOCATION_SITES - 1)];
+        const char* slotName = slot.name_.load(std::memory_order_acquire);
+
+        if (slotName == name)
+            return slot;
+
+        if (!slotName)
+        {
+            const char* expected = nullptr;
+            if (slot.name_.compare_exchange_strong(expected, name, std::memory_order_acq_rel) || expected == name)
+                return slot;
+        }
+    }
+
+    return siteSlots[0];
+}
+
+static void CountAllocation(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    threadAllocationCount++;
+
+    if (sitesEnabled.load(std::memory_order_relaxed))
+    {
+        SiteSlot& slot = FindSiteSlot(threadAllocationScope);
+        slot.count_.fetch_add(1, std::memory_order_relaxed);
+        slot.bytes_.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+static void* TrackedAlloc(size_t size)
+{
+    CountAllocation(size);
+
+    // malloc(0) может вернуть nullptr, а new обязан вернуть уникальный указатель.
+    return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+    void* ptr = TrackedAlloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    void* ptr = TrackedAlloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return TrackedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return TrackedAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+// Варианты с выравниванием есть только начиная с C++17.
+#ifdef __cpp_aligned_new
+
+static void* TrackedAlignedAlloc(size_t size, std::align_val_t alignment)
+{
+    CountAllocation(size);
+
+    // Выравнивание - степень двойки не меньше sizeof(void*), как требуют обе функции.
+    size_t align = (size_t)alignment < sizeof(void*) ? sizeof(void*) : (size_t)alignment;
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, align);
+#else
+    void* ptr = nullptr;
+    return posix_memalign(&ptr, align, size ? size : 1) == 0 ? ptr : nullptr;
+#endif
+}
+
+static void AlignedFree(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    void* ptr = TrackedAlignedAlloc(size, alignment);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    void* ptr = TrackedAlignedAlloc(size, alignment);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return TrackedAlignedAlloc(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return TrackedAlignedAlloc(size, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+#endif // __cpp_aligned_new
+
+#endif // SOULMATES_TRACK_ALLOCATIONS
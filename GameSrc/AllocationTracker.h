@@ -0,0 +1,53 @@
+/*
+Подсчет выделений памяти.
+
+Включается при сборке:
+    cmake .. -DSOULMATES_TRACK_ALLOCATIONS=ON
+
+Тогда глобальные операторы new и delete (включая варианты с выравниванием)
+заменены так, что каждое выделение памяти в процессе (включая память движка)
+увеличивает счетчики. Счетчики атомарные, поэтому выделения в рабочих потоках
+тоже учитываются. Без этого флага операторы не заменяются, а счетчики всегда нулевые.
+
+Если включен учет по местам выделения (EnableAllocationSites), каждое выделение
+приписывается текущей области профилирования своего потока (GAME_PROFILE, см.
+TraceProfiler.h). Места хранятся в таблице фиксированного размера, поэтому
+сам учет память не выделяет.
+*/
+
+#pragma once
+
+// Игра собрана с подсчетом выделений.
+bool IsAllocationTrackingEnabled();
+
+// Количество выделений памяти с момента запуска.
+unsigned long long GetAllocationCount();
+
+// Суммарный размер выделенной памяти с момента запуска (освобождения не вычитаются).
+unsigned long long GetAllocatedBytes();
+
+// Количество выделений памяти в текущем потоке с момента его запуска.
+unsigned long long GetThreadAllocationCount();
+
+// Максимальное количество различных мест выделения. Выделения в местах,
+// которые не поместились в таблицу, приписываются месту без имени.
+#define MAX_ALLOCATION_SITES 256
+
+struct AllocationSite
+{
+    // Имя области профилирования или nullptr для выделений вне областей.
+    const char* name_;
+    unsigned long long count_;
+    unsigned long long bytes_;
+};
+
+// Включает или выключает учет по местам выделения (по умолчанию выключен).
+void EnableAllocationSites(bool enable);
+
+// Назначает текущую область потока и возвращает предыдущую.
+const char* SetAllocationScope(const char* name);
+
+// Копирует накопленные с момента включения счетчики всех слотов таблицы мест.
+// Место не меняет свой слот, у незанятых слотов счетчики нулевые. Одно и то же имя
+// из разных единиц трансляции может занимать несколько слотов.
+void GetAllocationSites(AllocationSite result[MAX_ALLOCATION_SITES]);
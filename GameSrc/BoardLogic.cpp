@@ -4,6 +4,10 @@
 #include "Config.h"
 #include "UIManager.h"
 #include "Utils.h"
+#include "TraceProfiler.h"
+#include "PerfHud.h"
+#include "GameClock.h"
+#include "GameEventLog.h"
 
 static const Color colors[MAX_NUM_COLORS]
 {
@@ -16,10 +20,49 @@ static const Color colors[MAX_NUM_COLORS]
     Color(1.0f, 0.0f, 1.0f) * 0.75f  // 6 Фиолетовый
 };
 
+// Цвет обводки юнита, который советует толкнуть подсказка.
+static const Color HINT_OUTLINE_COLOR(1.0f, 0.8f, 0.0f);
+
+// Вид обводки юнита.
+enum UnitOutline
+{
+    UO_NONE,
+    UO_SELECTED,
+    UO_HINTED,
+    MAX_UNIT_OUTLINES
+};
+
+static const char* outlineSuffixes[MAX_UNIT_OUTLINES] = { "", "Selected", "Hinted" };
+
+// Материалы юнитов общие для всех юнитов всех досок: по одному на каждый цвет и вид обводки.
+// Юниты с одинаковыми моделью и материалом рендерер рисует инстансами.
+// Материалы создаются при первом обращении и хранятся в кэше ресурсов как ручные ресурсы.
+static Material* GetUnitMaterial(ResourceCache* cache, int colorIndex, UnitOutline outline)
+{
+    String name = "Materials/Unit" + String(colorIndex) + outlineSuffixes[outline] + ".xml";
+
+    Material* material = cache->GetExistingResource<Material>(name);
+    if (material)
+        return material;
+
+    SharedPtr<Material> newMaterial = cache->GetResource<Material>("Materials/Unit.xml")->Clone(name);
+    newMaterial->SetShaderParameter("MatDiffColor", colors[colorIndex]);
+    newMaterial->SetShaderParameter("OutlineEnable", outline != UO_NONE);
+    if (outline == UO_SELECTED)
+        newMaterial->SetShaderParameter("OutlineColor", Color::WHITE);
+    else if (outline == UO_HINTED)
+        newMaterial->SetShaderParameter("OutlineColor", HINT_OUTLINE_COLOR);
+
+    cache->AddManualResource(newMaterial);
+    return newMaterial;
+}
+
 BoardLogic::BoardLogic(Context* context) :
     Component(context)
 {
-    SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(BoardLogic, HandleUpdate));
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(BoardLogic, HandleBeginFrame));
+    SubscribeToEvent(E_GAMESTEP, URHO3D_HANDLER(BoardLogic, HandleGameStep));
+    SubscribeToEvent(E_GAMEINTERPOLATE, URHO3D_HANDLER(BoardLogic, HandleGameInterpolate));
 }
 
 void BoardLogic::RegisterObject(Context* context)
@@ -29,13 +72,13 @@ void BoardLogic::RegisterObject(Context* context)
 
 void BoardLogic::CreateBoard()
 {
+    GAME_PROFILE(CreateBoard);
+
     // Очищаем поле на случай, если оно пересоздается.
     node_->RemoveAllChildren();
-    score_ = 0;
-    UI_MANAGER->showedScore_ = 0.0f;
-    selectedUnit_ = nullptr;
-
-    grid_.Resize(width_ * height_);
+    ResetBoard(0);
+    if (node_ == GLOBAL->boardNode_)
+        UI_MANAGER->showedScore_ = 0.0f;
 
     // Населяем края доски.
     for (int gridX = 0; gridX < width_; gridX++)
@@ -62,32 +105,159 @@ void BoardLogic::CreateBoard()
 
     for (int i = 0; i < initialPopulation_; i++)
     {
-        int index = Random((int)emptyCells.Size());
+        int index = NextRandom((int)emptyCells.Size());
         CreateUnit(emptyCells[index].x_, emptyCells[index].y_);
         emptyCells.Erase(index, 1);
     }
 }
 
+void BoardLogic::ResetBoard(int score)
+{
+    score_ = score;
+    selectedUnit_ = nullptr;
+    hintedUnit_ = nullptr;
+    gameOver_ = false;
+    version_++;
+    cascadeDepth_ = 0;
+    lineKernel_ = GetLineKernel(lineLength_, diagonal_);
+
+    // Сетка пустая, поэтому перед каждым толчком есть место.
+    grid_.Clear();
+    grid_.Resize(width_ * height_);
+    pushLanes_ = &GetPushLanes(width_, height_);
+    freePushes_ = pushLanes_->allBits_;
+
+    if (IsLogging())
+    {
+        GameEventRecord event(GEV_BOARD);
+        event.value_ = (int)GetBoardMode().Pack();
+        LogEvent(event);
+
+        // Восстановленное поле начинается не с нулевого счета.
+        GameEventRecord scoreEvent(GEV_SCORE);
+        scoreEvent.value_ = score_;
+        LogEvent(scoreEvent);
+    }
+}
+
+void BoardLogic::RebuildBoard()
+{
+    GAME_PROFILE(RebuildBoard);
+
+    // Новое положение рассчитывается без нод с тем же генератором случайных чисел,
+    // поэтому поле получается точно таким же, как после CreateBoard.
+    BoardState state;
+    state.Reset(GetBoardMode(), randomSeed_);
+    state.Populate(initialPopulation_);
+    randomSeed_ = state.GetRandomSeed();
+
+    // Размеры доски уже изменены, поэтому старые клетки юнитов берутся из их переменных.
+    // Улетающие юниты доигрывают анимацию.
+    PODVector<Node*> oldUnits;
+    node_->GetChildren(oldUnits);
+
+    ResetBoard(0);
+    if (node_ == GLOBAL->boardNode_)
+        UI_MANAGER->showedScore_ = 0.0f;
+
+    // Юниты, клетки которых остались заняты, не двигаются.
+    PODVector<Node*> spareUnits;
+    foreach(Node* unit, oldUnits)
+    {
+        if (unit->HasTag("Removed"))
+            continue;
+
+        int gridX = unit->GetVar("GridX").GetInt();
+        int gridY = unit->GetVar("GridY").GetInt();
+
+        if (gridX < width_ && gridY < height_ && state.GetCell(gridX, gridY) != EMPTY_CELL &&
+            !grid_[gridY * width_ + gridX])
+        {
+            unit->SetVar("ColorIndex", state.GetCell(gridX, gridY));
+            SetGridCell(gridX, gridY, unit);
+            UpdateOutline(unit);
+            LogSpawn(gridX, gridY, state.GetCell(gridX, gridY));
+        }
+        else
+        {
+            spareUnits.Push(unit);
+        }
+    }
+
+    // Остальные клетки занимают лишние юниты (UnitAnimator сам переместит их в новые клетки),
+    // а если лишних юнитов не хватило, то создаются новые.
+    for (int gridX = 0; gridX < width_; gridX++)
+    {
+        for (int gridY = 0; gridY < height_; gridY++)
+        {
+            int color = state.GetCell(gridX, gridY);
+            if (color == EMPTY_CELL || grid_[gridY * width_ + gridX])
+                continue;
+
+            if (spareUnits.Empty())
+            {
+                CreateUnit(gridX, gridY, color);
+                continue;
+            }
+
+            Node* unit = spareUnits.Back();
+            spareUnits.Pop();
+            unit->SetVar("GridX", gridX);
+            unit->SetVar("GridY", gridY);
+            unit->SetVar("ColorIndex", color);
+            SetGridCell(gridX, gridY, unit);
+            UpdateOutline(unit);
+            LogSpawn(gridX, gridY, color);
+        }
+    }
+
+    foreach(Node* unit, spareUnits)
+        unit->Remove();
+
+    needBreakUpdate_ = true;
+}
+
+void BoardLogic::SetGridCell(int gridX, int gridY, Node* node)
+{
+    int index = gridY * width_ + gridX;
+    bool wasEmpty = !grid_[index];
+    grid_[index] = node;
+    if (wasEmpty != !node)
+        freePushes_ ^= pushLanes_->cellBits_[index];
+}
+
 // Просто назначаем юниту другую клетку доски и он сам будет туда плавно перемещаться.
 void BoardLogic::MoveUnit(Node* node, int gridX, int gridY)
 {
     int oldGridX = node->GetVar("GridX").GetInt();
     int oldGridY = node->GetVar("GridY").GetInt();
-    grid_[oldGridY * width_ + oldGridX] = nullptr;
+    SetGridCell(oldGridX, oldGridY, nullptr);
 
     node->SetVar("GridX", gridX);
     node->SetVar("GridY", gridY);
-    grid_[gridY * width_ + gridX] = node;
+    SetGridCell(gridX, gridY, node);
+
+    if (IsLogging())
+    {
+        GameEventRecord event(GEV_MOVE, oldGridX, oldGridY);
+        event.toX_ = (unsigned char)gridX;
+        event.toY_ = (unsigned char)gridY;
+        LogEvent(event);
+    }
 
-    GLOBAL->PlaySound("MoveUnit", "Sounds/MoveUnit", 3);
+    if (!driven_)
+        GLOBAL->PlaySound("MoveUnit", "Sounds/MoveUnit", 3);
     needBreakUpdate_ = true;
 }
 
 // Клетка доски должна быть пустой (проверка не производится).
 void BoardLogic::CreateUnit(int gridX, int gridY)
 {
-    int colorIndex = Random(numColors_);
+    CreateUnit(gridX, gridY, NextRandom(numColors_));
+}
 
+void BoardLogic::CreateUnit(int gridX, int gridY, int colorIndex)
+{
     Node* node = node_->CreateChild();
     node->SetName("Unit");
     node->SetVar("GridX", gridX);
@@ -100,12 +270,33 @@ void BoardLogic::CreateUnit(int gridX, int gridY)
 
     StaticModel* object = node->CreateComponent<StaticModel>();
     object->SetModel(GET_MODEL("Models/Unit.mdl"));
-    SharedPtr<Material> material = GET_MATERIAL("Materials/Unit.xml")->Clone();
-    material->SetShaderParameter("MatDiffColor", colors[colorIndex]);
-    object->SetMaterial(material);
+    object->SetMaterial(GetUnitMaterial(CACHE, colorIndex, UO_NONE));
 
-    grid_[gridY * width_ + gridX] = node;
+    SetGridCell(gridX, gridY, node);
     needBreakUpdate_ = true;
+
+    LogSpawn(gridX, gridY, colorIndex);
+}
+
+bool BoardLogic::IsLogging() const
+{
+    // Балансу интересна только игра игрока.
+    return gameEventLog && !driven_;
+}
+
+void BoardLogic::LogEvent(const GameEventRecord& event) const
+{
+    gameEventLog->Write(event);
+}
+
+void BoardLogic::LogSpawn(int gridX, int gridY, int colorIndex) const
+{
+    if (!IsLogging())
+        return;
+
+    GameEventRecord event(GEV_SPAWN, gridX, gridY);
+    event.color_ = (unsigned char)colorIndex;
+    LogEvent(event);
 }
 
 Vector3 BoardLogic::GetCellPos(int gridX, int gridY)
@@ -119,17 +310,55 @@ Vector3 BoardLogic::GetCellPos(int gridX, int gridY)
 // может возникнуть необходимость снова удалить линии и снова подвинуть юниты
 // по периметру. Это может повторяться неоднократно, и все это время игрок
 // не может кликать по юнитам.
-void BoardLogic::HandleUpdate(StringHash eventType, VariantMap& eventData)
+void BoardLogic::HandleGameStep(StringHash eventType, VariantMap& eventData)
+{
+    GAME_PROFILE(BoardUpdate);
+
+    float timeStep = eventData[GameStep::P_TIMESTEP].GetFloat();
+    UpdateBoard(timeStep);
+
+    // Клик, который не удалось обработать на этом шаге, пропадает, как и раньше.
+    clickPending_ = false;
+
+    if (!driven_ && needBreakUpdate_)
+        perfCounters.inputBlocked_ = true;
+}
+
+// В кадре может не оказаться ни одного шага, поэтому клик запоминается до ближайшего шага.
+// Ввод к этому моменту уже обработан (Input подписан на E_BEGINFRAME раньше), поэтому
+// клик попадает в шаги этого же кадра.
+void BoardLogic::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (driven_ || GLOBAL->scriptedInput_ || ENGINE->IsHeadless())
+        return;
+
+    if (INPUT->GetMouseButtonPress(MOUSEB_LEFT) && !UI_MANAGER->GetHoveredElement())
+        clickPending_ = true;
+}
+
+void BoardLogic::HandleGameInterpolate(StringHash eventType, VariantMap& eventData)
 {
-    float timeStep = eventData[Update::P_TIMESTEP].GetFloat();
+    GAME_PROFILE(InterpolateUnits);
 
+    float alpha = eventData[GameInterpolate::P_ALPHA].GetFloat();
+
+    node_->GetChildren(animatedUnits_);
+    foreach(Node* unit, animatedUnits_)
+    {
+        UnitAnimator* animator = unit->GetComponent<UnitAnimator>();
+        if (animator)
+            animator->Interpolate(alpha);
+    }
+}
+
+void BoardLogic::UpdateBoard(float timeStep)
+{
     needBreakUpdate_ = false;
+    ready_ = false;
 
     // Анимируем юниты, если нужно. Если было произведено движение
     // хотя бы одного юнита, то пользовательский ввод будет заблокирован.
-    VariantMap& animateUnitEventData = GetEventDataMap();
-    animateUnitEventData[AnimateUnit::P_TIMESTEP] = timeStep;
-    SendEvent(E_ANIMATEUNIT, animateUnitEventData);
+    AnimateUnits(timeStep);
 
     if (needBreakUpdate_)
         return;
@@ -142,7 +371,7 @@ void BoardLogic::HandleUpdate(StringHash eventType, VariantMap& eventData)
 
     // Если игровое поле видно только как фон, то играть нельзя.
     // Также в этом состоянии линии не удаляются.
-    if (GLOBAL->gameState_ != GS_GAMEPLAY)
+    if (!driven_ && GLOBAL->gameState_ != GS_GAMEPLAY)
         return;
 
     FindAndRemoveLines();
@@ -154,31 +383,92 @@ void BoardLogic::HandleUpdate(StringHash eventType, VariantMap& eventData)
     // Если игроку некуда ходить, то заканчиваем игру.
     if (DetectGameOver())
     {
+        // Управляемую доску пересоздает тот, кто ею управляет.
+        if (driven_)
+        {
+            gameOver_ = true;
+            return;
+        }
+
+        if (IsLogging())
+        {
+            GameEventRecord event(GEV_GAME_OVER);
+            event.value_ = score_;
+            LogEvent(event);
+        }
+
         // Звук GameOver.wav проигрывается в файле Game.cpp просто потому что так захотелось.
         GLOBAL->neededGameState_ = GS_GAME_OVER;
+        CONFIG->GetRecords().AddScore(GetBoardMode().Pack(), score_);
         return;
     }
 
+    if (driven_)
+    {
+        ready_ = true;
+        return;
+    }
+
+    // Даем возможность сходить скрипту.
+    SendEvent(E_BOARDREADY);
+
+    // Если ходы поступают из скрипта, то мышь игнорируется.
+    // Без графики выбрать юнит мышью тоже невозможно.
+    if (needBreakUpdate_ || GLOBAL->scriptedInput_ || ENGINE->IsHeadless())
+        return;
+
     UpdateSelectedUnit();
 
     // В итоге игрок может кликать по юнитам, только если ни один юнит не перемещается.
-    if (INPUT->GetMouseButtonPress(MOUSEB_LEFT) && !UI_MANAGER->GetHoveredElement())
+    if (clickPending_)
         OnClickUnit(selectedUnit_);
 }
 
-void BoardLogic::OnClickUnit(Node* node)
+bool BoardLogic::PushUnit(int gridX, int gridY)
+{
+    if (gridX < 0 || gridX >= width_ || gridY < 0 || gridY >= height_)
+        return false;
+
+    Node* node = grid_[gridY * width_ + gridX];
+    if (!node)
+        return false;
+
+    return OnClickUnit(node);
+}
+
+void BoardLogic::AnimateUnits(float timeStep)
 {
+    GAME_PROFILE(AnimateUnits);
+
+    // Юнит может удалить свою ноду во время анимации, поэтому перебирается копия списка.
+    node_->GetChildren(animatedUnits_);
+
+    for (unsigned i = 0; i < animatedUnits_.Size(); i++)
+    {
+        UnitAnimator* animator = animatedUnits_[i]->GetComponent<UnitAnimator>();
+        if (animator && animator->Animate(this, timeStep))
+        {
+            needBreakUpdate_ = true;
+            perfCounters.animatingUnits_++;
+        }
+    }
+}
+
+bool BoardLogic::OnClickUnit(Node* node)
+{
+    GAME_PROFILE(OnClickUnit);
+
     int gridX = node->GetVar("GridX").GetInt();
     int gridY = node->GetVar("GridY").GetInt();
 
     // Если юнит не на краю доски, то его нельзя толкнуть.
-    // По идее эта проверка излишня. Она осталась от старого способа выбора юнитов.
+    // Для мыши эта проверка излишня, но скрипт может указать любую клетку.
     if (gridX != width_ - 1 && gridY != 0 && gridY != height_ - 1)
-        return;
+        return false;
 
     // Угловые юниты тоже нельзя толкнуть.
     if (gridX == width_ - 1 && (gridY == 0 || gridY == height_ - 1))
-        return;
+        return false;
 
     // Определяем направление движения юнита.
     IntVector2 dir;
@@ -209,47 +499,74 @@ void BoardLogic::OnClickUnit(Node* node)
     }
 
     if (newPos.x_ == gridX && newPos.y_ == gridY) // Юнит остался на месте.
-        return;
+        return false;
 
-    // Снимаем выделение.
-    auto staticModel = selectedUnit_->GetComponent<StaticModel>();
-    auto material = staticModel->GetMaterial(0);
-    material->SetShaderParameter("OutlineEnable", false);
+    // Снимаем выделение (при скриптовом вводе его нет) и подсказку.
+    Node* oldSelectedUnit = selectedUnit_;
+    Node* oldHintedUnit = hintedUnit_;
     selectedUnit_ = nullptr;
+    hintedUnit_ = nullptr;
+    UpdateOutline(oldSelectedUnit);
+    UpdateOutline(oldHintedUnit);
+
+    if (IsLogging())
+    {
+        GameEventRecord event(GEV_PUSH, gridX, gridY);
+        event.toX_ = (unsigned char)newPos.x_;
+        event.toY_ = (unsigned char)newPos.y_;
+        LogEvent(event);
+    }
 
     MoveUnit(node, newPos.x_, newPos.y_);
+    version_++;
+    cascadeDepth_ = 0;
+    // Ход может прийти между шагами (см. BoardWall), а следующий ход возможен только после шага.
+    ready_ = false;
 
     // Сразу же двигаем юниты по периметру доски, иначе ряд подвинется только после того,
     // как юнит завершит свою анимацию. Лишняя пауза не нужна.
     MoveBorderUnits();
+
+    if (driven_)
+        return true;
+
+    using namespace UnitPushed;
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_GRIDX] = gridX;
+    eventData[P_GRIDY] = gridY;
+    SendEvent(E_UNITPUSHED, eventData);
+
+    return true;
 }
 
 void BoardLogic::UpdateSelectedUnit()
 {
+    GAME_PROFILE(UpdateSelectedUnit);
+
     IntVector2 mousePos = INPUT->GetMousePosition();
     Viewport* viewport = RENDERER->GetViewport(0);
 
     // Первая клетка игрового поля.
     IntVector2 newSelectedCell(0, 0);
-    Vector3 cellWorldPos = GetCellPos(0, 0);
+    Vector3 cellWorldPos = node_->LocalToWorld(GetCellPos(0, 0));
     IntVector2 cellScreenPos = viewport->WorldToScreenPoint(cellWorldPos);
     float minDistSquared = DistanceSquared(mousePos, cellScreenPos);
 
-    // Список крайних клеток кроме первой и угловых.
-    PODVector<IntVector2> borderCells;
-    borderCells.Reserve(width_ - 2 + width_ - 1 + height_ - 2);
+    // Список крайних клеток кроме первой и угловых (на стеке, так как функция вызывается каждый кадр).
+    IntVector2 borderCells[MAX_BORDER_CELLS];
+    int numBorderCells = 0;
     for (int gridX = 1; gridX < width_ - 1; gridX++)
-        borderCells.Push(IntVector2(gridX, 0));
+        borderCells[numBorderCells++] = IntVector2(gridX, 0);
     for (int gridY = 1; gridY < height_ - 1; gridY++)
-        borderCells.Push(IntVector2(width_ - 1, gridY));
+        borderCells[numBorderCells++] = IntVector2(width_ - 1, gridY);
     for (int gridX = 0; gridX < width_ - 1; gridX++)
-        borderCells.Push(IntVector2(gridX, height_ - 1));
+        borderCells[numBorderCells++] = IntVector2(gridX, height_ - 1);
 
     // Ищем ближайшую к курсору клетку.
-    for (int i = 0; i < (int)borderCells.Size(); i++)
+    for (int i = 0; i < numBorderCells; i++)
     {
         IntVector2 cellGridPos = borderCells[i];
-        cellWorldPos = GetCellPos(cellGridPos.x_, cellGridPos.y_);
+        cellWorldPos = node_->LocalToWorld(GetCellPos(cellGridPos.x_, cellGridPos.y_));
         cellScreenPos = viewport->WorldToScreenPoint(cellWorldPos);
         float distSquared = DistanceSquared(mousePos, cellScreenPos);
         if (distSquared < minDistSquared)
@@ -264,41 +581,58 @@ void BoardLogic::UpdateSelectedUnit()
     if (newSelectedUnit == selectedUnit_)
         return;
 
-    // Снимаем старое выделение.
-    if (selectedUnit_ != nullptr)
-    {
-        auto staticModel = selectedUnit_->GetComponent<StaticModel>();
-        auto material = staticModel->GetMaterial(0);
-        material->SetShaderParameter("OutlineEnable", false);
-    }
-
-    // Выделяем новый юнит.
+    // Снимаем старое выделение и выделяем новый юнит.
+    Node* oldSelectedUnit = selectedUnit_;
     selectedUnit_ = newSelectedUnit;
-    auto staticModel = selectedUnit_->GetComponent<StaticModel>();
-    auto material = staticModel->GetMaterial(0);
-    material->SetShaderParameter("OutlineEnable", true);
+    UpdateOutline(oldSelectedUnit);
+    UpdateOutline(selectedUnit_);
 }
 
-void BoardLogic::MoveBorderUnits()
+void BoardLogic::SetHintedCell(int gridX, int gridY)
 {
-    // Создаем список крайних клеток доски.
-    Vector<IntVector2> borderCells;
-    borderCells.Reserve(width_ * 2 + height_ - 2);
+    Node* newHintedUnit = nullptr;
+    if (gridX >= 0 && gridX < width_ && gridY >= 0 && gridY < height_)
+        newHintedUnit = grid_[gridY * width_ + gridX];
 
-    // Нижняя граница слева направо.
-    for (int i = 0; i < width_; i++)
-        borderCells.Push(IntVector2(i, height_ - 1));
+    if (newHintedUnit == hintedUnit_)
+        return;
 
-    // Правая граница снизу вверх без угловых юнитов.
-    for (int i = height_ - 2; i > 0; i--)
-        borderCells.Push(IntVector2(width_ - 1, i));
+    Node* oldHintedUnit = hintedUnit_;
+    hintedUnit_ = newHintedUnit;
+    UpdateOutline(oldHintedUnit);
+    UpdateOutline(hintedUnit_);
+}
+
+// Выделение важнее подсказки, поэтому выделенный юнит всегда обводится белым.
+// Материалы общие, поэтому юниту назначается другой материал, а не меняются параметры.
+void BoardLogic::UpdateOutline(Node* node)
+{
+    if (!node)
+        return;
 
-    // Верхняя граница справа налево.
-    for (int i = width_ - 1; i >= 0; i--)
-        borderCells.Push(IntVector2(i, 0));
+    UnitOutline outline = UO_NONE;
+    if (node == selectedUnit_)
+        outline = UO_SELECTED;
+    else if (node == hintedUnit_)
+        outline = UO_HINTED;
+
+    int colorIndex = node->GetVar("ColorIndex").GetInt();
+    node->GetComponent<StaticModel>()->SetMaterial(GetUnitMaterial(CACHE, colorIndex, outline));
+}
+
+void BoardLogic::MoveBorderUnits()
+{
+    GAME_PROFILE(MoveBorderUnits);
+    PERF_COUNT(borderMoves_, borderMoveUSec_);
+
+    // Создаем список крайних клеток доски: нижняя граница слева направо, правая граница
+    // снизу вверх без угловых юнитов и верхняя граница справа налево.
+    // Список на стеке, так как функция вызывается каждый кадр.
+    IntVector2 borderCells[MAX_BORDER_CELLS];
+    int numBorderCells = GetBorderCells(width_, height_, borderCells);
 
     // Для каждой клетки из списка кроме последней,
-    for (int i = 0; i < (int)borderCells.Size() - 1; i++)
+    for (int i = 0; i < numBorderCells - 1; i++)
     {
         int gridX = borderCells[i].x_;
         int gridY = borderCells[i].y_;
@@ -308,7 +642,7 @@ void BoardLogic::MoveBorderUnits()
         {
             // то ищем следующий юнит в очереди.
             Node* nextUnit = nullptr;
-            for (int j = i + 1; j < (int)borderCells.Size(); j++)
+            for (int j = i + 1; j < numBorderCells; j++)
             {
                 int nextGridX = borderCells[j].x_;
                 int nextGridY = borderCells[j].y_;
@@ -326,7 +660,7 @@ void BoardLogic::MoveBorderUnits()
     }
 
     // Заполняем пустые клетки в конце списка.
-    for (int i = (int)borderCells.Size() - 1; i >= 0; i--)
+    for (int i = numBorderCells - 1; i >= 0; i--)
     {
         int gridX = borderCells[i].x_;
         int gridY = borderCells[i].y_;
@@ -338,97 +672,51 @@ void BoardLogic::MoveBorderUnits()
     }
 }
 
-int BoardLogic::GetLineLength(int startX, int startY, const IntVector2& dir)
+void BoardLogic::FindAndRemoveLines()
 {
-    Node* firstUnit = grid_[startY * width_ + startX];
-    if (!firstUnit) // Стартовая клетка пустая.
-        return 0;
+    GAME_PROFILE(FindAndRemoveLines);
+    PERF_COUNT(lineSearches_, lineSearchUSec_);
 
-    int firstColor = firstUnit->GetVar("ColorIndex").GetInt();
-    int count = 1;
+    // Цвета клеток в том виде, который понимает функция поиска линий.
+    signed char cells[MAX_BOARD_CELLS];
+    bool removedCells[MAX_BOARD_CELLS];
 
-    for (int gridX = startX + dir.x_, gridY = startY + dir.y_;
-        gridX >= 0 && gridX < width_ && gridY >= 0 && gridY < height_;
-        gridX += dir.x_, gridY += dir.y_)
+    for (int i = 0; i < width_ * height_; i++)
     {
-        Node* unit = grid_[gridY * width_ + gridX];
-        if (!unit) // Клетка пустая.
-            break;
-        
-        int color = unit->GetVar("ColorIndex").GetInt();
-        if (color != firstColor)
-            break;
-
-        count++;
+        Node* unit = grid_[i];
+        cells[i] = unit ? (signed char)unit->GetVar("ColorIndex").GetInt() : (signed char)EMPTY_CELL;
+        removedCells[i] = false;
     }
 
-    return count;
-}
-
-// Проверки не производятся, входные данные должны быть корректными.
-void BoardLogic::MarkToRemove(PODVector<bool>& output,
-    int startX, int startY, int count, const IntVector2& dir)
-{
-    for (int i = 0; i < count; i++)
-    {
-        int gridX = startX + dir.x_ * i;
-        int gridY = startY + dir.y_ * i;
-        output[gridY * width_ + gridX] = true;
-    }
-}
-
-void BoardLogic::FindAndRemoveLines()
-{
-    // Клетки, которые буду очищены.
-    PODVector<bool> removedCells;
-    
-    // Вектор заполняется false'ми.
-    removedCells.Resize(grid_.Size());
-    for (unsigned i = 0; i < removedCells.Size(); i++)
-        removedCells[i] = false;
+    FindLinesInBands(WORK_QUEUE, lineKernel_, cells, width_, height_, removedCells, lineBandMarks_);
 
+    // Уничтожаем юниты, отмеченные для удаления.
+    bool removed = false;
     for (int gridX = 0; gridX < width_; gridX++)
     {
         for (int gridY = 0; gridY < height_; gridY++)
         {
-            // Проверяем юниты вправо по горизонтали, начиная с текущей клетки.
-            IntVector2 dirRight(1, 0);
-            int countRight = GetLineLength(gridX, gridY, dirRight);
-            if (countRight >= lineLength_)
-                MarkToRemove(removedCells, gridX, gridY, countRight, dirRight);
-
-            // Проверяем юниты вниз по вертикали, начиная с текущей клетки.
-            IntVector2 dirDown(0, 1);
-            int countDown = GetLineLength(gridX, gridY, dirDown);
-            if (countDown >= lineLength_)
-                MarkToRemove(removedCells, gridX, gridY, countDown, dirDown);
-
-            if (diagonal_)
+            if (removedCells[gridY * width_ + gridX])
             {
-                // Проверяем юниты вправо вниз по диагонали, начиная с текущей клетки.
-                IntVector2 dirRightDown(1, 1);
-                int countRightDown = GetLineLength(gridX, gridY, dirRightDown);
-                if (countRightDown >= lineLength_)
-                    MarkToRemove(removedCells, gridX, gridY, countRightDown, dirRightDown);
-
-                // Проверяем юниты влево вниз по диагонали, начиная с текущей клетки.
-                IntVector2 dirLeftDown(-1, 1);
-                int countLeftDown = GetLineLength(gridX, gridY, dirLeftDown);
-                if (countLeftDown >= lineLength_)
-                    MarkToRemove(removedCells, gridX, gridY, countLeftDown, dirLeftDown);
+                RemoveUnit(gridX, gridY);
+                removed = true;
             }
         }
     }
 
-    // Уничтожаем юниты, отмеченные для удаления.
-    for (int gridX = 0; gridX < width_; gridX++)
+    if (removed)
+        cascadeDepth_++;
+}
+
+unsigned BoardLogic::GetNumUnits() const
+{
+    unsigned numUnits = 0;
+    foreach(const WeakPtr<Node>& unit, grid_)
     {
-        for (int gridY = 0; gridY < height_; gridY++)
-        {
-            if (removedCells[gridY * width_ + gridX])
-                RemoveUnit(gridX, gridY);
-        }
+        if (unit)
+            numUnits++;
     }
+    return numUnits;
 }
 
 void BoardLogic::RemoveUnit(int gridX, int gridY)
@@ -436,59 +724,72 @@ void BoardLogic::RemoveUnit(int gridX, int gridY)
     // Отвязываем юнит от сетки и запускаем в полет.
     Node* unitNode = grid_[gridY * width_ + gridX];
     unitNode->AddTag("Removed");
-    grid_[gridY * width_ + gridX] = nullptr;
+    SetGridCell(gridX, gridY, nullptr);
 
     // Увеличиваем счет.
     score_++;
-    String modeStr = BoardModeToString();
-    if (score_ > CONFIG->GetRecord(modeStr))
-        CONFIG->SetRecord(modeStr, score_);
+    needBreakUpdate_ = true;
+
+    // Счетчик каскадов увеличивается после удаления всех линий шага.
+    if (IsLogging())
+    {
+        GameEventRecord event(GEV_REMOVE, gridX, gridY);
+        event.color_ = (unsigned char)unitNode->GetVar("ColorIndex").GetInt();
+        event.depth_ = (unsigned char)Min(cascadeDepth_ + 1, 255u);
+        event.value_ = score_;
+        LogEvent(event);
+    }
+
+    if (driven_)
+        return;
 
+    CONFIG->GetRecords().UpdateBest(GetBoardMode().Pack(), score_);
     GLOBAL->PlaySound("RemoveUnit", "Sounds/RemoveUnit", 3);
-    needBreakUpdate_ = true;
 }
 
-bool BoardLogic::DetectGameOver()
+void BoardLogic::GetState(BoardState& state) const
 {
-    // Игрок может походить, если во втором ряду вдоль периметра
-    // есть хотя бы одно пустое место.
+    state.Reset(GetBoardMode(), randomSeed_);
 
-    // Вторая строка.
-    for (int x = 0; x < width_ - 1; x++)
+    for (int gridX = 0; gridX < width_; gridX++)
     {
-        int y = 1;
-        if (!grid_[y * width_ + x])
-            return false;
+        for (int gridY = 0; gridY < height_; gridY++)
+        {
+            Node* unit = grid_[gridY * width_ + gridX];
+            if (unit)
+                state.SetCell(gridX, gridY, unit->GetVar("ColorIndex").GetInt());
+        }
     }
+}
 
-    // Предпоследняя строка.
-    for (int x = 0; x < width_ - 1; x++)
-    {
-        int y = height_ - 2;
-        if (!grid_[y * width_ + x])
-            return false;
-    }
+void BoardLogic::SetState(const BoardState& state, int score)
+{
+    GAME_PROFILE(SetBoardState);
 
-    // Предпоследний столбец. Угловые клетки уже проверены.
-    for (int y = 2; y < height_ - 2; y++)
+    node_->RemoveAllChildren();
+    ResetBoard(score);
+
+    for (int gridX = 0; gridX < width_; gridX++)
     {
-        int x = width_ - 2;
-        if (!grid_[y * width_ + x])
-            return false;
+        for (int gridY = 0; gridY < height_; gridY++)
+        {
+            int color = state.GetCell(gridX, gridY);
+            if (color != EMPTY_CELL)
+                CreateUnit(gridX, gridY, color);
+        }
     }
 
-    return true;
+    randomSeed_ = state.GetRandomSeed();
 }
 
 int BoardLogic::GetMaxInitialPopulation()
 {
-    // Стартовое население ограничено половиной клеток (без учета крайних).
-    return (height_ - 2) * (width_ - 1) / 2;
+    return BoardMode::GetMaxPopulation(width_, height_);
 }
 
 int BoardLogic::GetMaxLineLength()
 {
-    return max(width_, height_);
+    return BoardMode::GetMaxLineLength(width_, height_);
 }
 
 void BoardLogic::ClampPopulationAndLineLength()
@@ -497,11 +798,48 @@ void BoardLogic::ClampPopulationAndLineLength()
     lineLength_ = Clamp(lineLength_, 0, GetMaxLineLength());
 }
 
-// Первоначально режим упаковывался в биты одного числа типа unsigned,
-// но в виде строки он выглядит понятнее при сохранении в конфиг.
 String BoardLogic::BoardModeToString()
 {
-    return String("w") + width_ + "h" + height_ +
-        "c" + numColors_ + "p" + initialPopulation_ +
-        "l" + lineLength_ + "d" + diagonal_;
+    return GetBoardMode().ToString();
+}
+
+bool BoardLogic::BoardModeFromString(const String& mode)
+{
+    BoardMode boardMode;
+    if (!boardMode.FromString(mode))
+        return false;
+
+    SetBoardMode(boardMode);
+    return true;
+}
+
+BoardMode BoardLogic::GetBoardMode() const
+{
+    BoardMode mode;
+    mode.width_ = width_;
+    mode.height_ = height_;
+    mode.numColors_ = numColors_;
+    mode.population_ = initialPopulation_;
+    mode.lineLength_ = lineLength_;
+    mode.diagonal_ = diagonal_;
+    return mode;
+}
+
+void BoardLogic::SetBoardMode(const BoardMode& mode)
+{
+    width_ = Clamp(mode.width_, MIN_BOARD_WIDTH, MAX_BOARD_WIDTH);
+    height_ = Clamp(mode.height_, MIN_BOARD_HEIGHT, MAX_BOARD_HEIGHT);
+    numColors_ = Clamp(mode.numColors_, MIN_NUM_COLORS, MAX_NUM_COLORS);
+    initialPopulation_ = mode.population_;
+    lineLength_ = Max(mode.lineLength_, MIN_LINE_LENGTH);
+    diagonal_ = mode.diagonal_;
+    ClampPopulationAndLineLength();
+}
+
+// Тот же алгоритм, что и в Urho3D::Rand(), но со своим состоянием.
+int BoardLogic::NextRandom(int range)
+{
+    randomSeed_ = randomSeed_ * 214013 + 2531011;
+    int value = (randomSeed_ >> 16) & 32767;
+    return value * range / 32768;
 }
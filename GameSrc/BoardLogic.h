@@ -1,39 +1,30 @@
 /*
-Доска всегда в центре координат. Локальные координаты дочерних нод
-доски совпадают с их мировыми координатами.
+Основная доска всегда в центре координат. Локальные координаты дочерних нод
+основной доски совпадают с их мировыми координатами. Доски стены (см. BoardWall.h)
+смещены, поэтому позиции их юнитов нужно задавать в локальных координатах.
 */
 
 #pragma once
 #include "Global.h"
+#include "BoardState.h"
 
-#define MIN_BOARD_WIDTH 2
-#define MAX_BOARD_WIDTH 10
-#define DEFAULT_BOARD_WIDTH 6
-
-#define MIN_BOARD_HEIGHT 3
-#define MAX_BOARD_HEIGHT 10
-#define DEFAULT_BOARD_HEIGHT 6
-
-#define MIN_NUM_COLORS 3
-#define MAX_NUM_COLORS 7
-#define DEFAULT_NUM_COLORS 6
-
-#define MIN_LINE_LENGTH 3
-#define DEFAULT_LINE_LENGTH 3
-
-#define DEFAULT_POPULATION 0
-
-#define DEFAULT_DIAGONAL true
+struct GameEventRecord;
 
 // Гарантируется, что игровое поле всегда доступно после инициализации игры.
+// В режиме стены это первая доска стены.
 #define BOARD_LOGIC GLOBAL->boardNode_->GetComponent<BoardLogic>()
 
-// Событие вызывает функцию Animate для всех юнитов. Данное событие
-// было добавлено, так как требуется выполнить в определенном порядке
-// код из разных компонентов.
-URHO3D_EVENT(E_ANIMATEUNIT, AnimateUnit)
+// Игровое поле ожидает хода игрока. Отправляется каждый кадр, пока ход возможен.
+// Используется для скриптового ввода. Управляемые доски это событие не отправляют.
+URHO3D_EVENT(E_BOARDREADY, BoardReady)
+{
+}
+
+// Игрок толкнул крайний юнит. Управляемые доски это событие не отправляют.
+URHO3D_EVENT(E_UNITPUSHED, UnitPushed)
 {
-    URHO3D_PARAM(P_TIMESTEP, TimeStep); // float
+    URHO3D_PARAM(P_GRIDX, GridX); // int
+    URHO3D_PARAM(P_GRIDY, GridY); // int
 }
 
 // Этот компонент реализует игровую логику.
@@ -62,6 +53,11 @@ public:
 
     // Метод создает игровое поле.
     void CreateBoard();
+    // Создает то же поле, что и CreateBoard, но не пересоздает все юниты.
+    // Юниты в сохранившихся клетках остаются на месте (при необходимости меняют цвет),
+    // лишние юниты переезжают в незанятые клетки, и только недостающие создаются,
+    // а оставшиеся удаляются. Используется при изменении настроек в стартовом меню.
+    void RebuildBoard();
 
     // Преобразует координаты ячейки в пространственные координаты ноды.
     Vector3 GetCellPos(int gridX, int gridY);
@@ -76,24 +72,110 @@ public:
     // Идентификатор для настроек игрового поля.
     String BoardModeToString();
 
+    // Применяет настройки игрового поля из строки, созданной функцией BoardModeToString.
+    // Поле не пересоздается.
+    bool BoardModeFromString(const String& mode);
+
+    // Настройки игрового поля одной структурой.
+    BoardMode GetBoardMode() const;
+    // Поле не пересоздается. Значения ограничиваются допустимыми пределами.
+    void SetBoardMode(const BoardMode& mode);
+
+    // Все случайные решения игровой логики принимаются с помощью собственного
+    // генератора, поэтому при одинаковом зерне и одинаковых ходах игра
+    // повторяется в точности (независимо от звуков, частоты кадров и т.д.).
+    void SetRandomSeed(unsigned seed) { randomSeed_ = seed; }
+    unsigned GetRandomSeed() const { return randomSeed_; }
+    int NextRandom(int range);
+
+    // Толкает юнит в указанной клетке, как если бы игрок кликнул по нему.
+    // Возвращает false, если такой ход невозможен.
+    bool PushUnit(int gridX, int gridY);
+
     // Проверяет, что больше нет доступных ходов.
-    bool DetectGameOver();
+    bool DetectGameOver() const { return freePushes_ == 0; }
+
+    // Копирует текущее положение на доске (вместе с состоянием генератора случайных чисел).
+    void GetState(BoardState& state) const;
+    // Перестраивает поле по готовому положению без анимации (размеры доски должны совпадать).
+    // Счет в BoardState не хранится, поэтому передается отдельно.
+    void SetState(const BoardState& state, int score);
+    // Номер положения на доске. Увеличивается при каждом ходе и при пересоздании поля.
+    unsigned GetVersion() const { return version_; }
+
+    // Количество юнитов в клетках доски (без улетающих).
+    unsigned GetNumUnits() const;
+    // Сколько раз удалялись линии после последнего хода игрока.
+    unsigned GetCascadeDepth() const { return cascadeDepth_; }
+
+    // Ходы управляемой доски делает не игрок, а внешний код (см. BoardWall).
+    // Такая доска играет независимо от игрового состояния, молчит, не отправляет
+    // глобальные события и не обновляет рекорды, а после конца игры ждет,
+    // пока ее пересоздадут.
+    void SetDriven(bool enable) { driven_ = enable; }
+    bool IsDriven() const { return driven_; }
+    // Управляемая доска ждет хода (флаг обновляется на каждом шаге логики и сбрасывается ходом).
+    bool IsReady() const { return ready_; }
+    // Управляемой доске некуда ходить.
+    bool IsGameOver() const { return gameOver_; }
 
     Node* selectedUnit_ = nullptr;
 
     void UpdateSelectedUnit();
 
+    // Подсвечивает юнит, который советует толкнуть подсказка.
+    // Координаты (-1, -1) убирают подсветку.
+    void SetHintedCell(int gridX, int gridY);
+
 private:
     Vector<WeakPtr<Node> > grid_;
-
-    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+    unsigned randomSeed_ = 1;
+    unsigned version_ = 0;
+    WeakPtr<Node> hintedUnit_;
+    bool driven_ = false;
+    bool ready_ = false;
+    bool gameOver_ = false;
+    // Поиск линий для текущего режима. Выбирается при создании поля (см. LineKernels.h).
+    LineKernel lineKernel_ = nullptr;
+    // Буфер для отметок полос при параллельном поиске линий.
+    PODVector<bool> lineBandMarks_;
+    // Свободные места перед крайними юнитами (см. BoardState::GetFreePushes).
+    const PushLanes* pushLanes_ = nullptr;
+    unsigned freePushes_ = 0;
+    unsigned cascadeDepth_ = 0;
+    // Список юнитов для анимации. Хранится, чтобы не выделять память каждый кадр.
+    PODVector<Node*> animatedUnits_;
+
+    // Игрок кликнул по доске после последнего шага логики.
+    bool clickPending_ = false;
+
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    // Логика доски работает с фиксированным шагом (см. GameClock.h).
+    void HandleGameStep(StringHash eventType, VariantMap& eventData);
+    void HandleGameInterpolate(StringHash eventType, VariantMap& eventData);
+    void UpdateBoard(float timeStep);
+
+    // Сбрасывает выделение, счет и сетку перед заселением поля. Юниты не удаляются.
+    void ResetBoard(int score);
+
+    // Анимирует все юниты доски прямым вызовом, без рассылки событий.
+    void AnimateUnits(float timeStep);
 
     // Создает юнит случайного цвета.
     void CreateUnit(int gridX, int gridY);
-    // Обрабатывает клик по юниту.
-    void OnClickUnit(Node* node);
+    // Создает юнит заданного цвета.
+    void CreateUnit(int gridX, int gridY, int colorIndex);
+    // Обрабатывает клик по юниту. Возвращает true, если юнит сдвинулся.
+    bool OnClickUnit(Node* node);
+    // Меняет содержимое клетки сетки. Все изменения сетки проходят через эту функцию.
+    void SetGridCell(int gridX, int gridY, Node* node);
     // Перемещает юнит из одной ячейки в другую.
     void MoveUnit(Node* node, int gridX, int gridY);
+    // Журнал включен, и доска пишет в него события (см. GameEventLog.h). Управляемые доски
+    // событий не записывают. Проверяется до того, как событие будет заполнено.
+    bool IsLogging() const;
+    void LogEvent(const GameEventRecord& event) const;
+    void LogSpawn(int gridX, int gridY, int colorIndex) const;
     // Двигает очередь юнитов вдоль периметра доски, если впереди есть пустые места,
     // а затем добавляет новые юниты в конец очереди.
     void MoveBorderUnits();
@@ -101,9 +183,6 @@ private:
     void RemoveUnit(int gridX, int gridY);
     // Находит и удаляет линии из одноцветных юнитов.
     void FindAndRemoveLines();
-    // Определяет количество одноцветных юнитов в каком-то направлении.
-    // Если стартовая клетка пустая, то возвращает 0.
-    int GetLineLength(int startX, int startY, const IntVector2& dir);
-    // Устанавливает в true элементы двумерного массива.
-    void MarkToRemove(PODVector<bool>& output, int startX, int startY, int count, const IntVector2& dir);
+    // Включает или выключает обводку юнита в зависимости от выделения и подсказки.
+    void UpdateOutline(Node* node);
 };
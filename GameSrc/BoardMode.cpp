@@ -0,0 +1,84 @@
+#include "BoardMode.h"
+
+unsigned BoardMode::Pack() const
+{
+    return (unsigned)(width_ & 31) |
+        (unsigned)(height_ & 31) << 5 |
+        (unsigned)(numColors_ & 15) << 10 |
+        (unsigned)(population_ & 255) << 14 |
+        (unsigned)(lineLength_ & 31) << 22 |
+        (unsigned)diagonal_ << 27;
+}
+
+BoardMode BoardMode::Unpack(unsigned packed)
+{
+    BoardMode mode;
+    mode.width_ = packed & 31;
+    mode.height_ = packed >> 5 & 31;
+    mode.numColors_ = packed >> 10 & 15;
+    mode.population_ = packed >> 14 & 255;
+    mode.lineLength_ = packed >> 22 & 31;
+    mode.diagonal_ = (packed >> 27 & 1) != 0;
+    return mode;
+}
+
+// Первоначально режим упаковывался в биты одного числа типа unsigned,
+// но в виде строки он выглядит понятнее при сохранении в конфиг.
+String BoardMode::ToString() const
+{
+    return String("w") + width_ + "h" + height_ +
+        "c" + numColors_ + "p" + population_ +
+        "l" + lineLength_ + "d" + diagonal_;
+}
+
+bool BoardMode::FromString(const String& str)
+{
+    // Строка состоит из пар "буква + число". Значения хранятся по индексу буквы.
+    int values[26];
+    for (int i = 0; i < 26; i++)
+        values[i] = -1;
+
+    unsigned pos = 0;
+    while (pos < str.Length())
+    {
+        char key = str[pos++];
+        unsigned numberStart = pos;
+        while (pos < str.Length() && IsDigit(str[pos]))
+            pos++;
+
+        if (key < 'a' || key > 'z' || numberStart == pos)
+            return false;
+
+        values[key - 'a'] = ToInt(str.Substring(numberStart, pos - numberStart));
+    }
+
+    const char keys[] = "whcpld";
+    for (int i = 0; keys[i]; i++)
+    {
+        if (values[keys[i] - 'a'] < 0)
+            return false;
+    }
+
+    width_ = values['w' - 'a'];
+    height_ = values['h' - 'a'];
+    numColors_ = values['c' - 'a'];
+    population_ = values['p' - 'a'];
+    lineLength_ = values['l' - 'a'];
+    diagonal_ = values['d' - 'a'] != 0;
+
+    return true;
+}
+
+int BoardMode::Distance(unsigned packed1, unsigned packed2)
+{
+    BoardMode mode1 = Unpack(packed1);
+    BoardMode mode2 = Unpack(packed2);
+
+    // Число цветов, длина линии и диагональ влияют на игру сильнее, чем размеры поля.
+    return 4 * Abs(mode1.width_ - mode2.width_) +
+        4 * Abs(mode1.height_ - mode2.height_) +
+        8 * Abs(mode1.numColors_ - mode2.numColors_) +
+        Abs(mode1.population_ - mode2.population_) +
+        8 * Abs(mode1.lineLength_ - mode2.lineLength_) +
+        (mode1.diagonal_ != mode2.diagonal_ ? 12 : 0);
+}
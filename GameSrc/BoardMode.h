@@ -0,0 +1,61 @@
+/*
+Настройки игрового поля (режим игры).
+
+Режим можно упаковать в одно число, которое используется как ключ
+в таблицах (рекорды, профили сложности и т.д.), или в строку вида
+w6h6c6p0l3d1, которая используется в конфиге и в скриптах.
+*/
+
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+// Допустимые значения настроек и значения по умолчанию.
+
+#define MIN_BOARD_WIDTH 2
+#define MAX_BOARD_WIDTH 10
+#define DEFAULT_BOARD_WIDTH 6
+
+#define MIN_BOARD_HEIGHT 3
+#define MAX_BOARD_HEIGHT 10
+#define DEFAULT_BOARD_HEIGHT 6
+
+#define MAX_BOARD_CELLS (MAX_BOARD_WIDTH * MAX_BOARD_HEIGHT)
+
+#define MIN_NUM_COLORS 3
+#define MAX_NUM_COLORS 7
+#define DEFAULT_NUM_COLORS 6
+
+#define MIN_LINE_LENGTH 3
+#define DEFAULT_LINE_LENGTH 3
+
+#define DEFAULT_POPULATION 0
+
+#define DEFAULT_DIAGONAL true
+
+struct BoardMode
+{
+    int width_ = 0;
+    int height_ = 0;
+    int numColors_ = 0;
+    int population_ = 0;
+    int lineLength_ = 0;
+    bool diagonal_ = false;
+
+    // Упаковывает режим в 28 бит: ширина, высота и длина линии по 5 бит,
+    // число цветов 4 бита, население 8 бит, диагональ 1 бит.
+    unsigned Pack() const;
+    static BoardMode Unpack(unsigned packed);
+
+    String ToString() const;
+    // Возвращает false, если строка некорректна. Значения не ограничиваются.
+    bool FromString(const String& str);
+
+    // Ограничения, зависящие от размеров поля.
+    // Стартовое население ограничено половиной клеток (без учета крайних).
+    static int GetMaxPopulation(int width, int height) { return (height - 2) * (width - 1) / 2; }
+    static int GetMaxLineLength(int width, int height) { return Max(width, height); }
+
+    // Насколько один режим отличается от другого (0 - режимы совпадают).
+    // Используется для поиска похожих режимов.
+    static int Distance(unsigned packed1, unsigned packed2);
+};
@@ -0,0 +1,345 @@
+#include "BoardSolver.h"
+#include "TraceProfiler.h"
+#include <cstring>
+
+// Во сколько удаленных юнитов оценивается конец игры.
+static const float SOLVER_GAME_OVER_PENALTY = 10.0f;
+
+// Как часто проверяется время (в узлах дерева).
+static const unsigned SOLVER_TIME_CHECK_INTERVAL = 256;
+
+// Поколение хранится в 16 битах записи.
+static const unsigned SOLVER_GENERATION_MASK = 0xFFFF;
+
+// Зерно для проигрывания толчка. Зависит только от позиции, толчка и номера проигрывания.
+static unsigned GetSampleSeed(unsigned long long hash, const IntVector2& cell, unsigned sample)
+{
+    unsigned long long seed = hash ^ ((unsigned long long)(cell.y_ * MAX_BOARD_WIDTH + cell.x_) << 56);
+    seed += (sample + 1) * 0x9E3779B97F4A7C15ull;
+    seed = (seed ^ (seed >> 31)) * 0xBF58476D1CE4E5B9ull;
+    return (unsigned)(seed ^ (seed >> 32));
+}
+
+// Время истекло (с учетом переполнения счетчика миллисекунд).
+static bool IsTimeOver(unsigned deadline)
+{
+    return (int)(Time::GetSystemTime() - deadline) >= 0;
+}
+
+BoardSolver::BoardSolver(unsigned tableSizeLog2) :
+    table_(new TableEntry[(size_t)1 << tableSizeLog2]),
+    tableMask_(((unsigned long long)1 << tableSizeLog2) - 1),
+    nextGeneration_(0)
+{
+    Clear();
+}
+
+BoardSolver::~BoardSolver()
+{
+    // Задачи незабранного поиска обращаются к таблице.
+    FinishSearch();
+    delete[] table_;
+}
+
+void BoardSolver::Clear()
+{
+    for (unsigned long long i = 0; i <= tableMask_; i++)
+    {
+        table_[i].check_.store(0, std::memory_order_relaxed);
+        table_[i].data_.store(0, std::memory_order_relaxed);
+    }
+}
+
+void BoardSolver::InitContext(SearchContext& context)
+{
+    context.deadline_ = Time::GetSystemTime() + 0x7FFFFFFF;
+    context.aborted_ = false;
+    context.numNodes_ = 0;
+    context.generation_ = nextGeneration_.fetch_add(1, std::memory_order_relaxed) & SOLVER_GENERATION_MASK;
+}
+
+// Данные: значение (32 бита float), глубина (8 бит) и поколение (16 бит).
+// Нулевые данные означают пустую запись (глубина всегда больше нуля).
+bool BoardSolver::Probe(unsigned long long hash, int depth, unsigned generation, float& value) const
+{
+    const TableEntry& entry = table_[hash & tableMask_];
+    unsigned long long data = entry.data_.load(std::memory_order_relaxed);
+    unsigned long long check = entry.check_.load(std::memory_order_relaxed);
+
+    if (!data || (check ^ data) != hash)
+        return false;
+
+    // Оценки с разной глубиной несравнимы: более глубокая больше на удаления последних ходов.
+    if ((int)(data >> 32 & 255) != depth || (unsigned)(data >> 40 & SOLVER_GENERATION_MASK) != generation)
+        return false;
+
+    unsigned valueBits = (unsigned)data;
+    memcpy(&value, &valueBits, sizeof(value));
+    return true;
+}
+
+void BoardSolver::Store(unsigned long long hash, int depth, unsigned generation, float value)
+{
+    unsigned valueBits;
+    memcpy(&valueBits, &value, sizeof(valueBits));
+    unsigned long long data = (unsigned long long)generation << 40 | (unsigned long long)depth << 32 | valueBits;
+
+    TableEntry& entry = table_[hash & tableMask_];
+    entry.check_.store(hash ^ data, std::memory_order_relaxed);
+    entry.data_.store(data, std::memory_order_relaxed);
+}
+
+float BoardSolver::EvaluatePush(const BoardState& state, const IntVector2& cell, int depth, SearchContext& context)
+{
+    float sum = 0.0f;
+
+    for (unsigned sample = 0; sample < SOLVER_NUM_SAMPLES; sample++)
+    {
+        BoardState next = state;
+        next.SetRandomSeed(GetSampleSeed(state.GetHash(), cell, sample));
+        next.Push(cell.x_, cell.y_);
+
+        float value = (float)next.Settle();
+        if (next.IsGameOver())
+            value -= SOLVER_GAME_OVER_PENALTY;
+        else
+            value += EvaluateState(next, depth - 1, context);
+
+        if (context.aborted_)
+            return 0.0f;
+
+        sum += value;
+    }
+
+    return sum / SOLVER_NUM_SAMPLES;
+}
+
+float BoardSolver::EvaluateState(const BoardState& state, int depth, SearchContext& context)
+{
+    if (depth <= 0)
+        return 0.0f;
+
+    float value;
+    if (Probe(state.GetHash(), depth, context.generation_, value))
+        return value;
+
+    if (++context.numNodes_ % SOLVER_TIME_CHECK_INTERVAL == 0 && IsTimeOver(context.deadline_))
+        context.aborted_ = true;
+
+    if (context.aborted_)
+        return 0.0f;
+
+    IntVector2 cells[MAX_BORDER_CELLS];
+    int numCells = state.GetPushes(cells);
+
+    // Если ходов нет, то игра закончена (до этого обычно не доходит).
+    float best = numCells ? -M_INFINITY : -SOLVER_GAME_OVER_PENALTY;
+    for (int i = 0; i < numCells; i++)
+    {
+        float pushValue = EvaluatePush(state, cells[i], depth, context);
+        if (context.aborted_)
+            return 0.0f;
+
+        best = Max(best, pushValue);
+    }
+
+    Store(state.GetHash(), depth, context.generation_, best);
+    return best;
+}
+
+float BoardSolver::Evaluate(const BoardState& state, int depth)
+{
+    SearchContext context;
+    InitContext(context);
+
+    return EvaluateState(state, depth, context);
+}
+
+SolverResult BoardSolver::Search(const BoardState& state, unsigned timeBudgetMs, int maxDepth)
+{
+    GAME_PROFILE(SolverSearch);
+
+    SolverResult result;
+
+    IntVector2 cells[MAX_BORDER_CELLS];
+    int numCells = state.GetPushes(cells);
+    if (!numCells)
+        return result;
+
+    // Первая глубина всегда завершается, чтобы был хоть какой-то ответ.
+    SearchContext context;
+    InitContext(context);
+    unsigned deadline = Time::GetSystemTime() + timeBudgetMs;
+
+    maxDepth = Clamp(maxDepth, 1, SOLVER_MAX_DEPTH);
+    for (int depth = 1; depth <= maxDepth; depth++)
+    {
+        IntVector2 bestCell = cells[0];
+        float bestValue = -M_INFINITY;
+
+        for (int i = 0; i < numCells; i++)
+        {
+            float value = EvaluatePush(state, cells[i], depth, context);
+            if (context.aborted_)
+                break;
+
+            if (value > bestValue)
+            {
+                bestValue = value;
+                bestCell = cells[i];
+            }
+        }
+
+        if (context.aborted_)
+            break;
+
+        result.cell_ = bestCell;
+        result.value_ = bestValue;
+        result.depth_ = depth;
+
+        context.deadline_ = deadline;
+        if (IsTimeOver(deadline))
+            break;
+    }
+
+    return result;
+}
+
+// Данные параллельного поиска. Каждая задача углубляет поиск для своего толчка из корня.
+struct ParallelSearch
+{
+    BoardSolver* solver_;
+    // Копия, так как поиск может пережить состояние, для которого он запущен.
+    BoardState state_;
+    IntVector2 cells_[MAX_BORDER_CELLS];
+    int numCells_;
+    // Оценки толчков на каждой глубине.
+    float values_[MAX_BORDER_CELLS][SOLVER_MAX_DEPTH + 1];
+    // Глубина, до которой поиск для толчка полностью завершен.
+    int completedDepths_[MAX_BORDER_CELLS];
+    unsigned deadline_;
+    int maxDepth_;
+    // Все задачи одного поиска пользуются общими записями таблицы.
+    unsigned generation_;
+    // Сколько задач уже выполнено.
+    std::atomic<int> numFinished_;
+};
+
+// Рендер ждет задачи с максимальным приоритетом (WorkQueue::Complete(M_MAX_UNSIGNED)),
+// подсказки запускаются с нулевым. Поиск должен быть между ними.
+static const unsigned SOLVER_WORK_PRIORITY = 1;
+
+void BoardSolver::SearchRootWork(const WorkItem* item, unsigned threadIndex)
+{
+    GAME_PROFILE(SolverSearchRoot);
+
+    ParallelSearch* search = static_cast<ParallelSearch*>(item->start_);
+    unsigned index = (unsigned)(size_t)item->aux_;
+
+    SearchContext context;
+    context.deadline_ = Time::GetSystemTime() + 0x7FFFFFFF;
+    context.aborted_ = false;
+    context.numNodes_ = 0;
+    context.generation_ = search->generation_;
+
+    for (int depth = 1; depth <= search->maxDepth_; depth++)
+    {
+        float value = search->solver_->EvaluatePush(search->state_, search->cells_[index], depth, context);
+        if (context.aborted_)
+            break;
+
+        search->values_[index][depth] = value;
+        search->completedDepths_[index] = depth;
+
+        context.deadline_ = search->deadline_;
+        if (IsTimeOver(search->deadline_))
+            break;
+    }
+
+    search->numFinished_.fetch_add(1, std::memory_order_release);
+}
+
+bool BoardSolver::StartSearch(WorkQueue* workQueue, const BoardState& state,
+    unsigned timeBudgetMs, int maxDepth)
+{
+    GAME_PROFILE(SolverStartSearch);
+
+    if (search_)
+        FinishSearch();
+
+    ParallelSearch* search = new ParallelSearch();
+    search->solver_ = this;
+    search->state_ = state;
+    search->deadline_ = Time::GetSystemTime() + timeBudgetMs;
+    search->maxDepth_ = Clamp(maxDepth, 1, SOLVER_MAX_DEPTH);
+    search->generation_ = nextGeneration_.fetch_add(1, std::memory_order_relaxed) & SOLVER_GENERATION_MASK;
+    search->numFinished_.store(0, std::memory_order_relaxed);
+
+    search->numCells_ = state.GetPushes(search->cells_);
+    if (!search->numCells_)
+    {
+        delete search;
+        return false;
+    }
+
+    for (int i = 0; i < search->numCells_; i++)
+    {
+        search->completedDepths_[i] = 0;
+        search->values_[i][0] = 0.0f;
+    }
+
+    for (int i = 0; i < search->numCells_; i++)
+    {
+        SharedPtr<WorkItem> item = workQueue->GetFreeItem();
+        item->workFunction_ = SearchRootWork;
+        item->start_ = search;
+        item->aux_ = (void*)(size_t)i;
+        item->priority_ = SOLVER_WORK_PRIORITY;
+        item->sendEvent_ = false;
+        workQueue->AddWorkItem(item);
+    }
+
+    search_ = search;
+    searchQueue_ = workQueue;
+    return true;
+}
+
+bool BoardSolver::IsSearchFinished() const
+{
+    return !search_ || search_->numFinished_.load(std::memory_order_acquire) == search_->numCells_;
+}
+
+SolverResult BoardSolver::FinishSearch()
+{
+    SolverResult result;
+    if (!search_)
+        return result;
+
+    // Если очередь уже удалена, то ее потоки остановлены и задачи поиска больше не выполнятся.
+    if (!IsSearchFinished() && searchQueue_)
+        searchQueue_->Complete(SOLVER_WORK_PRIORITY);
+
+    ParallelSearch* search = search_;
+    search_ = nullptr;
+    searchQueue_.Reset();
+
+    // Сравнивать толчки можно только на глубине, которую завершили все задачи.
+    int depth = search->maxDepth_;
+    for (int i = 0; i < search->numCells_; i++)
+        depth = Min(depth, search->completedDepths_[i]);
+
+    result.depth_ = depth;
+    result.cell_ = search->cells_[0];
+    result.value_ = search->values_[0][depth];
+    for (int i = 1; i < search->numCells_; i++)
+    {
+        if (search->values_[i][depth] > result.value_)
+        {
+            result.value_ = search->values_[i][depth];
+            result.cell_ = search->cells_[i];
+        }
+    }
+
+    delete search;
+    return result;
+}
@@ -0,0 +1,118 @@
+/*
+Поиск лучшего хода на несколько ходов вперед (expectimax).
+
+Цвета новых юнитов случайны, поэтому после каждого толчка идет узел случайности.
+Все комбинации цветов перебрать невозможно, поэтому узел случайности
+оценивается по нескольким проигрываниям с разными зернами. Зерна выводятся
+из хеша доски, так что одна и та же позиция всегда оценивается одинаково.
+
+Одни и те же позиции встречаются в дереве много раз (толчки в разном порядке,
+каскады, приводящие к одинаковому результату), поэтому оценки позиций
+сохраняются в таблице транспозиций, индексированной хешем Зобриста.
+Таблица имеет фиксированный размер и не использует блокировки:
+ключ каждой записи хранится сложенным по XOR с данными, поэтому запись,
+которую одновременно изменили два потока, просто не пройдет проверку.
+Одной таблицей могут пользоваться несколько потоков одновременно.
+
+Оценка - сумма удаленных юнитов за оставшиеся ходы, поэтому запись подходит
+только для той же глубины, на которой она рассчитана. Кроме того, каждый поиск
+(Search, StartSearch, Evaluate) получает новое поколение и видит только записи
+своего поколения, поэтому записи прошлых ходов бота не влияют на выбор хода,
+а таблицу не нужно очищать между ходами.
+
+Поиск выполняется с итеративным углублением и ограничен по времени:
+используется результат последней полностью завершенной глубины.
+
+Параллельный поиск (StartSearch) не ждет результата: задачи выполняются
+в рабочих потоках, а главный поток продолжает рисовать кадры и забирает результат
+через FinishSearch, когда IsSearchFinished вернет true. Приоритет задач ниже,
+чем у задач рендера, поэтому рендер не ждет поиск.
+*/
+
+#pragma once
+#include "BoardState.h"
+#include <atomic>
+
+// Максимальная глубина поиска (в ходах).
+#define SOLVER_MAX_DEPTH 8
+
+// Количество проигрываний для узла случайности.
+#define SOLVER_NUM_SAMPLES 4
+
+struct ParallelSearch;
+
+struct SolverResult
+{
+    // Лучший толчок. (-1, -1), если ходов нет.
+    IntVector2 cell_ = IntVector2(-1, -1);
+    // Ожидаемое количество удаленных юнитов за depth_ ходов.
+    float value_ = 0.0f;
+    // Глубина, на которой поиск был полностью завершен.
+    int depth_ = 0;
+};
+
+class BoardSolver
+{
+public:
+    // Размер таблицы транспозиций равен 2^tableSizeLog2 записей по 16 байт.
+    BoardSolver(unsigned tableSizeLog2 = 20);
+    ~BoardSolver();
+
+    // Очищает таблицу транспозиций. Нельзя вызывать во время поиска.
+    void Clear();
+
+    // Ищет лучший ход в текущем потоке. Можно вызывать из нескольких потоков одновременно.
+    SolverResult Search(const BoardState& state, unsigned timeBudgetMs, int maxDepth = SOLVER_MAX_DEPTH);
+
+    // Распределяет толчки из корня по рабочим потокам WorkQueue и сразу возвращается.
+    // Состояние копируется. Незабранный предыдущий поиск сначала завершается.
+    // Возвращает false, если ходов нет.
+    bool StartSearch(WorkQueue* workQueue, const BoardState& state,
+        unsigned timeBudgetMs, int maxDepth = SOLVER_MAX_DEPTH);
+    // Все задачи запущенного поиска выполнены (или поиск не запущен).
+    bool IsSearchFinished() const;
+    // Результат запущенного поиска. Если задачи еще выполняются, главный поток
+    // помогает их выполнить и ждет. Вызывать только из главного потока.
+    SolverResult FinishSearch();
+
+    // Ожидаемое количество удаленных юнитов за depth ходов при лучшей игре. Без ограничения по времени.
+    float Evaluate(const BoardState& state, int depth);
+
+private:
+    struct TableEntry
+    {
+        std::atomic<unsigned long long> check_;
+        std::atomic<unsigned long long> data_;
+    };
+
+    TableEntry* table_;
+    unsigned long long tableMask_;
+    // Поколение следующего поиска.
+    std::atomic<unsigned> nextGeneration_;
+    // Запущенный и еще не забранный параллельный поиск.
+    ParallelSearch* search_ = nullptr;
+    WeakPtr<WorkQueue> searchQueue_;
+
+    // Данные одного поиска. Поиск прерывается, когда истекает время.
+    struct SearchContext
+    {
+        unsigned deadline_;
+        bool aborted_;
+        unsigned numNodes_;
+        // Поколение записей таблицы, которые видит этот поиск.
+        unsigned generation_;
+    };
+
+    // Начинает новый поиск без ограничения по времени.
+    void InitContext(SearchContext& context);
+
+    // Ожидаемый результат толчка с учетом depth - 1 последующих ходов.
+    float EvaluatePush(const BoardState& state, const IntVector2& cell, int depth, SearchContext& context);
+    // Лучший результат среди всех толчков на глубину depth.
+    float EvaluateState(const BoardState& state, int depth, SearchContext& context);
+
+    bool Probe(unsigned long long hash, int depth, unsigned generation, float& value) const;
+    void Store(unsigned long long hash, int depth, unsigned generation, float value);
+
+    static void SearchRootWork(const WorkItem* item, unsigned threadIndex);
+};
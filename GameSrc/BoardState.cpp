@@ -0,0 +1,317 @@
+#include "BoardState.h"
+#include "Utils.h"
+
+unsigned long long boardZobristKeys[MAX_BOARD_CELLS][MAX_NUM_COLORS];
+
+// Ключи генерируются алгоритмом SplitMix64 с фиксированным зерном.
+static struct ZobristKeysInitializer
+{
+    ZobristKeysInitializer()
+    {
+        unsigned long long seed = 0x536F756C6D617465ull;
+        for (int i = 0; i < MAX_BOARD_CELLS; i++)
+        {
+            for (int color = 0; color < MAX_NUM_COLORS; color++)
+            {
+                unsigned long long key = (seed += 0x9E3779B97F4A7C15ull);
+                key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+                key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+                boardZobristKeys[i][color] = key ^ (key >> 31);
+            }
+        }
+    }
+} zobristKeysInitializer;
+
+int GetBorderCells(int width, int height, IntVector2 result[MAX_BORDER_CELLS])
+{
+    int numCells = 0;
+
+    // Нижняя граница слева направо.
+    for (int i = 0; i < width; i++)
+        result[numCells++] = IntVector2(i, height - 1);
+
+    // Правая граница снизу вверх без угловых юнитов.
+    for (int i = height - 2; i > 0; i--)
+        result[numCells++] = IntVector2(width - 1, i);
+
+    // Верхняя граница справа налево.
+    for (int i = width - 1; i >= 0; i--)
+        result[numCells++] = IntVector2(i, 0);
+
+    return numCells;
+}
+
+static_assert(MAX_BORDER_CELLS <= 32, "Push bits must fit into unsigned");
+
+static PushLanes pushLanes[MAX_BOARD_WIDTH - MIN_BOARD_WIDTH + 1][MAX_BOARD_HEIGHT - MIN_BOARD_HEIGHT + 1];
+
+static struct PushLanesInitializer
+{
+    PushLanesInitializer()
+    {
+        for (int width = MIN_BOARD_WIDTH; width <= MAX_BOARD_WIDTH; width++)
+        {
+            for (int height = MIN_BOARD_HEIGHT; height <= MAX_BOARD_HEIGHT; height++)
+            {
+                PushLanes& lanes = pushLanes[width - MIN_BOARD_WIDTH][height - MIN_BOARD_HEIGHT];
+                for (int i = 0; i < MAX_BOARD_CELLS; i++)
+                    lanes.cellBits_[i] = 0;
+                lanes.allBits_ = 0;
+
+                IntVector2 borderCells[MAX_BORDER_CELLS];
+                int numBorderCells = GetBorderCells(width, height, borderCells);
+
+                for (int i = 0; i < numBorderCells; i++)
+                {
+                    const IntVector2& cell = borderCells[i];
+
+                    // Клетка перед крайним юнитом (как в BoardState::CanPush).
+                    IntVector2 front;
+                    if (cell.x_ == width - 1 && (cell.y_ == 0 || cell.y_ == height - 1))
+                        continue;
+                    else if (cell.y_ == 0)
+                        front = IntVector2(cell.x_, 1);
+                    else if (cell.y_ == height - 1)
+                        front = IntVector2(cell.x_, height - 2);
+                    else
+                        front = IntVector2(width - 2, cell.y_);
+
+                    lanes.cellBits_[front.y_ * width + front.x_] |= 1u << i;
+                    lanes.allBits_ |= 1u << i;
+                }
+            }
+        }
+    }
+} pushLanesInitializer;
+
+const PushLanes& GetPushLanes(int width, int height)
+{
+    width = Clamp(width, MIN_BOARD_WIDTH, MAX_BOARD_WIDTH);
+    height = Clamp(height, MIN_BOARD_HEIGHT, MAX_BOARD_HEIGHT);
+    return pushLanes[width - MIN_BOARD_WIDTH][height - MIN_BOARD_HEIGHT];
+}
+
+BoardState::BoardState() :
+    width_(0),
+    height_(0),
+    numColors_(0),
+    lineLength_(0),
+    diagonal_(false),
+    lineKernel_(nullptr),
+    randomSeed_(1),
+    hash_(0),
+    pushLanes_(&GetPushLanes(MIN_BOARD_WIDTH, MIN_BOARD_HEIGHT)),
+    freePushes_(0),
+    numBorderCells_(0)
+{
+}
+
+void BoardState::Reset(const BoardMode& mode, unsigned randomSeed)
+{
+    width_ = mode.width_;
+    height_ = mode.height_;
+    numColors_ = mode.numColors_;
+    lineLength_ = mode.lineLength_;
+    diagonal_ = mode.diagonal_;
+    lineKernel_ = GetLineKernel(lineLength_, diagonal_);
+    randomSeed_ = randomSeed;
+    hash_ = 0;
+
+    for (int i = 0; i < width_ * height_; i++)
+        cells_[i] = EMPTY_CELL;
+
+    // Поле пустое, поэтому перед каждым толчком есть место.
+    pushLanes_ = &GetPushLanes(width_, height_);
+    freePushes_ = pushLanes_->allBits_;
+
+    numBorderCells_ = GetBorderCells(width_, height_, borderCells_);
+}
+
+void BoardState::Populate(int initialPopulation)
+{
+    // Порядок создания юнитов важен, так как от него зависят их цвета.
+    for (int gridX = 0; gridX < width_; gridX++)
+    {
+        SetCell(gridX, 0, NextRandom(numColors_));
+        SetCell(gridX, height_ - 1, NextRandom(numColors_));
+    }
+
+    for (int gridY = 1; gridY < height_ - 1; gridY++)
+        SetCell(width_ - 1, gridY, NextRandom(numColors_));
+
+    IntVector2 emptyCells[MAX_BOARD_CELLS];
+    int numEmptyCells = 0;
+
+    for (int gridX = 0; gridX < width_ - 1; gridX++)
+    {
+        for (int gridY = 1; gridY < height_ - 1; gridY++)
+            emptyCells[numEmptyCells++] = IntVector2(gridX, gridY);
+    }
+
+    for (int i = 0; i < initialPopulation && numEmptyCells > 0; i++)
+    {
+        int index = NextRandom(numEmptyCells);
+        SetCell(emptyCells[index].x_, emptyCells[index].y_, NextRandom(numColors_));
+
+        // Сохраняем порядок оставшихся клеток, как PODVector::Erase.
+        numEmptyCells--;
+        for (int j = index; j < numEmptyCells; j++)
+            emptyCells[j] = emptyCells[j + 1];
+    }
+}
+
+bool BoardState::CanPush(int gridX, int gridY, IntVector2& newPos) const
+{
+    // Толкнуть можно только крайний юнит.
+    if (gridX != width_ - 1 && gridY != 0 && gridY != height_ - 1)
+        return false;
+
+    // Кроме угловых юнитов справа.
+    if (gridX == width_ - 1 && (gridY == 0 || gridY == height_ - 1))
+        return false;
+
+    if (GetCell(gridX, gridY) == EMPTY_CELL)
+        return false;
+
+    IntVector2 dir;
+    if (gridY == 0)
+        dir = IntVector2(0, 1);
+    else if (gridY == height_ - 1)
+        dir = IntVector2(0, -1);
+    else
+        dir = IntVector2(-1, 0);
+
+    newPos = IntVector2(gridX, gridY);
+    while (true)
+    {
+        IntVector2 tryPos = newPos + dir;
+        if (tryPos.x_ < 0 || tryPos.y_ < 0 || tryPos.y_ >= height_)
+            break;
+        if (GetCell(tryPos.x_, tryPos.y_) != EMPTY_CELL)
+            break;
+        newPos = tryPos;
+    }
+
+    return newPos.x_ != gridX || newPos.y_ != gridY;
+}
+
+bool BoardState::Push(int gridX, int gridY)
+{
+    if (gridX < 0 || gridX >= width_ || gridY < 0 || gridY >= height_)
+        return false;
+
+    IntVector2 newPos;
+    if (!CanPush(gridX, gridY, newPos))
+        return false;
+
+    SetCell(newPos.x_, newPos.y_, GetCell(gridX, gridY));
+    SetCell(gridX, gridY, EMPTY_CELL);
+    MoveBorderUnits();
+
+    return true;
+}
+
+void BoardState::GetPushes(PODVector<IntVector2>& result) const
+{
+    IntVector2 cells[MAX_BORDER_CELLS];
+    int numCells = GetPushes(cells);
+
+    result.Resize(numCells);
+    for (int i = 0; i < numCells; i++)
+        result[i] = cells[i];
+}
+
+int BoardState::GetPushes(IntVector2 result[MAX_BORDER_CELLS]) const
+{
+    int numCells = 0;
+
+    // Перебираются только толчки со свободным местом впереди. Крайний юнит
+    // может отсутствовать только пока очередь по периметру не сдвинута.
+    for (unsigned bits = freePushes_; bits; bits &= bits - 1)
+    {
+        const IntVector2& cell = borderCells_[CountTrailingZeros(bits)];
+        if (GetCell(cell.x_, cell.y_) != EMPTY_CELL)
+            result[numCells++] = cell;
+    }
+
+    return numCells;
+}
+
+void BoardState::MoveBorderUnits()
+{
+    for (int i = 0; i < numBorderCells_ - 1; i++)
+    {
+        const IntVector2& cell = borderCells_[i];
+        if (GetCell(cell.x_, cell.y_) != EMPTY_CELL)
+            continue;
+
+        // Ищем следующий юнит в очереди.
+        int next = i + 1;
+        while (next < numBorderCells_ && GetCell(borderCells_[next].x_, borderCells_[next].y_) == EMPTY_CELL)
+            next++;
+
+        if (next == numBorderCells_)
+            break;
+
+        const IntVector2& nextCell = borderCells_[next];
+        SetCell(cell.x_, cell.y_, GetCell(nextCell.x_, nextCell.y_));
+        SetCell(nextCell.x_, nextCell.y_, EMPTY_CELL);
+    }
+
+    // Заполняем пустые клетки в конце очереди.
+    for (int i = numBorderCells_ - 1; i >= 0; i--)
+    {
+        const IntVector2& cell = borderCells_[i];
+        if (GetCell(cell.x_, cell.y_) != EMPTY_CELL)
+            break;
+
+        SetCell(cell.x_, cell.y_, NextRandom(numColors_));
+    }
+}
+
+int BoardState::RemoveLines()
+{
+    bool removedCells[MAX_BOARD_CELLS];
+    for (int i = 0; i < width_ * height_; i++)
+        removedCells[i] = false;
+
+    lineKernel_(cells_, width_, height_, 0, height_, removedCells);
+
+    int numRemoved = 0;
+    for (int i = 0; i < width_ * height_; i++)
+    {
+        if (removedCells[i])
+        {
+            SetCellByIndex(i, EMPTY_CELL);
+            numRemoved++;
+        }
+    }
+
+    return numRemoved;
+}
+
+int BoardState::Settle()
+{
+    int numRemoved = 0;
+
+    while (true)
+    {
+        MoveBorderUnits();
+
+        int count = RemoveLines();
+        if (!count)
+            break;
+
+        numRemoved += count;
+    }
+
+    return numRemoved;
+}
+
+// Тот же алгоритм, что и в BoardLogic::NextRandom.
+int BoardState::NextRandom(int range)
+{
+    randomSeed_ = randomSeed_ * 214013 + 2531011;
+    int value = (randomSeed_ >> 16) & 32767;
+    return value * range / 32768;
+}
@@ -0,0 +1,126 @@
+/*
+Состояние игрового поля без нод и графики: только цвета юнитов в клетках.
+
+Правила те же, что и в BoardLogic (толчок юнита, движение очереди по периметру,
+удаление линий, определение конца игры), и генератор случайных чисел тот же,
+поэтому при одинаковом зерне новые юниты получают те же цвета.
+Состояние занимает фиксированный объем памяти и копируется без выделения памяти,
+поэтому его удобно проигрывать наперед в фоновых потоках.
+*/
+
+#pragma once
+#include "BoardMode.h"
+#include "LineKernels.h"
+
+// Значение пустой клетки.
+#define EMPTY_CELL -1
+
+// Максимальная длина периметра доски.
+#define MAX_BORDER_CELLS (MAX_BOARD_WIDTH * 2 + MAX_BOARD_HEIGHT - 2)
+
+// Случайные ключи для хеширования доски методом Зобриста: по ключу на каждую пару
+// "клетка + цвет". Ключи одинаковы при каждом запуске, поэтому хеши можно сравнивать
+// между разными процессами.
+extern unsigned long long boardZobristKeys[MAX_BOARD_CELLS][MAX_NUM_COLORS];
+
+// Клетки перед крайними юнитами (второй ряд вдоль периметра) для доски определенного размера.
+// Толчок крайнего юнита возможен тогда и только тогда, когда клетка перед ним пуста.
+// Толчки нумеруются в порядке очереди по периметру (см. BoardLogic::MoveBorderUnits).
+struct PushLanes
+{
+    // Для каждой клетки - биты толчков, перед которыми она стоит.
+    unsigned cellBits_[MAX_BOARD_CELLS];
+    // Биты всех толчков (угловые юниты справа толкнуть нельзя).
+    unsigned allBits_;
+};
+
+// Таблицы рассчитываются один раз при запуске для всех допустимых размеров доски.
+const PushLanes& GetPushLanes(int width, int height);
+
+// Крайние клетки в порядке движения очереди (см. BoardLogic::MoveBorderUnits).
+// Возвращает количество клеток.
+int GetBorderCells(int width, int height, IntVector2 result[MAX_BORDER_CELLS]);
+
+class BoardState
+{
+public:
+    BoardState();
+
+    // Создает пустое поле. Значения режима должны быть в допустимых пределах.
+    void Reset(const BoardMode& mode, unsigned randomSeed);
+    // Заселяет поле так же, как BoardLogic::CreateBoard.
+    void Populate(int initialPopulation);
+
+    int GetWidth() const { return width_; }
+    int GetHeight() const { return height_; }
+    int GetNumColors() const { return numColors_; }
+    int GetLineLength() const { return lineLength_; }
+    bool IsDiagonal() const { return diagonal_; }
+
+    // Цвет юнита в клетке или EMPTY_CELL.
+    int GetCell(int gridX, int gridY) const { return cells_[gridY * width_ + gridX]; }
+    void SetCell(int gridX, int gridY, int color) { SetCellByIndex(gridY * width_ + gridX, color); }
+
+    // Хеш цветов всех клеток. Не зависит от состояния генератора случайных чисел.
+    // Обновляется при каждом изменении клетки.
+    unsigned long long GetHash() const { return hash_; }
+
+    // Толкает юнит, как BoardLogic::OnClickUnit, и двигает очередь по периметру.
+    // Возвращает false, если юнит нельзя толкнуть или он остался на месте.
+    bool Push(int gridX, int gridY);
+    // Клетки, толчок из которых сдвинет юнит.
+    void GetPushes(PODVector<IntVector2>& result) const;
+    // То же без выделения памяти. Возвращает количество клеток.
+    int GetPushes(IntVector2 result[MAX_BORDER_CELLS]) const;
+
+    // Двигает очередь юнитов вдоль периметра и создает новые юниты в конце очереди.
+    void MoveBorderUnits();
+    // Удаляет линии из одноцветных юнитов. Возвращает количество удаленных юнитов.
+    int RemoveLines();
+    // Повторяет движение очереди и удаление линий, пока удаляются линии
+    // (то же самое игра делает между ходами игрока). Возвращает количество удаленных юнитов.
+    int Settle();
+
+    // Проверяет, что больше нет доступных ходов.
+    bool IsGameOver() const { return freePushes_ == 0; }
+    // Биты толчков, перед которыми есть свободное место (номера как в GetPushLanes).
+    // Обновляются при каждом изменении клетки.
+    unsigned GetFreePushes() const { return freePushes_; }
+
+    void SetRandomSeed(unsigned seed) { randomSeed_ = seed; }
+    unsigned GetRandomSeed() const { return randomSeed_; }
+    int NextRandom(int range);
+
+private:
+    int width_;
+    int height_;
+    int numColors_;
+    int lineLength_;
+    bool diagonal_;
+    // Выбирается при смене режима (см. LineKernels.h).
+    LineKernel lineKernel_;
+    unsigned randomSeed_;
+
+    signed char cells_[MAX_BOARD_CELLS];
+    unsigned long long hash_;
+    const PushLanes* pushLanes_;
+    unsigned freePushes_;
+
+    // Крайние клетки в порядке движения очереди (см. BoardLogic::MoveBorderUnits).
+    IntVector2 borderCells_[MAX_BORDER_CELLS];
+    int numBorderCells_;
+
+    void SetCellByIndex(int index, int color)
+    {
+        bool wasEmpty = cells_[index] == EMPTY_CELL;
+        if (!wasEmpty)
+            hash_ ^= boardZobristKeys[index][cells_[index]];
+        cells_[index] = (signed char)color;
+        if (color != EMPTY_CELL)
+            hash_ ^= boardZobristKeys[index][color];
+        if (wasEmpty != (color == EMPTY_CELL))
+            freePushes_ ^= pushLanes_->cellBits_[index];
+    }
+
+    bool CanPush(int gridX, int gridY, IntVector2& newPos) const;
+};
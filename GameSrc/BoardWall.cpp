@@ -0,0 +1,300 @@
+#include "BoardWall.h"
+#include "Urho3DAliases.h"
+#include "TraceProfiler.h"
+
+static const String driverNames[MAX_WALL_DRIVERS] = { "bot", "random", "replay" };
+
+// Промежуток между соседними досками (в клетках).
+static const float WALL_BOARD_GAP = 1.0f;
+
+// Следующее зерно партии. Стена с одинаковым начальным зерном играет одинаковые партии.
+static unsigned NextGameSeed(unsigned seed)
+{
+    return seed * 1664525 + 1013904223;
+}
+
+BoardWall::BoardWall(Context* context) :
+    Object(context)
+{
+}
+
+BoardWall::~BoardWall()
+{
+    delete solver_;
+}
+
+bool BoardWall::Create(unsigned numBoards, const String& drivers, const String& replayFileName)
+{
+    PODVector<WallDriver> driverList;
+    StringVector names = drivers.ToLower().Split(',');
+
+    foreach(const String& name, names)
+    {
+        unsigned driver = 0;
+        while (driver < MAX_WALL_DRIVERS && driverNames[driver] != name.Trimmed())
+            driver++;
+
+        if (driver == MAX_WALL_DRIVERS)
+        {
+            URHO3D_LOGERROR("Unknown wall driver \"" + name + "\"");
+            return false;
+        }
+
+        if (driver == WD_REPLAY && !LoadReplay(replayFileName))
+            return false;
+
+        driverList.Push((WallDriver)driver);
+    }
+
+    if (!numBoards || driverList.Empty())
+    {
+        URHO3D_LOGERROR("Wall needs at least one board and one driver");
+        return false;
+    }
+
+    BoardMode mode = BOARD_LOGIC->GetBoardMode();
+    unsigned seed = BOARD_LOGIC->GetRandomSeed();
+
+    boards_.Resize(numBoards);
+    int maxWidth = 0;
+    int maxHeight = 0;
+
+    for (unsigned i = 0; i < numBoards; i++)
+    {
+        // Первая доска стены - основная.
+        Node* boardNode = i ? GLOBAL->scene_->CreateChild() : GLOBAL->boardNode_;
+        BoardLogic* logic = boardNode->GetOrCreateComponent<BoardLogic>();
+        logic->SetBoardMode(mode);
+        logic->SetDriven(true);
+
+        WallBoard& board = boards_[i];
+        board.logic_ = logic;
+        board.driver_ = driverList[i % driverList.Size()];
+        board.seed_ = seed + i * 0x9E3779B9u;
+        board.driverSeed_ = board.seed_ ^ 0x5BD1E995;
+        board.numGames_ = 0;
+        board.totalScore_ = 0;
+        board.bestScore_ = 0;
+        RestartBoard(board);
+
+        maxWidth = Max(maxWidth, logic->width_);
+        maxHeight = Max(maxHeight, logic->height_);
+    }
+
+    // Доски расставляются в сетку, центр которой совпадает с центром координат.
+    unsigned numColumns = (unsigned)CeilToInt(Sqrt((float)numBoards));
+    unsigned numRows = (numBoards + numColumns - 1) / numColumns;
+    Vector2 step(maxWidth + WALL_BOARD_GAP, maxHeight + WALL_BOARD_GAP);
+
+    for (unsigned i = 0; i < numBoards; i++)
+    {
+        float column = (float)(i % numColumns) - (numColumns - 1) * 0.5f;
+        float row = (float)(i / numColumns) - (numRows - 1) * 0.5f;
+        boards_[i].logic_->GetNode()->SetPosition(Vector3(column * step.x_, -row * step.y_, 0.0f));
+    }
+
+    size_ = Vector2(numColumns * step.x_, numRows * step.y_);
+
+    if (driverList.Contains(WD_BOT))
+        solver_ = new BoardSolver();
+
+    // Доски играют сами, меню не нужно.
+    GLOBAL->neededGameState_ = GS_GAMEPLAY;
+
+    SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(BoardWall, HandlePostUpdate));
+
+    URHO3D_LOGINFO("Wall of " + String(numBoards) + " boards created, mode " + mode.ToString() +
+        ", drivers " + drivers);
+
+    return true;
+}
+
+bool BoardWall::LoadReplay(const String& fileName)
+{
+    // Запись уже загружена для предыдущего упоминания водителя.
+    if (!replayPushes_.Empty())
+        return true;
+
+    File file(context_, fileName, FILE_READ);
+    if (!file.IsOpen())
+    {
+        URHO3D_LOGERROR("Can't open replay " + fileName);
+        return false;
+    }
+
+    while (!file.IsEof())
+    {
+        StringVector command = file.ReadLine().Trimmed().Split(' ');
+        if (command.Size() == 2 && command[0] == "seed")
+            replaySeed_ = ToUInt(command[1]);
+        else if (command.Size() == 2 && command[0] == "mode")
+            replayMode_ = command[1];
+        else if (command.Size() == 3 && command[0] == "push")
+            replayPushes_.Push(IntVector2(ToInt(command[1]), ToInt(command[2])));
+    }
+
+    if (replayPushes_.Empty())
+    {
+        URHO3D_LOGERROR("Replay " + fileName + " has no moves");
+        return false;
+    }
+
+    return true;
+}
+
+void BoardWall::RestartBoard(WallBoard& board)
+{
+    BoardLogic* logic = board.logic_;
+
+    if (board.driver_ == WD_REPLAY)
+    {
+        board.seed_ = replaySeed_;
+        if (!replayMode_.Empty())
+            logic->BoardModeFromString(replayMode_);
+    }
+
+    board.replayPos_ = 0;
+    board.numMoves_ = 0;
+    board.push_ = IntVector2(-1, -1);
+
+    logic->SetRandomSeed(board.seed_);
+    logic->CreateBoard();
+}
+
+void BoardWall::ChooseMoveWork(const WorkItem* item, unsigned threadIndex)
+{
+    GAME_PROFILE(WallChooseMove);
+
+    WallBoard* board = static_cast<WallBoard*>(item->start_);
+    BoardWall* wall = static_cast<BoardWall*>(item->aux_);
+
+    if (board->driver_ == WD_BOT)
+    {
+        board->push_ = wall->solver_->Search(board->state_, WALL_BOT_TIME_BUDGET, WALL_BOT_MAX_DEPTH).cell_;
+        return;
+    }
+
+    IntVector2 cells[MAX_BORDER_CELLS];
+    int numCells = board->state_.GetPushes(cells);
+    if (!numCells)
+    {
+        board->push_ = IntVector2(-1, -1);
+        return;
+    }
+
+    // Тот же алгоритм, что и в BoardLogic::NextRandom.
+    board->driverSeed_ = board->driverSeed_ * 214013 + 2531011;
+    board->push_ = cells[((board->driverSeed_ >> 16) & 32767) * numCells / 32768];
+}
+
+void BoardWall::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    GAME_PROFILE(WallUpdate);
+
+    PODVector<WallBoard*> pendingBoards;
+    PODVector<WallBoard*> finishedBoards;
+
+    for (unsigned i = 0; i < boards_.Size(); i++)
+    {
+        WallBoard& board = boards_[i];
+        BoardLogic* logic = board.logic_;
+        if (!logic)
+            continue;
+
+        if (logic->IsGameOver())
+        {
+            finishedBoards.Push(&board);
+            continue;
+        }
+
+        if (!logic->IsReady())
+            continue;
+
+        // Запись воспроизводится без рабочих потоков. Партия заканчивается вместе с записью.
+        if (board.driver_ == WD_REPLAY)
+        {
+            if (board.replayPos_ >= replayPushes_.Size())
+            {
+                finishedBoards.Push(&board);
+                continue;
+            }
+
+            const IntVector2& push = replayPushes_[board.replayPos_++];
+            if (logic->PushUnit(push.x_, push.y_))
+                board.numMoves_++;
+
+            continue;
+        }
+
+        logic->GetState(board.state_);
+        pendingBoards.Push(&board);
+    }
+
+    // Главный поток тоже выбирает ходы, пока ждет завершения задач.
+    if (!pendingBoards.Empty())
+    {
+        WorkQueue* workQueue = WORK_QUEUE;
+        foreach(WallBoard* board, pendingBoards)
+        {
+            SharedPtr<WorkItem> item = workQueue->GetFreeItem();
+            item->workFunction_ = ChooseMoveWork;
+            item->start_ = board;
+            item->aux_ = this;
+            item->priority_ = M_MAX_UNSIGNED;
+            item->sendEvent_ = false;
+            workQueue->AddWorkItem(item);
+        }
+        workQueue->Complete(M_MAX_UNSIGNED);
+    }
+
+    foreach(WallBoard* board, pendingBoards)
+    {
+        if (board->push_.x_ >= 0 && board->logic_->PushUnit(board->push_.x_, board->push_.y_))
+            board->numMoves_++;
+        else
+            finishedBoards.Push(board);
+    }
+
+    foreach(WallBoard* board, finishedBoards)
+    {
+        int score = board->logic_->score_;
+        board->numGames_++;
+        board->totalScore_ += score;
+        board->bestScore_ = Max(board->bestScore_, score);
+
+        URHO3D_LOGINFO("Wall board " + String((unsigned)(board - &boards_[0])) + " (" + driverNames[board->driver_] +
+            "): score " + String(score) + " in " + String(board->numMoves_) + " moves, seed " + String(board->seed_));
+
+        board->seed_ = NextGameSeed(board->seed_);
+        RestartBoard(*board);
+    }
+}
+
+void BoardWall::LogResults()
+{
+    for (unsigned driver = 0; driver < MAX_WALL_DRIVERS; driver++)
+    {
+        int numBoards = 0;
+        int numGames = 0;
+        int totalScore = 0;
+        int bestScore = 0;
+
+        foreach(const WallBoard& board, boards_)
+        {
+            if (board.driver_ != driver)
+                continue;
+
+            numBoards++;
+            numGames += board.numGames_;
+            totalScore += board.totalScore_;
+            bestScore = Max(bestScore, board.bestScore_);
+        }
+
+        if (!numBoards)
+            continue;
+
+        String average = numGames ? String((float)totalScore / numGames) : String("-");
+        URHO3D_LOGINFO("Wall driver " + driverNames[driver] + ": " + String(numBoards) + " boards, " +
+            String(numGames) + " games, average score " + average + ", best " + String(bestScore));
+    }
+}
@@ -0,0 +1,104 @@
+/*
+Стена досок: много независимых досок в одной сцене (ключ командной строки -wall).
+Используется для турниров ботов и демонстрационных стен.
+
+Каждая доска - это обычный BoardLogic со своими генератором случайных чисел
+и счетом, но управляемый (см. BoardLogic::SetDriven). Ходы за доски делают водители:
+    bot     - BoardSolver с небольшим бюджетом времени на ход;
+    random  - случайные толчки;
+    replay  - ходы из записанной сессии (см. InputScript.h). Используются только
+              команды seed, mode и push. Все доски воспроизводят одну и ту же запись
+              и должны закончить одинаково.
+Водители назначаются доскам по кругу, поэтому в турнире можно сравнить
+несколько водителей на одинаковом количестве досок.
+
+Граф сцены не потокобезопасен, поэтому правила игры (BoardLogic) выполняются
+в главном потоке. Зато выбор ходов, который занимает основное время,
+для всех готовых досок выполняется параллельно в рабочих потоках WorkQueue.
+Все боты пользуются одной таблицей транспозиций.
+
+Первая доска стены - это основная доска (GLOBAL->boardNode_), поэтому интерфейс
+показывает ее счет. После конца игры доска пересоздается с новым зерном,
+а результат записывается в лог.
+*/
+
+#pragma once
+#include "Global.h"
+#include "BoardSolver.h"
+
+#define BOARD_WALL GetSubsystem<BoardWall>()
+
+// Бюджет времени бота на один ход. Вся стена ждет самого медленного бота.
+#define WALL_BOT_TIME_BUDGET 2
+#define WALL_BOT_MAX_DEPTH 2
+
+enum WallDriver
+{
+    WD_BOT,
+    WD_RANDOM,
+    WD_REPLAY,
+    MAX_WALL_DRIVERS
+};
+
+// Доска стены.
+struct WallBoard
+{
+    WeakPtr<BoardLogic> logic_;
+    WallDriver driver_;
+    // Зерно, с которым была создана текущая партия.
+    unsigned seed_;
+    // Генератор водителя random. Не зависит от генератора игровой логики.
+    unsigned driverSeed_;
+    // Номер следующего хода в записи для водителя replay.
+    unsigned replayPos_;
+    // Ходы текущей партии.
+    int numMoves_;
+    // Результаты законченных партий.
+    int numGames_;
+    int totalScore_;
+    int bestScore_;
+    // Выбранный ход. (-1, -1), если ходить некуда.
+    IntVector2 push_;
+    // Копия доски для выбора хода в рабочем потоке.
+    BoardState state_;
+};
+
+class BoardWall : public Object
+{
+    URHO3D_OBJECT(BoardWall, Object);
+
+public:
+    BoardWall(Context* context);
+    ~BoardWall();
+
+    // Превращает основную доску в первую доску стены и создает остальные.
+    // drivers - имена водителей через запятую, назначаются по кругу.
+    // replayFileName нужен только водителю replay.
+    bool Create(unsigned numBoards, const String& drivers, const String& replayFileName);
+    bool IsActive() const { return !boards_.Empty(); }
+
+    // Размер стены в единицах сцены (для камеры).
+    Vector2 GetSize() const { return size_; }
+
+    // Выводит в лог итоги по каждому водителю.
+    void LogResults();
+
+private:
+    Vector<WallBoard> boards_;
+    Vector2 size_;
+    BoardSolver* solver_ = nullptr;
+
+    // Запись для водителя replay.
+    unsigned replaySeed_ = 1;
+    String replayMode_;
+    PODVector<IntVector2> replayPushes_;
+
+    bool LoadReplay(const String& fileName);
+    // Начинает новую партию на доске.
+    void RestartBoard(WallBoard& board);
+    // Выбирает ход в рабочем потоке.
+    static void ChooseMoveWork(const WorkItem* item, unsigned threadIndex);
+
+    // Доски обновляются по E_UPDATE, поэтому к этому моменту уже известно, какие из них готовы.
+    void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+};
@@ -1,12 +1,17 @@
 #include "CameraLogic.h"
 #include "Global.h"
+#include "BoardWall.h"
+#include "VersusMode.h"
 #include "Urho3DAliases.h"
 #include "Utils.h"
+#include "TraceProfiler.h"
+#include "GameClock.h"
 
 CameraLogic::CameraLogic(Context* context) :
-    LogicComponent(context)
+    Component(context)
 {
-    SetUpdateEventMask(USE_UPDATE);
+    SubscribeToEvent(E_GAMESTEP, URHO3D_HANDLER(CameraLogic, HandleGameStep));
+    SubscribeToEvent(E_GAMEINTERPOLATE, URHO3D_HANDLER(CameraLogic, HandleGameInterpolate));
 }
 
 void CameraLogic::RegisterObject(Context* context)
@@ -14,23 +19,62 @@ void CameraLogic::RegisterObject(Context* context)
     context->RegisterFactory<CameraLogic>();
 }
 
-void CameraLogic::Update(float timeStep)
+void CameraLogic::HandleGameStep(StringHash eventType, VariantMap& eventData)
 {
+    GAME_PROFILE(CameraUpdate);
+
+    // Без графики нет ни экрана, ни рендерпаса.
+    if (ENGINE->IsHeadless() || !node_)
+        return;
+
+    float timeStep = eventData[GameStep::P_TIMESTEP].GetFloat();
+
+    if (!initialized_)
+    {
+        z_ = node_->GetPosition().z_;
+        initialized_ = true;
+    }
+
+    // Дистанция камеры зависит от размера игрового поля (или всей стены досок, или обеих досок матча).
+    Vector2 boardSize((float)BOARD_LOGIC->width_, (float)BOARD_LOGIC->height_);
+    if (BOARD_WALL && BOARD_WALL->IsActive())
+        boardSize = BOARD_WALL->GetSize();
+    else if (VERSUS && VERSUS->IsActive())
+        boardSize = VERSUS->GetSize();
+
+    float distFromWidth = boardSize.x_ * 1.3f;
+    float distFromHeight = boardSize.y_ * 1.6f;
+    float targetZ = -max(distFromWidth, distFromHeight);
+    prevZ_ = z_;
+    z_ = ToTarget(z_, targetZ, 10.0f, timeStep);
+
+    AnimateScreenBlur(timeStep);
+}
+
+void CameraLogic::HandleGameInterpolate(StringHash eventType, VariantMap& eventData)
+{
+    if (ENGINE->IsHeadless() || !node_ || !initialized_)
+        return;
+
     // Направление камеры зависит от положения курсора мыши.
     IntVector2 mousePos = INPUT->GetMousePosition();
     float yaw = (float)mousePos.x_ / GRAPHICS->GetWidth() - 0.5f;
     float pitch = (float)mousePos.y_ / GRAPHICS->GetHeight() - 0.5f;
     node_->SetRotation(Quaternion(pitch * 3.0f, yaw * 3.0f, 0.0f));
 
-    // Дистанция камеры зависит от размера игрового поля.
-    float distFromWidth = BOARD_LOGIC->width_ * 1.3f;
-    float distFromHeight = BOARD_LOGIC->height_ * 1.6f;
-    float targetZ = -max(distFromWidth, distFromHeight);
-    float currentZ = node_->GetPosition().z_;
-    float newZ = ToTarget(currentZ, targetZ, 10.0f, timeStep);
-    node_->SetPosition(Vector3(0.0f, 0.0f, newZ));
+    float alpha = eventData[GameInterpolate::P_ALPHA].GetFloat();
+    float z = Lerp(prevZ_, z_, alpha);
+    node_->SetPosition(Vector3(0.0f, 0.0f, z));
 
-    AnimateScreenBlur(timeStep);
+    // Фоновая плоскость должна оставаться позади досок, даже если камера далеко.
+    // Размер плоскости пропорционален расстоянию, поэтому на экране она выглядит одинаково.
+    Node* skyNode = node_->GetChild("Sky");
+    if (skyNode)
+    {
+        float skyDist = Max(20.0f, 10.0f - z);
+        skyNode->SetPosition(Vector3(0.0f, 0.0f, skyDist));
+        skyNode->SetScale(Vector3(2.0f, 0.0f, 1.5f) * skyDist);
+    }
 }
 
 void CameraLogic::AnimateScreenBlur(float timeStep)
@@ -11,16 +11,25 @@
 #define MAX_BLUR_SIGMA 1.5f
 
 // Этот компонент прикрепляется к ноде с камерой.
-class CameraLogic : public LogicComponent
+// Дистанция камеры и размытие меняются с фиксированным шагом (см. GameClock.h),
+// а поворот за мышью обновляется каждый кадр.
+class CameraLogic : public Component
 {
-    URHO3D_OBJECT(CameraLogic, LogicComponent);
+    URHO3D_OBJECT(CameraLogic, Component);
 
 public:
     CameraLogic(Context* context);
     static void RegisterObject(Context* context);
-    void Update(float timeStep);
 
 private:
+    // Дистанция камеры после последнего и предыдущего шагов. Берется из ноды при первом шаге.
+    bool initialized_ = false;
+    float z_ = 0.0f;
+    float prevZ_ = 0.0f;
+
+    void HandleGameStep(StringHash eventType, VariantMap& eventData);
+    void HandleGameInterpolate(StringHash eventType, VariantMap& eventData);
+
     // Плавное изменение силы размытия.
     void AnimateScreenBlur(float timeStep);
 };
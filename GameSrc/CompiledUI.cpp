@@ -0,0 +1,222 @@
+#include "CompiledUI.h"
+
+static const char COMPILED_UI_MAGIC[] = "SMUI";
+// Версию нужно увеличивать при изменении формата.
+static const unsigned COMPILED_UI_VERSION = 3;
+
+// Размер и время изменения исходного файла в папке с ресурсами.
+// Возвращает false, если файла в папке нет (например, он в пакете).
+static bool GetSourceStamp(Context* context, const char* name, unsigned& size, unsigned& modifiedTime)
+{
+    String fileName = context->GetSubsystem<ResourceCache>()->GetResourceFileName(name);
+    if (fileName.Empty())
+        return false;
+
+    File file(context, fileName);
+    size = file.GetSize();
+    modifiedTime = context->GetSubsystem<FileSystem>()->GetLastModifiedTime(fileName);
+    return true;
+}
+
+// Элементы в порядке обхода дерева (как в UIElement::GetChild с рекурсией).
+// Внутренние элементы создаются своими родителями, поэтому не сохраняются.
+static void CollectElements(UIElement* parent, int parentIndex, PODVector<UIElement*>& elements, PODVector<int>& parents)
+{
+    const Vector<SharedPtr<UIElement> >& children = parent->GetChildren();
+    foreach(const SharedPtr<UIElement>& child, children)
+    {
+        if (child->IsInternal())
+            continue;
+
+        elements.Push(child);
+        parents.Push(parentIndex);
+        CollectElements(child, elements.Size() - 1, elements, parents);
+    }
+}
+
+bool CompiledUI::Save(Context* context, UIElement* root, const char* const* sourceNames, unsigned numSources,
+    const char* const* handleNames, unsigned numHandles, const String& fileName)
+{
+    PODVector<UIElement*> elements;
+    PODVector<int> parents;
+    CollectElements(root, -1, elements, parents);
+
+    PODVector<unsigned> handleIndices;
+    for (unsigned i = 0; i < numHandles; i++)
+    {
+        unsigned index = 0;
+        while (index < elements.Size() && elements[index]->GetName() != handleNames[i])
+            index++;
+
+        if (index == elements.Size())
+        {
+            URHO3D_LOGERROR("UI element " + String(handleNames[i]) + " not found");
+            return false;
+        }
+
+        handleIndices.Push(index);
+    }
+
+    File file(context, fileName, FILE_WRITE);
+    if (!file.IsOpen())
+    {
+        URHO3D_LOGERROR("Can't open " + fileName + " for writing");
+        return false;
+    }
+
+    file.WriteFileID(COMPILED_UI_MAGIC);
+    file.WriteUInt(COMPILED_UI_VERSION);
+
+    file.WriteUInt(numSources);
+    for (unsigned i = 0; i < numSources; i++)
+    {
+        unsigned size = 0;
+        unsigned modifiedTime = 0;
+        GetSourceStamp(context, sourceNames[i], size, modifiedTime);
+
+        file.WriteUInt(StringHash(sourceNames[i]).Value());
+        file.WriteUInt(size);
+        file.WriteUInt(modifiedTime);
+    }
+
+    file.WriteUInt(numHandles);
+    for (unsigned i = 0; i < numHandles; i++)
+    {
+        file.WriteUInt(StringHash(handleNames[i]).Value());
+        file.WriteUInt(handleIndices[i]);
+    }
+
+    file.WriteUInt(elements.Size());
+    for (unsigned i = 0; i < elements.Size(); i++)
+    {
+        UIElement* element = elements[i];
+        file.WriteUInt(element->GetType().Value());
+        file.WriteInt(parents[i]);
+        file.WriteUInt(element->GetNumAttributes());
+        if (!element->Save(file))
+        {
+            URHO3D_LOGERROR("Can't save UI element " + element->GetName());
+            return false;
+        }
+    }
+
+    URHO3D_LOGINFO("UI with " + String(elements.Size()) + " elements saved to " + fileName);
+    return true;
+}
+
+bool CompiledUI::Load(Context* context, const String& resourceName, UIElement* root,
+    const char* const* sourceNames, unsigned numSources,
+    const char* const* handleNames, unsigned numHandles, PODVector<UIElement*>& handles)
+{
+    ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+    SharedPtr<File> file = cache->GetFile(resourceName, false);
+    if (!file)
+        return false;
+
+    if (file->ReadFileID() != COMPILED_UI_MAGIC || file->ReadUInt() != COMPILED_UI_VERSION ||
+        file->ReadUInt() != numSources)
+    {
+        URHO3D_LOGWARNING("Compiled UI " + resourceName + " is outdated");
+        return false;
+    }
+
+    for (unsigned i = 0; i < numSources; i++)
+    {
+        unsigned nameHash = file->ReadUInt();
+        unsigned savedSize = file->ReadUInt();
+        unsigned savedModifiedTime = file->ReadUInt();
+
+        unsigned size;
+        unsigned modifiedTime;
+        bool changed = nameHash != StringHash(sourceNames[i]).Value() ||
+            (GetSourceStamp(context, sourceNames[i], size, modifiedTime) &&
+            (size != savedSize || modifiedTime != savedModifiedTime));
+
+        if (changed)
+        {
+            URHO3D_LOGWARNING("Compiled UI " + resourceName + " is outdated (" + String(sourceNames[i]) + " changed)");
+            return false;
+        }
+    }
+
+    if (file->ReadUInt() != numHandles)
+    {
+        URHO3D_LOGWARNING("Compiled UI " + resourceName + " is outdated");
+        return false;
+    }
+
+    PODVector<unsigned> handleIndices;
+    for (unsigned i = 0; i < numHandles; i++)
+    {
+        if (file->ReadUInt() != StringHash(handleNames[i]).Value())
+        {
+            URHO3D_LOGWARNING("Compiled UI " + resourceName + " is outdated");
+            return false;
+        }
+
+        handleIndices.Push(file->ReadUInt());
+    }
+
+    // Элементы добавляются в root только после успешного чтения всего файла.
+    unsigned numElements = file->ReadUInt();
+    Vector<SharedPtr<UIElement> > elements;
+    PODVector<int> parents;
+
+    for (unsigned i = 0; i < numElements; i++)
+    {
+        StringHash type(file->ReadUInt());
+        int parent = file->ReadInt();
+        unsigned numAttributes = file->ReadUInt();
+
+        SharedPtr<UIElement> element = DynamicCast<UIElement>(context->CreateObject(type));
+        if (!element || parent >= (int)i || numAttributes != element->GetNumAttributes() ||
+            !element->Load(*file))
+        {
+            URHO3D_LOGWARNING("Compiled UI " + resourceName + " is outdated");
+            return false;
+        }
+
+        element->ApplyAttributes();
+        elements.Push(element);
+        parents.Push(parent);
+    }
+
+    foreach(unsigned index, handleIndices)
+    {
+        if (index >= numElements)
+        {
+            URHO3D_LOGWARNING("Compiled UI " + resourceName + " is outdated");
+            return false;
+        }
+    }
+
+    for (unsigned i = 0; i < numElements; i++)
+    {
+        UIElement* parent = parents[i] < 0 ? root : elements[parents[i]].Get();
+        parent->AddChild(elements[i]);
+    }
+
+    handles.Resize(numHandles);
+    for (unsigned i = 0; i < numHandles; i++)
+        handles[i] = elements[handleIndices[i]];
+
+    return true;
+}
+
+bool CompiledUI::FindHandles(UIElement* root, const char* const* handleNames, unsigned numHandles,
+    PODVector<UIElement*>& handles)
+{
+    handles.Resize(numHandles);
+
+    for (unsigned i = 0; i < numHandles; i++)
+    {
+        handles[i] = root->GetChild(String(handleNames[i]), true);
+        if (!handles[i])
+        {
+            URHO3D_LOGERROR("UI element " + String(handleNames[i]) + " not found");
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,50 @@
+/*
+Интерфейс в скомпилированном виде.
+
+Интерфейс описан в XML (стиль UI/Style.xml и макеты UI/StartMenu.xml, UI/GameOver.xml).
+Их разбор, применение стилей и поиск элементов по именам при старте заметно
+замедляют создание интерфейса. Поэтому дерево элементов заранее сохраняется
+в двоичный файл (ключ командной строки -build-ui <файл>): элементы идут подряд
+в порядке обхода дерева, у каждого элемента записаны тип, индекс родителя и значения
+атрибутов после применения стилей. При старте элементы создаются за один проход
+по файлу без XML и стилей.
+
+Код обращается к элементам не по именам, а по индексам (handles). Имена
+нужных элементов передаются при сборке, и в файл записываются индексы найденных
+элементов. Если набор имен в коде изменился, файл считается устаревшим.
+
+Атрибуты записываются в двоичном виде, поэтому файл нужно пересобирать
+после изменения макетов или стилей, а также после обновления движка
+(количество атрибутов каждого типа проверяется при загрузке). Файл не хранится
+в репозитории: после каждой сборки игры CMake запускает ее с ключом -build-ui
+и записывает GameData/UI/Compiled.bin (опция SOULMATES_BUILD_UI).
+
+В файле хранятся размеры и время изменения всех исходных XML. Если исходный XML
+лежит в папке (при разработке) и его размер или время изменения не совпадают,
+то скомпилированный интерфейс не используется и игра создает интерфейс из XML.
+Содержимое файлов при этом не читается. Исходники внутри пакета не проверяются:
+пакет собирается вместе со скомпилированным интерфейсом.
+*/
+
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+class CompiledUI
+{
+public:
+    // Сохраняет все элементы внутри root (сам root не сохраняется).
+    // sourceNames - ресурсы, из которых создан интерфейс. Элемент для каждого имени из handleNames должен существовать.
+    static bool Save(Context* context, UIElement* root, const char* const* sourceNames, unsigned numSources,
+        const char* const* handleNames, unsigned numHandles, const String& fileName);
+
+    // Создает элементы из файла и добавляет их в root. В handles записываются элементы
+    // с именами handleNames. Если файла нет или он устарел (в том числе изменился
+    // какой-то из sourceNames), то возвращает false и ничего не создает.
+    static bool Load(Context* context, const String& resourceName, UIElement* root,
+        const char* const* sourceNames, unsigned numSources,
+        const char* const* handleNames, unsigned numHandles, PODVector<UIElement*>& handles);
+
+    // Находит элементы по именам (для интерфейса, созданного из XML).
+    static bool FindHandles(UIElement* root, const char* const* handleNames, unsigned numHandles,
+        PODVector<UIElement*>& handles);
+};
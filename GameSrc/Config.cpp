@@ -25,14 +25,19 @@ void Config::Load()
     if (xmlFile_->GetRoot().IsNull())
         xmlFile_->CreateRoot("Config");
 
-    // Создаем таблицу рекордов, если она отсутствует.
+    // Рекорды разбираются один раз при загрузке, а в XML записываются только при сохранении.
     XMLElement table = xmlFile_->GetRoot().GetChild("Records");
-    if (table.IsNull())
-        xmlFile_->GetRoot().CreateChild("Records");
+    if (table.NotNull())
+        records_.Load(table);
 }
 
 void Config::Save()
 {
+    XMLElement root = xmlFile_->GetRoot();
+    root.RemoveChildren("Records");
+    XMLElement table = root.CreateChild("Records");
+    records_.Save(table);
+
     String fileName = GetConfigFileName();
     File file(context_, fileName, FILE_WRITE);
     xmlFile_->Save(file);
@@ -59,19 +64,3 @@ void Config::SetInt(const String& name, int value)
     XMLElement root = xmlFile_->GetRoot();
     root.SetInt(name, value);
 }
-
-void Config::SetRecord(String boardMode, int value)
-{
-    // Нет смысла хранить нулевые рекорды.
-    if (value == 0)
-        return;
-
-    XMLElement table = xmlFile_->GetRoot().GetChild("Records");
-    table.SetAttribute(boardMode, String(value));
-}
-
-int Config::GetRecord(String boardMode)
-{
-    XMLElement table = xmlFile_->GetRoot().GetChild("Records");
-    return ToInt(table.GetAttribute(boardMode));
-}
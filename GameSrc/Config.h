@@ -3,7 +3,7 @@
 */
 
 #pragma once
-#include <Urho3D/Urho3DAll.h>
+#include "RecordTable.h"
 
 #define CONFIG GetSubsystem<Config>()
 
@@ -21,12 +21,11 @@ public:
     int GetInt(const String& name, int defaultValue, int clampMin, int clampMax);
     void SetInt(const String& name, int value);
 
-    int GetRecord(String boardMode);
-    void SetRecord(String boardMode, int value);
+    RecordTable& GetRecords() { return records_; }
 
 private:
     SharedPtr<XMLFile> xmlFile_;
-    HashMap<unsigned, int> records_;
+    RecordTable records_;
 
     String GetConfigFileName();
 };
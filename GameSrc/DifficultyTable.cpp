@@ -0,0 +1,328 @@
+#include "DifficultyTable.h"
+#include "BoardState.h"
+#include "TraceProfiler.h"
+
+// Заголовок файла таблицы.
+struct DifficultyHeader
+{
+    char magic_[4];
+    unsigned version_;
+    unsigned numProfiles_;
+    // Сколько партий проигрывалось для каждого режима.
+    unsigned numGames_;
+};
+
+static const char DIFFICULTY_MAGIC[4] = { 'S', 'M', 'D', 'T' };
+// Версию нужно увеличивать при изменении формата, правил игры или жадного игрока.
+static const unsigned DIFFICULTY_VERSION = 1;
+
+static const int survivalMoves[DIFFICULTY_NUM_SURVIVAL_POINTS] = { 10, 25, 50, 100, 150, 200, 300, 400 };
+
+static const int NUM_WIDTHS = MAX_BOARD_WIDTH - MIN_BOARD_WIDTH + 1;
+static const int NUM_HEIGHTS = MAX_BOARD_HEIGHT - MIN_BOARD_HEIGHT + 1;
+static const int NUM_COLOR_COUNTS = MAX_NUM_COLORS - MIN_NUM_COLORS + 1;
+
+static int GetNumPopulations(int width, int height)
+{
+    return BoardMode::GetMaxPopulation(width, height) + 1;
+}
+
+static int GetNumLineLengths(int width, int height)
+{
+    return BoardMode::GetMaxLineLength(width, height) - MIN_LINE_LENGTH + 1;
+}
+
+// Режимы упорядочены по ширине, высоте, числу цветов, населению, длине линии и диагонали.
+// Количество вариантов населения и длины линии зависит от размеров поля,
+// поэтому для каждой пары "ширина + высота" заранее вычисляется смещение ее блока.
+struct DifficultyIndex
+{
+    int offsets_[NUM_WIDTHS][NUM_HEIGHTS];
+    unsigned numModes_;
+
+    DifficultyIndex()
+    {
+        numModes_ = 0;
+
+        for (int w = 0; w < NUM_WIDTHS; w++)
+        {
+            for (int h = 0; h < NUM_HEIGHTS; h++)
+            {
+                int width = w + MIN_BOARD_WIDTH;
+                int height = h + MIN_BOARD_HEIGHT;
+                offsets_[w][h] = numModes_;
+                numModes_ += NUM_COLOR_COUNTS * GetNumPopulations(width, height) * GetNumLineLengths(width, height) * 2;
+            }
+        }
+    }
+};
+
+static const DifficultyIndex& GetDifficultyIndex()
+{
+    static const DifficultyIndex index;
+    return index;
+}
+
+DifficultyTable::DifficultyTable() :
+    profiles_(nullptr),
+    numProfiles_(0)
+{
+}
+
+int DifficultyTable::GetIndex(const BoardMode& mode)
+{
+    if (mode.width_ < MIN_BOARD_WIDTH || mode.width_ > MAX_BOARD_WIDTH ||
+        mode.height_ < MIN_BOARD_HEIGHT || mode.height_ > MAX_BOARD_HEIGHT ||
+        mode.numColors_ < MIN_NUM_COLORS || mode.numColors_ > MAX_NUM_COLORS)
+    {
+        return -1;
+    }
+
+    int numPopulations = GetNumPopulations(mode.width_, mode.height_);
+    int numLineLengths = GetNumLineLengths(mode.width_, mode.height_);
+    int lineLengthIndex = mode.lineLength_ - MIN_LINE_LENGTH;
+
+    if (mode.population_ < 0 || mode.population_ >= numPopulations ||
+        lineLengthIndex < 0 || lineLengthIndex >= numLineLengths)
+    {
+        return -1;
+    }
+
+    int offset = GetDifficultyIndex().offsets_[mode.width_ - MIN_BOARD_WIDTH][mode.height_ - MIN_BOARD_HEIGHT];
+    int index = (mode.numColors_ - MIN_NUM_COLORS) * numPopulations + mode.population_;
+    index = index * numLineLengths + lineLengthIndex;
+    return offset + index * 2 + (mode.diagonal_ ? 1 : 0);
+}
+
+unsigned DifficultyTable::GetNumModes()
+{
+    return GetDifficultyIndex().numModes_;
+}
+
+int DifficultyTable::GetSurvivalMoves(unsigned point)
+{
+    return point < DIFFICULTY_NUM_SURVIVAL_POINTS ? survivalMoves[point] : 0;
+}
+
+const DifficultyProfile* DifficultyTable::GetProfile(const BoardMode& mode) const
+{
+    if (!profiles_)
+        return nullptr;
+
+    int index = GetIndex(mode);
+    if (index < 0 || (unsigned)index >= numProfiles_)
+        return nullptr;
+
+    return &profiles_[index];
+}
+
+bool DifficultyTable::Load(Context* context, const String& resourceName)
+{
+    profiles_ = nullptr;
+    numProfiles_ = 0;
+    mappedFile_.Close();
+    buffer_.Clear();
+
+    ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+
+    // Файл в папке с ресурсами отображается в память.
+    String fileName = cache->GetResourceFileName(resourceName);
+    if (!fileName.Empty() && mappedFile_.Open(fileName))
+        return SetData(mappedFile_.GetData(), mappedFile_.GetSize());
+
+    SharedPtr<File> file = cache->GetFile(resourceName, false);
+    if (!file)
+        return false;
+
+    buffer_.Resize(file->GetSize());
+    if (buffer_.Empty() || file->Read(&buffer_[0], buffer_.Size()) != buffer_.Size())
+        return false;
+
+    return SetData(&buffer_[0], buffer_.Size());
+}
+
+bool DifficultyTable::SetData(const unsigned char* data, unsigned size)
+{
+    const DifficultyHeader* header = reinterpret_cast<const DifficultyHeader*>(data);
+
+    if (size < sizeof(DifficultyHeader) || memcmp(header->magic_, DIFFICULTY_MAGIC, 4) != 0 ||
+        header->version_ != DIFFICULTY_VERSION || header->numProfiles_ != GetNumModes() ||
+        size < sizeof(DifficultyHeader) + header->numProfiles_ * sizeof(DifficultyProfile))
+    {
+        URHO3D_LOGWARNING("Difficulty table is invalid or outdated");
+        return false;
+    }
+
+    profiles_ = reinterpret_cast<const DifficultyProfile*>(data + sizeof(DifficultyHeader));
+    numProfiles_ = header->numProfiles_;
+    return true;
+}
+
+void DifficultyTable::SimulateMode(const BoardMode& mode, unsigned numGames, unsigned seed, DifficultyProfile& result)
+{
+    PODVector<int> gameMoves;
+    gameMoves.Resize(numGames);
+    unsigned totalScore = 0;
+
+    for (unsigned game = 0; game < numGames; game++)
+    {
+        BoardState state;
+        state.Reset(mode, seed * 2654435761u + game * 40503u + 1);
+        state.Populate(mode.population_);
+
+        // Линии, которые оказались на поле при создании, тоже идут в счет.
+        int score = state.Settle();
+        int numMoves = 0;
+
+        while (numMoves < DIFFICULTY_MAX_MOVES && !state.IsGameOver())
+        {
+            IntVector2 cells[MAX_BORDER_CELLS];
+            int numCells = state.GetPushes(cells);
+            if (!numCells)
+                break;
+
+            // Жадный игрок не знает цвета новых юнитов, поэтому пробует ходы с другим зерном.
+            int best = 0;
+            int bestValue = M_MIN_INT;
+            for (int i = 0; i < numCells; i++)
+            {
+                BoardState next = state;
+                next.SetRandomSeed(state.GetRandomSeed() ^ 0x5BD1E995);
+                next.Push(cells[i].x_, cells[i].y_);
+
+                int value = next.Settle();
+                if (next.IsGameOver())
+                    value -= DIFFICULTY_MAX_MOVES;
+
+                if (value > bestValue)
+                {
+                    bestValue = value;
+                    best = i;
+                }
+            }
+
+            state.Push(cells[best].x_, cells[best].y_);
+            score += state.Settle();
+            numMoves++;
+        }
+
+        gameMoves[game] = numMoves;
+        totalScore += score;
+    }
+
+    Sort(gameMoves.Begin(), gameMoves.End());
+
+    result.meanScore_ = (unsigned short)Min(totalScore / Max(numGames, 1u), 65535u);
+    result.movesP10_ = (unsigned short)gameMoves[numGames * 10 / 100];
+    result.movesP50_ = (unsigned short)gameMoves[numGames * 50 / 100];
+    result.movesP90_ = (unsigned short)gameMoves[numGames * 90 / 100];
+
+    for (unsigned point = 0; point < DIFFICULTY_NUM_SURVIVAL_POINTS; point++)
+    {
+        unsigned numSurvived = 0;
+        for (unsigned game = 0; game < numGames; game++)
+        {
+            if (gameMoves[game] >= survivalMoves[point])
+                numSurvived++;
+        }
+
+        result.survival_[point] = (unsigned char)(numSurvived * 255 / numGames);
+    }
+}
+
+// Задача для рабочего потока: все режимы с одинаковыми шириной, высотой и числом цветов.
+struct DifficultyBuildBlock
+{
+    int width_;
+    int height_;
+    int numColors_;
+    unsigned numGames_;
+    DifficultyProfile* profiles_;
+};
+
+static void BuildBlockWork(const WorkItem* item, unsigned threadIndex)
+{
+    GAME_PROFILE(BuildDifficultyBlock);
+
+    const DifficultyBuildBlock* block = static_cast<const DifficultyBuildBlock*>(item->start_);
+
+    BoardMode mode;
+    mode.width_ = block->width_;
+    mode.height_ = block->height_;
+    mode.numColors_ = block->numColors_;
+
+    int maxPopulation = BoardMode::GetMaxPopulation(mode.width_, mode.height_);
+    int maxLineLength = BoardMode::GetMaxLineLength(mode.width_, mode.height_);
+
+    for (mode.population_ = 0; mode.population_ <= maxPopulation; mode.population_++)
+    {
+        for (mode.lineLength_ = MIN_LINE_LENGTH; mode.lineLength_ <= maxLineLength; mode.lineLength_++)
+        {
+            for (int diagonal = 0; diagonal < 2; diagonal++)
+            {
+                mode.diagonal_ = diagonal != 0;
+                int index = DifficultyTable::GetIndex(mode);
+                DifficultyTable::SimulateMode(mode, block->numGames_, index + 1, block->profiles_[index]);
+            }
+        }
+    }
+}
+
+bool DifficultyTable::Build(Context* context, const String& fileName, unsigned numGames)
+{
+    HiresTimer timer;
+
+    PODVector<DifficultyProfile> profiles;
+    profiles.Resize(GetNumModes());
+
+    PODVector<DifficultyBuildBlock> blocks;
+    for (int width = MIN_BOARD_WIDTH; width <= MAX_BOARD_WIDTH; width++)
+    {
+        for (int height = MIN_BOARD_HEIGHT; height <= MAX_BOARD_HEIGHT; height++)
+        {
+            for (int numColors = MIN_NUM_COLORS; numColors <= MAX_NUM_COLORS; numColors++)
+            {
+                DifficultyBuildBlock block;
+                block.width_ = width;
+                block.height_ = height;
+                block.numColors_ = numColors;
+                block.numGames_ = Max(numGames, 1u);
+                block.profiles_ = &profiles[0];
+                blocks.Push(block);
+            }
+        }
+    }
+
+    // Главный поток тоже участвует в расчете, пока ждет завершения задач.
+    WorkQueue* workQueue = context->GetSubsystem<WorkQueue>();
+    for (unsigned i = 0; i < blocks.Size(); i++)
+    {
+        SharedPtr<WorkItem> item = workQueue->GetFreeItem();
+        item->workFunction_ = BuildBlockWork;
+        item->start_ = &blocks[i];
+        item->priority_ = M_MAX_UNSIGNED;
+        item->sendEvent_ = false;
+        workQueue->AddWorkItem(item);
+    }
+    workQueue->Complete(M_MAX_UNSIGNED);
+
+    File file(context, fileName, FILE_WRITE);
+    if (!file.IsOpen())
+    {
+        URHO3D_LOGERROR("Can't open " + fileName + " for writing");
+        return false;
+    }
+
+    DifficultyHeader header;
+    memcpy(header.magic_, DIFFICULTY_MAGIC, 4);
+    header.version_ = DIFFICULTY_VERSION;
+    header.numProfiles_ = profiles.Size();
+    header.numGames_ = Max(numGames, 1u);
+    file.Write(&header, sizeof(header));
+    file.Write(&profiles[0], profiles.Size() * sizeof(DifficultyProfile));
+
+    URHO3D_LOGINFO("Difficulty table with " + String(profiles.Size()) + " modes saved to " + fileName +
+        " in " + String(timer.GetUSec(false) / 1000000.0f) + " s");
+
+    return true;
+}
@@ -0,0 +1,73 @@
+/*
+Профили сложности для всех режимов игры.
+
+Профили рассчитываются заранее (ключ командной строки -build-difficulty):
+для каждого допустимого режима рабочие потоки проигрывают несколько партий
+жадным игроком, который всегда выбирает толчок, удаляющий больше всего юнитов.
+Результат сохраняется в файл Difficulty.bin, который поставляется вместе с игрой.
+
+Файл состоит из заголовка и плотного массива профилей фиксированного размера.
+Индекс режима в массиве вычисляется за постоянное время (см. GetIndex),
+поэтому файл не разбирается при загрузке, а просто отображается в память.
+*/
+
+#pragma once
+#include "BoardMode.h"
+#include "MappedFile.h"
+
+// Точки кривой выживания: доля партий, которые продлились хотя бы столько ходов.
+#define DIFFICULTY_NUM_SURVIVAL_POINTS 8
+
+// Партии длиннее этого обрываются (считается, что игрок выжил).
+#define DIFFICULTY_MAX_MOVES 500
+
+// Сколько партий проигрывается для каждого режима.
+#define DIFFICULTY_NUM_GAMES 16
+
+// Структура хранится в файле как есть, поэтому ее размер не должен меняться.
+struct DifficultyProfile
+{
+    // Средний счет.
+    unsigned short meanScore_;
+    // Длина партии в ходах: 10-й, 50-й и 90-й процентили.
+    unsigned short movesP10_;
+    unsigned short movesP50_;
+    unsigned short movesP90_;
+    // Доля выживших партий (0 - 255) после GetSurvivalMoves(i) ходов.
+    unsigned char survival_[DIFFICULTY_NUM_SURVIVAL_POINTS];
+};
+
+class DifficultyTable
+{
+public:
+    DifficultyTable();
+
+    // Загружает таблицу из ресурсов. Если файл лежит в папке с ресурсами,
+    // то он отображается в память, иначе читается целиком.
+    bool Load(Context* context, const String& resourceName);
+    bool IsLoaded() const { return profiles_ != nullptr; }
+
+    // Возвращает nullptr, если таблица не загружена или режим недопустим.
+    const DifficultyProfile* GetProfile(const BoardMode& mode) const;
+
+    // Индекс режима в таблице или -1, если режим недопустим.
+    static int GetIndex(const BoardMode& mode);
+    // Общее количество допустимых режимов.
+    static unsigned GetNumModes();
+    static int GetSurvivalMoves(unsigned point);
+
+    // Проигрывает партии жадным игроком. Не использует движок, можно вызывать из любого потока.
+    static void SimulateMode(const BoardMode& mode, unsigned numGames, unsigned seed, DifficultyProfile& result);
+    // Рассчитывает профили для всех режимов в рабочих потоках и сохраняет таблицу в файл.
+    static bool Build(Context* context, const String& fileName, unsigned numGames = DIFFICULTY_NUM_GAMES);
+
+private:
+    MappedFile mappedFile_;
+    // Используется, если файл нельзя отобразить в память (например, он в пакете).
+    PODVector<unsigned char> buffer_;
+
+    const DifficultyProfile* profiles_;
+    unsigned numProfiles_;
+
+    bool SetData(const unsigned char* data, unsigned size);
+};
@@ -0,0 +1,283 @@
+#include "FrameBenchmark.h"
+#include "InputScript.h"
+#include "AllocationTracker.h"
+#include "Urho3DAliases.h"
+
+// Допустимое превышение эталона, если оно не указано в файле эталона.
+static const float DEFAULT_TOLERANCE = 0.25f;
+// Абсолютные допуски, чтобы не реагировать на шум при очень маленьких значениях.
+static const float TIME_SLACK_MS = 0.1f;
+static const float ALLOCS_SLACK = 1.0f;
+
+FrameBenchmark::FrameBenchmark(Context* context) :
+    Object(context)
+{
+}
+
+bool FrameBenchmark::Start(const String& corpusName, const String& baselineName, const String& resultFileName)
+{
+    XMLFile* corpus = GET_XML_FILE(corpusName);
+    if (!corpus)
+        return false;
+
+    for (XMLElement element = corpus->GetRoot().GetChild("session"); element.NotNull();
+        element = element.GetNext("session"))
+    {
+        Session session;
+        session.name_ = element.GetAttribute("name");
+        session.scriptFileName_ = CACHE->GetResourceFileName(element.GetAttribute("script"));
+
+        if (session.scriptFileName_.Empty())
+        {
+            URHO3D_LOGERROR("Benchmark script " + element.GetAttribute("script") + " not found");
+            failed_ = true;
+            continue;
+        }
+
+        sessions_.Push(session);
+    }
+
+    if (sessions_.Empty())
+        return false;
+
+    // Без эталона проверка прошла бы всегда, поэтому сравнение отключается только явно.
+    if (baselineName.Compare("none", false) != 0)
+    {
+        if (!CACHE->Exists(baselineName))
+        {
+            URHO3D_LOGERROR("Benchmark baseline " + baselineName + " not found (use -baseline none to record one)");
+            return false;
+        }
+
+        baselineName_ = baselineName;
+    }
+
+    if (!IsAllocationTrackingEnabled())
+        URHO3D_LOGERROR("Allocation tracking is compiled out (SOULMATES_TRACK_ALLOCATIONS), allocations are not measured");
+
+    resultFileName_ = resultFileName;
+
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(FrameBenchmark, HandleBeginFrame));
+    SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(FrameBenchmark, HandleEndFrame));
+
+    // Без графики рендеринга нет, поэтому кадр заканчивается после обновления логики.
+    if (ENGINE->IsHeadless())
+        SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(FrameBenchmark, HandleFrameWorkDone));
+    else
+        SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(FrameBenchmark, HandleFrameWorkDone));
+
+    // Ограничитель ФПС не должен влиять на замеры.
+    ENGINE->SetMaxFps(0);
+    if (GRAPHICS)
+        GRAPHICS->SetVSync(false);
+
+    // Игра завершается не после скрипта, а после всего корпуса.
+    INPUT_SCRIPT->SetExitOnFinish(false);
+
+    currentSession_ = 0;
+    StartSession();
+    return true;
+}
+
+void FrameBenchmark::StartSession()
+{
+    const Session& session = sessions_[currentSession_];
+    URHO3D_LOGINFO("Benchmark session " + session.name_);
+
+    frameTimes_.Clear();
+    frameAllocs_.Clear();
+
+    // Каждая сессия начинается со стартового меню.
+    GLOBAL->neededGameState_ = GS_START_MENU;
+    sessionRunning_ = INPUT_SCRIPT->Play(session.scriptFileName_);
+
+    if (!sessionRunning_)
+        failed_ = true;
+}
+
+void FrameBenchmark::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    frameTimer_.Reset();
+    frameAllocStart_ = GetAllocationCount();
+}
+
+void FrameBenchmark::HandleFrameWorkDone(StringHash eventType, VariantMap& eventData)
+{
+    if (!sessionRunning_)
+        return;
+
+    frameTimes_.Push(frameTimer_.GetUSec(false) / 1000.0f);
+    frameAllocs_.Push((unsigned)(GetAllocationCount() - frameAllocStart_));
+}
+
+void FrameBenchmark::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (INPUT_SCRIPT->IsPlaying())
+        return;
+
+    if (sessionRunning_)
+        FinishSession();
+
+    currentSession_++;
+    if (currentSession_ < sessions_.Size())
+        StartSession();
+    else
+        Finish();
+}
+
+static float Percentile(const PODVector<float>& sortedValues, float fraction)
+{
+    if (sortedValues.Empty())
+        return 0.0f;
+
+    unsigned index = (unsigned)(fraction * (sortedValues.Size() - 1) + 0.5f);
+    return sortedValues[index];
+}
+
+void FrameBenchmark::FinishSession()
+{
+    sessionRunning_ = false;
+
+    PODVector<float> sortedTimes = frameTimes_;
+    Sort(sortedTimes.Begin(), sortedTimes.End());
+
+    Result result;
+    result.name_ = sessions_[currentSession_].name_;
+    result.numFrames_ = frameTimes_.Size();
+    result.p50_ = Percentile(sortedTimes, 0.5f);
+    result.p99_ = Percentile(sortedTimes, 0.99f);
+    result.max_ = sortedTimes.Empty() ? 0.0f : sortedTimes.Back();
+
+    unsigned long long allocsTotal = 0;
+    result.allocsMax_ = 0;
+    for (unsigned i = 0; i < frameAllocs_.Size(); i++)
+    {
+        allocsTotal += frameAllocs_[i];
+        result.allocsMax_ = Max(result.allocsMax_, frameAllocs_[i]);
+    }
+    result.allocsMean_ = frameAllocs_.Empty() ? 0.0f : (float)allocsTotal / frameAllocs_.Size();
+
+    results_.Push(result);
+}
+
+void FrameBenchmark::Finish()
+{
+    UnsubscribeFromAllEvents();
+
+    CompareWithBaseline();
+    SaveResults();
+
+    URHO3D_LOGINFO(failed_ ? "Benchmark FAILED" : "Benchmark passed");
+    ENGINE->Exit();
+}
+
+// Возвращает true, если значение укладывается в допуск.
+static bool CheckMetric(const String& sessionName, const String& metricName,
+    float value, const XMLElement& baseline, float tolerance, float slack)
+{
+    if (!baseline.HasAttribute(metricName))
+        return true;
+
+    float baseValue = baseline.GetFloat(metricName);
+    float limit = baseValue * (1.0f + tolerance) + slack;
+
+    if (value <= limit)
+        return true;
+
+    URHO3D_LOGERROR(ToString("%s: %s = %.3f exceeds baseline %.3f (limit %.3f)",
+        sessionName.CString(), metricName.CString(), value, baseValue, limit));
+    return false;
+}
+
+void FrameBenchmark::CompareWithBaseline()
+{
+    foreach(const Result& result, results_)
+    {
+        URHO3D_LOGINFO(ToString("%s: %u frames, p50 %.3f ms, p99 %.3f ms, max %.3f ms, allocs/frame %.1f (max %u)",
+            result.name_.CString(), result.numFrames_, result.p50_, result.p99_, result.max_,
+            result.allocsMean_, result.allocsMax_));
+    }
+
+    if (baselineName_.Empty())
+    {
+        URHO3D_LOGWARNING("Benchmark baseline disabled, comparison skipped");
+        return;
+    }
+
+    XMLFile* baselineFile = GET_XML_FILE(baselineName_);
+    if (!baselineFile)
+    {
+        failed_ = true;
+        return;
+    }
+
+    XMLElement root = baselineFile->GetRoot();
+    bool trackAllocations = IsAllocationTrackingEnabled();
+    float tolerance = root.HasAttribute("tolerance") ? root.GetFloat("tolerance") : DEFAULT_TOLERANCE;
+
+    foreach(const Result& result, results_)
+    {
+        XMLElement baseline = root.GetChild("session");
+        while (baseline.NotNull() && baseline.GetAttribute("name") != result.name_)
+            baseline = baseline.GetNext("session");
+
+        if (baseline.IsNull())
+        {
+            URHO3D_LOGERROR("No baseline for session " + result.name_);
+            failed_ = true;
+            continue;
+        }
+
+        // Проверяем все показатели, чтобы в логе были видны все превышения.
+        bool ok = CheckMetric(result.name_, "p50", result.p50_, baseline, tolerance, TIME_SLACK_MS);
+        ok = CheckMetric(result.name_, "p99", result.p99_, baseline, tolerance, TIME_SLACK_MS) && ok;
+        ok = CheckMetric(result.name_, "max", result.max_, baseline, tolerance, TIME_SLACK_MS) && ok;
+
+        if (trackAllocations)
+        {
+            ok = CheckMetric(result.name_, "allocs", result.allocsMean_, baseline, tolerance, ALLOCS_SLACK) && ok;
+        }
+        else if (baseline.HasAttribute("allocs"))
+        {
+            URHO3D_LOGERROR(result.name_ + ": baseline has allocations, but this build does not count them");
+            ok = false;
+        }
+
+        if (!ok)
+            failed_ = true;
+    }
+}
+
+void FrameBenchmark::SaveResults()
+{
+    String fileName = resultFileName_;
+    if (fileName.Empty())
+        fileName = FILE_SYSTEM->GetAppPreferencesDir("1vanK", "Soulmates") + "Benchmark.xml";
+
+    SharedPtr<XMLFile> xmlFile(new XMLFile(context_));
+    XMLElement root = xmlFile->CreateRoot("baseline");
+    root.SetFloat("tolerance", DEFAULT_TOLERANCE);
+
+    foreach(const Result& result, results_)
+    {
+        XMLElement element = root.CreateChild("session");
+        element.SetAttribute("name", result.name_);
+        element.SetUInt("frames", result.numFrames_);
+        element.SetFloat("p50", result.p50_);
+        element.SetFloat("p99", result.p99_);
+        element.SetFloat("max", result.max_);
+
+        // Нулевые значения без подсчета выделений в эталон не попадают.
+        if (IsAllocationTrackingEnabled())
+        {
+            element.SetFloat("allocs", result.allocsMean_);
+            element.SetUInt("allocsMax", result.allocsMax_);
+        }
+    }
+
+    File file(context_, fileName, FILE_WRITE);
+    if (file.IsOpen() && xmlFile->Save(file))
+        URHO3D_LOGINFO("Benchmark results saved to " + fileName);
+    else
+        URHO3D_LOGERROR("Failed to save benchmark results to " + fileName);
+}
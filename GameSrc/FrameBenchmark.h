@@ -0,0 +1,94 @@
+/*
+Проверка производительности по записанным сессиям.
+
+Корпус (Benchmarks/Corpus.xml) содержит список скриптов ввода (см. InputScript.h).
+Скрипты выполняются по очереди. Для каждой сессии собирается время кадра
+на процессоре и количество выделений памяти за кадр (только в сборке
+с SOULMATES_TRACK_ALLOCATIONS, см. AllocationTracker.h), а затем вычисляются
+медиана (p50), 99-й перцентиль (p99) и максимум. Результаты сравниваются
+с эталоном (Benchmarks/Baseline.xml), и если какой-то показатель превышает
+эталонный больше допустимого, игра завершается с кодом ошибки.
+
+Отсутствие эталона или сессии в эталоне тоже считается ошибкой. Если в эталоне
+есть выделения памяти, а игра собрана без их подсчета, проверка не проходит,
+так как сравнивать нечего.
+
+Запуск:
+    Soulmates -benchmark Benchmarks/Corpus.xml [-baseline <ресурс>] [-benchmark-out <файл>]
+Без графики добавьте -headless. Для программного рендеринга через Mesa llvmpipe
+установите переменную окружения LIBGL_ALWAYS_SOFTWARE=1.
+
+Результаты сохраняются в том же формате, что и эталон, поэтому файл
+с результатами можно использовать как новый эталон. Чтобы записать эталон
+без сравнения, укажите -baseline none:
+    Soulmates -benchmark Benchmarks/Corpus.xml -baseline none -benchmark-out Game/GameData/Benchmarks/Baseline.xml
+Эталон записывается на той машине, где он будет проверяться (в сборке
+с SOULMATES_TRACK_ALLOCATIONS, чтобы в нем были выделения памяти).
+*/
+
+#pragma once
+#include "Global.h"
+
+#define FRAME_BENCHMARK GetSubsystem<FrameBenchmark>()
+
+class FrameBenchmark : public Object
+{
+    URHO3D_OBJECT(FrameBenchmark, Object);
+
+public:
+    FrameBenchmark(Context* context);
+
+    // Запускает выполнение корпуса. После последней сессии игра завершается.
+    bool Start(const String& corpusName, const String& baselineName, const String& resultFileName);
+
+    // Хотя бы один показатель хуже эталона.
+    bool IsFailed() const { return failed_; }
+
+private:
+    struct Session
+    {
+        String name_;
+        String scriptFileName_;
+    };
+
+    struct Result
+    {
+        String name_;
+        unsigned numFrames_;
+        // Время кадра в миллисекундах.
+        float p50_;
+        float p99_;
+        float max_;
+        // Выделений памяти за кадр.
+        float allocsMean_;
+        unsigned allocsMax_;
+    };
+
+    Vector<Session> sessions_;
+    unsigned currentSession_ = 0;
+    bool sessionRunning_ = false;
+    Vector<Result> results_;
+
+    // Пустое имя - эталон не используется (-baseline none).
+    String baselineName_;
+    String resultFileName_;
+    bool failed_ = false;
+
+    HiresTimer frameTimer_;
+    unsigned long long frameAllocStart_ = 0;
+    PODVector<float> frameTimes_;
+    PODVector<unsigned> frameAllocs_;
+
+    void StartSession();
+    void FinishSession();
+    void Finish();
+
+    // Сравнивает результаты с эталоном и выводит отчет в лог.
+    void CompareWithBaseline();
+    void SaveResults();
+
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    // Конец работы процессора над кадром (до ожидания ограничителя ФПС).
+    void HandleFrameWorkDone(StringHash eventType, VariantMap& eventData);
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+};
@@ -11,6 +11,22 @@ Soulmates (Родственные души).
 #include "Config.h"
 #include "Urho3DAliases.h"
 #include "CameraLogic.h"
+#include "Preloader.h"
+#include "TraceProfiler.h"
+#include "InputScript.h"
+#include "FrameBenchmark.h"
+#include "GameClock.h"
+#include "LogicThread.h"
+#include "GameEventLog.h"
+#include "HintEngine.h"
+#include "DifficultyTable.h"
+#include "BoardWall.h"
+#include "VersusMode.h"
+#include "QualityGovernor.h"
+#include "TextureBuilder.h"
+#include "ResourcePackage.h"
+#include "PerfHud.h"
+#include "AllocationProfiler.h"
 
 
 class Game : public Application
@@ -24,6 +40,10 @@ public:
         // игры в начале итерации игрового цикла перед возникновением других событий.
         SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(Game, ApplyGameState));
 
+        // Хронология старта отсчитывается с этого момента.
+        context_->RegisterSubsystem(new Preloader(context_));
+        context_->RegisterSubsystem(new TraceProfiler(context_));
+
         BoardLogic::RegisterObject(context_);
         UnitAnimator::RegisterObject(context_);
         MyButton::RegisterObject(context_);
@@ -40,27 +60,261 @@ public:
         // Собственная папка с ресурсами указывается перед стандартными.
         // Таким образом можно подсунуть движку свои ресурсы вместо стандартных.
         engineParameters_["ResourcePaths"] = "GameData;Data;CoreData";
+
+        // Ключ -headless обрабатывается самим движком. Без графики звук тоже не нужен.
+        if (engineParameters_["Headless"].GetBool())
+            engineParameters_["Sound"] = false;
+
+        ParseGameArguments();
+
+        // Контекст GL создается при инициализации движка, поэтому кэш драйвера включается заранее.
+        if (!engineParameters_["Headless"].GetBool())
+            PRELOADER->EnableDriverShaderCache();
+
+        // Запись ресурсов для пакета начинается до инициализации движка,
+        // чтобы в пакет попали и ресурсы, которые загружает сам движок.
+        context_->RegisterSubsystem(new ResourcePackage(context_));
+        if (!packageFileName_.Empty())
+        {
+            RESOURCE_PACKAGE->StartRecording();
+        }
+        else if (FILE_SYSTEM->FileExists(FILE_SYSTEM->GetProgramDir() + RESOURCE_PACKAGE_NAME))
+        {
+            // Папки Data и CoreData целиком входят в пакет. Папка GameData нужна только при разработке.
+            usePackage_ = true;
+            engineParameters_["ResourcePackages"] = RESOURCE_PACKAGE_NAME;
+            engineParameters_["ResourcePaths"] = FILE_SYSTEM->DirExists(FILE_SYSTEM->GetProgramDir() + "GameData") ?
+                "GameData" : "";
+        }
+    }
+
+    // Разбирает собственные ключи командной строки:
+    // -script <файл>   - выполнить скрипт ввода (см. InputScript.h);
+    // -record <файл>   - записать действия игрока в скрипт;
+    // -seed <число>    - зерно генератора случайных чисел игровой логики;
+    // -timestep <сек>  - фиксированный виртуальный шаг времени вместо реального;
+    // -benchmark <ресурс>, -baseline <ресурс|none>, -benchmark-out <файл> - см. FrameBenchmark.h;
+    // -build-difficulty <файл> - рассчитать таблицу сложности режимов и выйти (см. DifficultyTable.h);
+    // -build-textures <манифест> - сжать текстуры и выйти (см. TextureBuilder.h);
+    // -build-ui <файл> - скомпилировать интерфейс и выйти (см. CompiledUI.h);
+    // -wall <число>, -wall-driver <bot,random,replay>, -wall-replay <файл> - стена досок (см. BoardWall.h);
+    // -versus <loopback|порт:порт>, -latency <мс>, -packet-loss <проценты> - игра на двоих (см. VersusMode.h);
+    // -dump-shaders <файл> - записать все использованные варианты шейдеров (см. Preloader.h);
+    // -build-package <файл> - при выходе упаковать все использованные ресурсы (см. ResourcePackage.h);
+    // -alloc-profile <report|strict> - отчеты о выделениях памяти по кадрам (см. AllocationProfiler.h);
+    // -event-log <файл> - записывать игровые события в двоичный журнал (см. GameEventLog.h);
+    // -self-test <versus|package|lines> - выполнить проверку и выйти с кодом ошибки, если она не прошла.
+    void ParseGameArguments()
+    {
+        const Vector<String>& arguments = GetArguments();
+
+        for (unsigned i = 0; i + 1 < arguments.Size(); i++)
+        {
+            String argument = arguments[i].ToLower();
+            const String& value = arguments[i + 1];
+
+            if (argument == "-script")
+                scriptFileName_ = value;
+            else if (argument == "-record")
+                recordFileName_ = value;
+            else if (argument == "-seed")
+                seed_ = ToUInt(value);
+            else if (argument == "-timestep")
+                fixedTimeStep_ = ToFloat(value);
+            else if (argument == "-benchmark")
+                benchmarkCorpus_ = value;
+            else if (argument == "-baseline")
+                benchmarkBaseline_ = value;
+            else if (argument == "-benchmark-out")
+                benchmarkResultFile_ = value;
+            else if (argument == "-build-difficulty")
+                difficultyFileName_ = value;
+            else if (argument == "-build-textures")
+                textureManifest_ = value;
+            else if (argument == "-build-ui")
+                compiledUIFileName_ = value;
+            else if (argument == "-wall")
+                wallSize_ = ToUInt(value);
+            else if (argument == "-wall-driver")
+                wallDrivers_ = value;
+            else if (argument == "-wall-replay")
+                wallReplay_ = value;
+            else if (argument == "-versus")
+                versusOpponent_ = value;
+            else if (argument == "-latency")
+                versusLatency_ = ToUInt(value);
+            else if (argument == "-packet-loss")
+                versusLossRate_ = ToFloat(value) / 100.0f;
+            else if (argument == "-dump-shaders")
+                shaderDumpFileName_ = value;
+            else if (argument == "-build-package")
+                packageFileName_ = value;
+            else if (argument == "-alloc-profile")
+                allocationProfile_ = value.ToLower();
+            else if (argument == "-event-log")
+                eventLogFileName_ = value;
+            else if (argument == "-self-test")
+                selfTest_ = value.ToLower();
+            else
+                continue;
+
+            i++;
+        }
     }
 
     void Start()
     {
+        PRELOADER->MarkStage("Engine initialized");
+
+        // Измененные файлы в папке GameData подменяют упакованные.
+        if (usePackage_)
+        {
+            CACHE->SetSearchPackagesFirst(false);
+            RESOURCE_PACKAGE->Prefetch(FILE_SYSTEM->GetProgramDir() + RESOURCE_PACKAGE_NAME);
+        }
+
+        if (!selfTest_.Empty())
+        {
+            if (!RunSelfTest())
+                exitCode_ = EXIT_FAILURE;
+            ENGINE->Exit();
+            return;
+        }
+
+        // Расчет таблицы сложности не требует ни ресурсов, ни сцены.
+        if (!difficultyFileName_.Empty())
+        {
+            if (!DifficultyTable::Build(context_, difficultyFileName_))
+                exitCode_ = EXIT_FAILURE;
+            ENGINE->Exit();
+            return;
+        }
+
+        // Текстуры сжимаются из исходных PNG, поэтому роутер еще не зарегистрирован.
+        if (!textureManifest_.Empty())
+        {
+            if (!TextureBuilder::Build(context_, textureManifest_))
+                exitCode_ = EXIT_FAILURE;
+            ENGINE->Exit();
+            return;
+        }
+
+        // Строки нужны автоматически переводимым надписям.
+        if (!compiledUIFileName_.Empty())
+        {
+            LOCALIZATION->LoadJSONFile("Strings.json");
+            if (!UIManager::BuildCompiledUI(context_, compiledUIFileName_))
+                exitCode_ = EXIT_FAILURE;
+            ENGINE->Exit();
+            return;
+        }
+
         // Каждая игра будет уникальной.
         SetRandomSeed(Time::GetSystemTime());
         // Блокируем Alt+Enter.
         INPUT->SetToggleFullscreen(false);
         // Ограничиваем ФПС, чтобы снизить нагрузку на систему.
-        ENGINE->SetMaxFps(60);
+        // Без графики игра работает с максимальной скоростью.
+        ENGINE->SetMaxFps(ENGINE->IsHeadless() ? 0 : 60);
+
+        if (!shaderDumpFileName_.Empty() && GRAPHICS)
+            GRAPHICS->BeginDumpShaders(shaderDumpFileName_);
+
+        // Длительность анимаций в кадрах не должна зависеть от скорости машины,
+        // иначе замеры на разных машинах нельзя сравнивать.
+        // Кадр длиной в шаг логики выполняет ровно один шаг.
+        if (!benchmarkCorpus_.Empty() && fixedTimeStep_ <= 0.0f)
+            fixedTimeStep_ = GAME_STEP;
+
+        if (fixedTimeStep_ > 0.0f)
+            SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(Game, HandleEndFrame));
 
         context_->RegisterSubsystem(new Config(context_));
         CONFIG->Load();
 
+        // Подсистема Global нужна обработчику ApplyGameState уже в первом кадре.
+        context_->RegisterSubsystem(new Global(context_));
+        // Часы подписываются на E_UPDATE раньше игровой логики.
+        context_->RegisterSubsystem(new GameClock(context_));
+
+        // Журнал должен записать и создание первого поля.
+        if (eventLogFileName_.Empty() && CONFIG->GetInt("EventLog", 0) != 0)
+            eventLogFileName_ = FILE_SYSTEM->GetAppPreferencesDir("1vanK", "Soulmates") + "Events.bin";
+        if (!eventLogFileName_.Empty())
+        {
+            context_->RegisterSubsystem(new GameEventLog(context_));
+            GAME_EVENT_LOG->Start(eventLogFileName_);
+        }
+        PRELOADER->MarkStage("Config loaded");
+
+        // Все остальные ресурсы загружаются в фоне, а игра тем временем
+        // показывает пустые кадры. Когда загрузка завершится,
+        // будет вызвана функция FinishStart.
+        TextureBuilder::RegisterRouter(context_, "Textures/Compressed.xml");
+        PRELOADER->Load("Preload.xml");
+        SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(Game, HandlePreloadUpdate));
+        SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(Game, HandleEndRendering));
+    }
+
+    bool RunSelfTest()
+    {
+        // Протокол игры на двоих: пакет без ходов подтверждает прием (см. VersusSession.h).
+        if (selfTest_ == "versus")
+            return VersusSession::SelfTest();
+
+        // Запуск с пакетом: файлы, которые читаются мимо кэша, тоже упакованы (см. ResourcePackage.h).
+        if (selfTest_ == "package")
+            return RESOURCE_PACKAGE->SelfTest();
+
+        // Поиск линий по полосам совпадает с поиском в одном потоке (см. LineKernels.h).
+        if (selfTest_ == "lines")
+            return CheckLineBands(WORK_QUEUE);
+
+        URHO3D_LOGERROR("Unknown self-test " + selfTest_);
+        return false;
+    }
+
+    void HandlePreloadUpdate(StringHash eventType, VariantMap& eventData)
+    {
+        if (!PRELOADER->IsFinished())
+            return;
+
+        UnsubscribeFromEvent(E_UPDATE);
+        FinishStart();
+    }
+
+    // Шаг времени следующего кадра не зависит от реально прошедшего времени.
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData)
+    {
+        ENGINE->SetNextTimeStep(fixedTimeStep_);
+    }
+
+    // Отмечает в хронологии самый первый кадр, а также первый кадр с игровой сценой.
+    void HandleEndRendering(StringHash eventType, VariantMap& eventData)
+    {
+        if (!firstFrameRendered_)
+        {
+            firstFrameRendered_ = true;
+            PRELOADER->MarkStage("First frame rendered");
+        }
+        else if (GLOBAL->boardNode_)
+        {
+            UnsubscribeFromEvent(E_ENDRENDERING);
+            PRELOADER->MarkStage("First scene frame rendered");
+            PRELOADER->LogTimeline();
+        }
+    }
+
+    // Вторая половина инициализации, которая выполняется после фоновой загрузки ресурсов.
+    void FinishStart()
+    {
         LOCALIZATION->LoadJSONFile("Strings.json");
         LOCALIZATION->SetLanguage(CONFIG->GetInt("Language", 0));
 
         // Создаем собственные подсистемы после инициализации встроенных,
         // так как они могут обращаться к встроенным в своих конструкторах.
-        context_->RegisterSubsystem(new Global(context_));
         context_->RegisterSubsystem(new UIManager(context_));
+        PRELOADER->MarkStage("UI created");
 
         // Получаем громкость музыки и звуков из конфига.
         GLOBAL->musicVolume_ = CONFIG->GetInt("MusicVolume", DEFAULT_VOLUME, 0, MAX_VOLUME);
@@ -72,9 +326,77 @@ public:
 
         // Запускаем зацикленное проигрывание фоновой музыки.
         GLOBAL->PlayMusic("Music/Music.ogg");
+        PRELOADER->MarkStage("Audio started");
 
         CreateScene();
         SetupViewport();
+        PRELOADER->MarkStage("Scene created");
+
+        // Шейдеры компилируются до первого кадра со сценой, а не при первом использовании.
+        if (!ENGINE->IsHeadless())
+        {
+            PRELOADER->WarmUpShaders("Shaders/Precache.xml");
+            unsigned numPrograms = QUALITY_GOVERNOR->WarmUpShaders();
+            PRELOADER->MarkStage("Shaders warmed up (" + String(numPrograms) + " post-process programs)");
+
+            // Обращается к игровому полю, поэтому создается после сцены.
+            context_->RegisterSubsystem(new PerfHud(context_));
+        }
+
+        // Обращается к игровому полю. Должен быть создан раньше подсказок
+        // и InputScript, чтобы сверять поле до того, как они прочитают снимок.
+        context_->RegisterSubsystem(new LogicThread(context_));
+
+        // Без графики подсказки показывать некому.
+        context_->RegisterSubsystem(new HintEngine(context_));
+        HINT_ENGINE->SetEnabled(!ENGINE->IsHeadless() && CONFIG->GetInt("Hints", 0) != 0);
+
+        if (wallSize_)
+        {
+            context_->RegisterSubsystem(new BoardWall(context_));
+            if (!BOARD_WALL->Create(wallSize_, wallDrivers_, wallReplay_))
+            {
+                exitCode_ = EXIT_FAILURE;
+                ENGINE->Exit();
+            }
+        }
+
+        // Должен быть создан раньше InputScript (см. VersusMode.h).
+        if (!versusOpponent_.Empty())
+        {
+            context_->RegisterSubsystem(new VersusMode(context_));
+            if (!VERSUS->Start(versusOpponent_, versusLatency_, versusLossRate_))
+            {
+                exitCode_ = EXIT_FAILURE;
+                ENGINE->Exit();
+            }
+        }
+
+        context_->RegisterSubsystem(new InputScript(context_));
+        if (!recordFileName_.Empty())
+            INPUT_SCRIPT->StartRecording(recordFileName_);
+        if (!scriptFileName_.Empty())
+            INPUT_SCRIPT->Play(scriptFileName_);
+
+        if (!benchmarkCorpus_.Empty())
+        {
+            context_->RegisterSubsystem(new FrameBenchmark(context_));
+            if (!FRAME_BENCHMARK->Start(benchmarkCorpus_, benchmarkBaseline_, benchmarkResultFile_))
+            {
+                exitCode_ = EXIT_FAILURE;
+                ENGINE->Exit();
+            }
+        }
+
+        if (!allocationProfile_.Empty())
+        {
+            context_->RegisterSubsystem(new AllocationProfiler(context_));
+            if (!ALLOCATION_PROFILER->Start(allocationProfile_ == "strict"))
+            {
+                exitCode_ = EXIT_FAILURE;
+                ENGINE->Exit();
+            }
+        }
     }
 
     void ApplyGameState(StringHash eventType, VariantMap& eventData)
@@ -87,6 +409,13 @@ public:
 
         GLOBAL->gameState_ = GLOBAL->neededGameState_;
         UI_MANAGER->UpdateUIVisibility();
+
+        if (gameEventLog)
+        {
+            GameEventRecord event(GEV_STATE);
+            event.value_ = GLOBAL->gameState_;
+            gameEventLog->Write(event);
+        }
     }
 
     // В сцене нет источника света, зона тоже не нужна.
@@ -100,8 +429,8 @@ public:
         cameraNode->CreateComponent<Camera>();
         cameraNode->CreateComponent<CameraLogic>();
 
-        // Фоновую плоскость прикрепляем к камере.
-        Node* skyNode = cameraNode->CreateChild();
+        // Фоновую плоскость прикрепляем к камере. CameraLogic отодвигает ее вслед за камерой.
+        Node* skyNode = cameraNode->CreateChild("Sky");
         skyNode->SetPosition(Vector3(0.0f, 0.0f, 20.0f));
         skyNode->SetScale(Vector3(40.0f, 0.0f, 30.0f));
         skyNode->SetRotation(Quaternion(-90.0f, 0.0f, 0.0f));
@@ -109,8 +438,8 @@ public:
         skyObject->SetModel(GET_MODEL("Models/Plane.mdl"));
         skyObject->SetMaterial(GET_MATERIAL("Materials/Sky.xml"));
 
-        // Генератор звездочек.
-        Node* particleNode = scene->CreateChild();
+        // Генератор звездочек. Имя нужно регулятору качества (см. QualityGovernor.h).
+        Node* particleNode = scene->CreateChild("Fireflies");
         ParticleEmitter* particleEmitter = particleNode->CreateComponent<ParticleEmitter>();
         particleEmitter->SetEffect(GET_PARTICLE_EFFECT("Particle/Fireflies.xml"));
 
@@ -126,42 +455,121 @@ public:
         boardLogic->lineLength_ = CONFIG->GetInt("LineLength", DEFAULT_LINE_LENGTH,
             MIN_LINE_LENGTH, boardLogic->GetMaxLineLength());
         boardLogic->diagonal_ = (CONFIG->GetInt("Diagonal", (int)DEFAULT_DIAGONAL) != 0);
+        // Если зерно не указано в командной строке, то каждая игра будет уникальной.
+        boardLogic->SetRandomSeed(seed_ ? seed_ : (unsigned)Rand() << 16 | (unsigned)Rand());
         boardLogic->CreateBoard();
     }
 
     // Показывает сцену на экране.
     void SetupViewport()
     {
-        RENDERER->SetDefaultRenderPath(GET_XML_FILE("RenderPaths/MyForward.xml"));
+        // Без графики показывать нечего.
+        if (ENGINE->IsHeadless())
+            return;
 
-        // Вьюпорт при создании использует дефолтный рендерпас, указанный выше.
+        // Вьюпорт создается с рендерпасом по умолчанию, а настоящий рендерпас
+        // собирает регулятор качества.
         Camera* camera = GLOBAL->scene_->GetChild("Camera")->GetComponent<Camera>();
         SharedPtr<Viewport> viewport(new Viewport(context_, GLOBAL->scene_, camera));
-
-        // Добавляем сглаживание.
-        viewport->GetRenderPath()->Append(GET_XML_FILE("PostProcess/FXAA3.xml"));
-
-        // Так как игра стартует в состоянии GS_START_MENU, то включаем размытие сразу.
-        viewport->GetRenderPath()->Append(GET_XML_FILE("PostProcess/MyBlur.xml"));
-        viewport->GetRenderPath()->SetShaderParameter("BlurSigma", MAX_BLUR_SIGMA);
-
         RENDERER->SetViewport(0, viewport);
+
+        context_->RegisterSubsystem(new QualityGovernor(context_));
+        QualityTier tier = (QualityTier)CONFIG->GetInt("QualityTier", QT_FULL, QT_FULL, QT_COUNT - 1);
+        float targetFps = (float)CONFIG->GetInt("TargetFps", 60, 10, 240);
+        // При замерах производительности качество не должно меняться.
+        bool adaptive = CONFIG->GetInt("QualityGovernor", 1) != 0 && benchmarkCorpus_.Empty();
+        QUALITY_GOVERNOR->Start(tier, targetFps, adaptive);
     }
 
     void Stop()
     {
+        // Код возврата нужен для автоматических проверок производительности.
+        if (FRAME_BENCHMARK && FRAME_BENCHMARK->IsFailed())
+            exitCode_ = EXIT_FAILURE;
+
+        if (BOARD_WALL)
+            BOARD_WALL->LogResults();
+
+        if (!packageFileName_.Empty() && !RESOURCE_PACKAGE->Save(packageFileName_))
+            exitCode_ = EXIT_FAILURE;
+
+        if (ALLOCATION_PROFILER)
+        {
+            ALLOCATION_PROFILER->Report();
+            if (ALLOCATION_PROFILER->GetNumViolations())
+                exitCode_ = EXIT_FAILURE;
+        }
+
+        // Список вариантов записывается в файл при завершении записи.
+        if (!shaderDumpFileName_.Empty() && GRAPHICS)
+            GRAPHICS->EndDumpShaders();
+
+        // Игра закрыта до окончания загрузки (или вообще не запускалась). Настройки не менялись.
+        if (!GLOBAL || !GLOBAL->boardNode_)
+            return;
+
         // Сохраняем настройки при выходе из игры.
         CONFIG->SetInt("Language", LOCALIZATION->GetLanguageIndex());
         CONFIG->SetInt("MusicVolume", GLOBAL->musicVolume_);
         CONFIG->SetInt("SoundVolume", GLOBAL->soundVolume_);
+        // Слабая машина сразу стартует с упрощенной графикой.
+        if (QUALITY_GOVERNOR)
+            CONFIG->SetInt("QualityTier", QUALITY_GOVERNOR->GetTier());
         CONFIG->SetInt("Width", BOARD_LOGIC->width_);
         CONFIG->SetInt("Height", BOARD_LOGIC->height_);
         CONFIG->SetInt("NumColors", BOARD_LOGIC->numColors_);
         CONFIG->SetInt("Population", BOARD_LOGIC->initialPopulation_);
         CONFIG->SetInt("LineLength", BOARD_LOGIC->lineLength_);
         CONFIG->SetInt("Diagonal", (int)BOARD_LOGIC->diagonal_);
+        if (!ENGINE->IsHeadless())
+            CONFIG->SetInt("Hints", (int)HINT_ENGINE->IsEnabled());
         CONFIG->Save();
     }
+
+private:
+    bool firstFrameRendered_ = false;
+
+    String scriptFileName_;
+    String recordFileName_;
+    // 0 - зерно выбирается случайно.
+    unsigned seed_ = 0;
+    // 0 - используется реальный шаг времени.
+    float fixedTimeStep_ = 0.0f;
+
+    String benchmarkCorpus_;
+    String benchmarkBaseline_ = "Benchmarks/Baseline.xml";
+    String benchmarkResultFile_;
+
+    String difficultyFileName_;
+    String textureManifest_;
+    String compiledUIFileName_;
+
+    // 0 - обычная игра с одной доской.
+    unsigned wallSize_ = 0;
+    String wallDrivers_ = "bot";
+    String wallReplay_;
+
+    // Пустая строка - игра без соперника.
+    String versusOpponent_;
+    unsigned versusLatency_ = 0;
+    float versusLossRate_ = 0.0f;
+
+    // Пустая строка - варианты шейдеров не записываются.
+    String shaderDumpFileName_;
+
+    // Пустая строка - пакет не собирается.
+    String packageFileName_;
+    // Ресурсы берутся из пакета RESOURCE_PACKAGE_NAME.
+    bool usePackage_ = false;
+
+    // report или strict (см. AllocationProfiler.h). Пустая строка - профайлер выключен.
+    String allocationProfile_;
+
+    // Пустая строка - журнал событий включается настройкой EventLog в конфиге.
+    String eventLogFileName_;
+
+    // Пустая строка - обычный запуск.
+    String selfTest_;
 };
 
 URHO3D_DEFINE_APPLICATION_MAIN(Game)
@@ -0,0 +1,37 @@
+#include "GameClock.h"
+#include "TraceProfiler.h"
+
+GameClock::GameClock(Context* context) :
+    Object(context)
+{
+    SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(GameClock, HandleUpdate));
+}
+
+void GameClock::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+    GAME_PROFILE(GameClock);
+
+    accumulator_ += eventData[Update::P_TIMESTEP].GetFloat();
+
+    int numFrameSteps = 0;
+    while (accumulator_ >= GAME_STEP && numFrameSteps < GAME_MAX_STEPS)
+    {
+        accumulator_ -= GAME_STEP;
+        numFrameSteps++;
+        numSteps_++;
+
+        using namespace GameStep;
+        VariantMap& stepData = GetEventDataMap();
+        stepData[P_TIMESTEP] = GAME_STEP;
+        SendEvent(E_GAMESTEP, stepData);
+    }
+
+    // Отставание больше GAME_MAX_STEPS шагов не догоняется.
+    if (accumulator_ >= GAME_STEP)
+        accumulator_ = fmodf(accumulator_, GAME_STEP);
+
+    using namespace GameInterpolate;
+    VariantMap& interpolateData = GetEventDataMap();
+    interpolateData[P_ALPHA] = GetAlpha();
+    SendEvent(E_GAMEINTERPOLATE, interpolateData);
+}
@@ -0,0 +1,57 @@
+/*
+Фиксированный шаг игровой логики.
+
+Игровая логика и анимации продвигаются шагами постоянной длины GAME_STEP (событие
+E_GAMESTEP), а не на время кадра. В каждом кадре выполняется столько шагов, сколько
+накопилось времени, поэтому длительность анимаций и каскадов, а значит и скрипты
+ввода, не зависят от частоты кадров. Если кадр был слишком долгим, то выполняется
+не больше GAME_MAX_STEPS шагов, а остальное время отбрасывается: игра на мгновение
+замедляется, но не пытается догнать бесконечно.
+
+После шагов отправляется E_GAMEINTERPOLATE. Подписчики показывают состояние между
+предыдущим и последним шагом (с отставанием на один шаг), поэтому движение остается
+плавным при неровном времени кадров и при частоте кадров выше частоты шагов.
+*/
+
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+#define GAME_CLOCK GetSubsystem<GameClock>()
+
+// Длина шага логики (с).
+#define GAME_STEP (1.0f / 60.0f)
+
+// Максимальное количество шагов за кадр.
+#define GAME_MAX_STEPS 5
+
+// Шаг игровой логики.
+URHO3D_EVENT(E_GAMESTEP, GameStep)
+{
+    URHO3D_PARAM(P_TIMESTEP, TimeStep); // float
+}
+
+// Все шаги кадра выполнены, нужно обновить отображаемое состояние.
+URHO3D_EVENT(E_GAMEINTERPOLATE, GameInterpolate)
+{
+    // Доля шага, прошедшая после последнего шага (0 - показывать предыдущий шаг, 1 - последний).
+    URHO3D_PARAM(P_ALPHA, Alpha); // float
+}
+
+class GameClock : public Object
+{
+    URHO3D_OBJECT(GameClock, Object);
+
+public:
+    GameClock(Context* context);
+
+    // Количество шагов с момента запуска.
+    unsigned GetNumSteps() const { return numSteps_; }
+    float GetAlpha() const { return accumulator_ / GAME_STEP; }
+
+private:
+    // Время, которое еще не истрачено на шаги.
+    float accumulator_ = 0.0f;
+    unsigned numSteps_ = 0;
+
+    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+};
@@ -0,0 +1,186 @@
+#include "GameEventLog.h"
+#include "GameClock.h"
+#include "Urho3DAliases.h"
+
+GameEventLog* gameEventLog = nullptr;
+
+GameEventLog::GameEventLog(Context* context) :
+    Object(context),
+    fileSystem_(FILE_SYSTEM),
+    queue_(new GameEventRecord[GAME_EVENT_QUEUE_SIZE]),
+    head_(0),
+    tail_(0)
+{
+    SubscribeToEvent(E_GAMESTEP, URHO3D_HANDLER(GameEventLog, HandleGameStep));
+}
+
+GameEventLog::~GameEventLog()
+{
+    // Новые записи больше не поступают. Поток дописывает остаток очереди.
+    if (gameEventLog == this)
+        gameEventLog = nullptr;
+
+    Stop();
+
+    // Записи, отброшенные после последней записи в очереди. Поток уже остановлен.
+    if (numDropped_)
+    {
+        GameEventRecord record(GEV_DROPPED);
+        record.step_ = step_;
+        record.value_ = (int)numDropped_;
+        WriteRecords(&record, 1);
+    }
+
+    if (file_)
+        file_->Close();
+
+    delete[] queue_;
+}
+
+bool GameEventLog::Start(const String& fileName)
+{
+    fileName_ = fileName;
+    startTime_ = Time::GetTimeSinceEpoch();
+
+    // Поток еще не запущен, поэтому файлы можно переименовать здесь.
+    if (fileSystem_->FileExists(fileName_))
+        ShiftFiles();
+
+    if (!Run())
+    {
+        URHO3D_LOGERROR("Failed to start event log thread");
+        return false;
+    }
+
+    gameEventLog = this;
+    URHO3D_LOGINFO("Event log: " + fileName_);
+    return true;
+}
+
+// Журнал создается раньше сцены и подписан на E_GAMESTEP раньше доски,
+// поэтому номер шага увеличивается до того, как доска запишет события этого шага.
+void GameEventLog::HandleGameStep(StringHash eventType, VariantMap& eventData)
+{
+    step_++;
+}
+
+void GameEventLog::ThreadFunction()
+{
+    while (shouldRun_)
+    {
+        Flush();
+        Time::Sleep(GAME_EVENT_FLUSH_INTERVAL);
+    }
+
+    // Файл закрывается в деструкторе после последней записи GEV_DROPPED.
+    Flush();
+}
+
+void GameEventLog::Flush()
+{
+    unsigned tail = tail_.load(std::memory_order_relaxed);
+    unsigned head = head_.load(std::memory_order_acquire);
+
+    // Записи до конца буфера и с его начала пишутся двумя частями.
+    while (tail != head)
+    {
+        unsigned begin = tail & (GAME_EVENT_QUEUE_SIZE - 1);
+        unsigned count = Min(head - tail, GAME_EVENT_QUEUE_SIZE - begin);
+        WriteRecords(&queue_[begin], count);
+
+        tail += count;
+        tail_.store(tail, std::memory_order_release);
+    }
+}
+
+void GameEventLog::WriteRecords(const GameEventRecord* records, unsigned count)
+{
+    // Новый файл начинается с предыдущего поля, поэтому файл открывается до того, как запомнено следующее.
+    if (!failed_ && !file_)
+        OpenFile();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        const GameEventRecord& record = records[i];
+        if (record.type_ == GEV_BOARD)
+        {
+            lastBoard_ = record;
+            hasBoard_ = true;
+            lastScore_ = 0;
+        }
+        else if (record.type_ == GEV_SCORE || record.type_ == GEV_REMOVE || record.type_ == GEV_GAME_OVER)
+        {
+            lastScore_ = record.value_;
+        }
+    }
+
+    if (!file_)
+        return;
+
+    file_->Write(records, count * sizeof(GameEventRecord));
+
+    // Размер файла может превысить предел не больше чем на одну пачку записей.
+    if (file_->GetSize() >= GAME_EVENT_FILE_SIZE)
+        RotateFiles();
+}
+
+bool GameEventLog::OpenFile()
+{
+    file_ = new File(context_);
+    if (!file_->Open(fileName_, FILE_WRITE))
+    {
+        // Лог движка сам передает сообщения из других потоков в главный.
+        URHO3D_LOGERROR("Can't create event log " + fileName_ + ", events are discarded");
+        file_.Reset();
+        failed_ = true;
+        return false;
+    }
+
+    file_->WriteFileID("SMEV");
+    file_->WriteUInt(GAME_EVENT_LOG_VERSION);
+    file_->WriteUInt(sizeof(GameEventRecord));
+    file_->WriteUInt(startTime_);
+
+    // Без режима поля и счета события нового файла нельзя разобрать.
+    if (hasBoard_)
+    {
+        GameEventRecord score(GEV_SCORE);
+        score.step_ = lastBoard_.step_;
+        score.value_ = lastScore_;
+        file_->Write(&lastBoard_, sizeof(GameEventRecord));
+        file_->Write(&score, sizeof(GameEventRecord));
+    }
+
+    return true;
+}
+
+void GameEventLog::RotateFiles()
+{
+    file_->Close();
+    file_.Reset();
+    ShiftFiles();
+
+    // Новый файл создается при следующей записи.
+}
+
+void GameEventLog::ShiftFiles()
+{
+    String oldest = GetRotatedFileName(GAME_EVENT_NUM_FILES - 1);
+    if (fileSystem_->FileExists(oldest))
+        fileSystem_->Delete(oldest);
+
+    for (unsigned i = GAME_EVENT_NUM_FILES - 2; i > 0; i--)
+    {
+        String name = GetRotatedFileName(i);
+        if (fileSystem_->FileExists(name))
+            fileSystem_->Rename(name, GetRotatedFileName(i + 1));
+    }
+
+    fileSystem_->Rename(fileName_, GetRotatedFileName(1));
+}
+
+// Events.bin -> Events.1.bin.
+String GameEventLog::GetRotatedFileName(unsigned index) const
+{
+    return GetPath(fileName_) + GetFileName(fileName_) + "." + String(index) + GetExtension(fileName_, false);
+}
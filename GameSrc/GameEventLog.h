@@ -0,0 +1,191 @@
+/*
+Двоичный журнал игровых событий основной доски для анализа баланса.
+
+Запуск:
+    Soulmates -event-log Events.bin
+или в конфиге EventLog="1" (журнал пишется в папку с настройками игры).
+
+Каждое событие (толчок, движение юнита, появление юнита, удаление юнита,
+конец игры, смена игрового состояния, новое поле) - запись фиксированного
+размера GameEventRecord. Главный поток только копирует запись в кольцевую
+очередь без блокировок, а фоновый поток раз в GAME_EVENT_FLUSH_INTERVAL мс
+дописывает накопившиеся записи в файл. Если очередь переполнена, то записи
+отбрасываются, а первая запись, которая снова поместилась в очередь, предваряется
+записью GEV_DROPPED с их количеством. Поэтому GEV_DROPPED стоит в журнале
+ровно на месте пропуска.
+
+Файл начинается с заголовка: идентификатор SMEV, версия формата, размер записи
+и время начала сессии (секунды с 1970 года). Когда файл превышает
+GAME_EVENT_FILE_SIZE байт, он переименовывается в Events.1.bin (старые файлы
+сдвигаются до Events.<GAME_EVENT_NUM_FILES - 1>.bin, самый старый удаляется),
+и запись продолжается в новый файл. Новый файл начинается с последней записи
+GEV_BOARD и записи GEV_SCORE с текущим счетом, чтобы его можно было разбирать
+отдельно. Файл предыдущей сессии так же сдвигается при запуске журнала,
+поэтому новая сессия его не затирает.
+
+Порядок байтов - как у процессора (little-endian на всех целевых платформах).
+*/
+
+#pragma once
+#include "Global.h"
+#include <atomic>
+
+#define GAME_EVENT_LOG GetSubsystem<GameEventLog>()
+
+// Версия формата файла. Увеличивается при изменении GameEventRecord.
+#define GAME_EVENT_LOG_VERSION 2
+
+// Размер очереди в записях (степень двойки).
+#define GAME_EVENT_QUEUE_SIZE 16384
+
+// Интервал между записями в файл (мс).
+#define GAME_EVENT_FLUSH_INTERVAL 100
+
+// Максимальный размер файла (байт) и количество файлов вместе с текущим.
+#define GAME_EVENT_FILE_SIZE (16 * 1024 * 1024)
+#define GAME_EVENT_NUM_FILES 4
+
+// Значение координаты, если у события нет клетки.
+#define GAME_EVENT_NO_CELL 255
+
+enum GameEventType
+{
+    // Поле создано заново. value_ - режим (BoardMode::Pack).
+    GEV_BOARD,
+    // Игрок толкнул юнит из клетки (x_, y_) в клетку (toX_, toY_).
+    GEV_PUSH,
+    // Юнит переместился из клетки (x_, y_) в клетку (toX_, toY_) (после толчка или по периметру).
+    GEV_MOVE,
+    // В клетке (x_, y_) появился юнит цвета color_.
+    GEV_SPAWN,
+    // Юнит цвета color_ в клетке (x_, y_) удален на шаге каскада depth_ (1 - сразу после хода).
+    // value_ - счет после удаления.
+    GEV_REMOVE,
+    // Ходов больше нет. value_ - итоговый счет.
+    GEV_GAME_OVER,
+    // Игровое состояние изменилось. value_ - новое состояние (GameState).
+    GEV_STATE,
+    // Очередь была переполнена. value_ - количество потерянных записей.
+    GEV_DROPPED,
+    // Счет в начале поля (идет сразу после GEV_BOARD, восстановленное поле начинается
+    // с сохраненного счета). value_ - счет.
+    GEV_SCORE
+};
+
+struct GameEventRecord
+{
+    // Номер шага логики (см. GameClock.h).
+    unsigned step_ = 0;
+    unsigned char type_;
+    unsigned char x_ = GAME_EVENT_NO_CELL;
+    unsigned char y_ = GAME_EVENT_NO_CELL;
+    unsigned char toX_ = GAME_EVENT_NO_CELL;
+    unsigned char toY_ = GAME_EVENT_NO_CELL;
+    unsigned char color_ = 0;
+    unsigned char depth_ = 0;
+    unsigned char reserved_ = 0;
+    int value_ = 0;
+
+    GameEventRecord() :
+        type_(0)
+    {
+    }
+
+    GameEventRecord(GameEventType type, int x = GAME_EVENT_NO_CELL, int y = GAME_EVENT_NO_CELL) :
+        type_((unsigned char)type),
+        x_((unsigned char)x),
+        y_((unsigned char)y)
+    {
+    }
+};
+
+static_assert(sizeof(GameEventRecord) == 16, "GameEventRecord must stay 16 bytes");
+
+class GameEventLog;
+
+// Журнал, если он включен. Проверяется перед каждой записью, чтобы
+// выключенный журнал не стоил ничего, кроме сравнения указателя.
+extern GameEventLog* gameEventLog;
+
+class GameEventLog : public Object, public Thread
+{
+    URHO3D_OBJECT(GameEventLog, Object);
+
+public:
+    GameEventLog(Context* context);
+    ~GameEventLog();
+
+    // Запускает фоновый поток. Файл создается при первой записи.
+    bool Start(const String& fileName);
+
+    // Вызывается только из главного потока.
+    void Write(const GameEventRecord& event)
+    {
+        unsigned head = head_.load(std::memory_order_relaxed);
+        // После пропуска перед записью нужно место еще и для GEV_DROPPED.
+        unsigned needed = numDropped_ ? 2 : 1;
+
+        // Хвост читается заново, только когда очередь кажется заполненной.
+        if (head - cachedTail_ + needed > GAME_EVENT_QUEUE_SIZE)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head - cachedTail_ + needed > GAME_EVENT_QUEUE_SIZE)
+            {
+                numDropped_++;
+                return;
+            }
+        }
+
+        if (numDropped_)
+        {
+            GameEventRecord& dropped = queue_[head & (GAME_EVENT_QUEUE_SIZE - 1)];
+            dropped = GameEventRecord(GEV_DROPPED);
+            dropped.step_ = step_;
+            dropped.value_ = (int)numDropped_;
+            numDropped_ = 0;
+            head++;
+        }
+
+        GameEventRecord& record = queue_[head & (GAME_EVENT_QUEUE_SIZE - 1)];
+        record = event;
+        record.step_ = step_;
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    virtual void ThreadFunction();
+
+private:
+    // Данные главного потока.
+    unsigned step_ = 0;
+    unsigned cachedTail_ = 0;
+    // Сколько записей отброшено с момента последней записи, которая поместилась в очередь.
+    unsigned numDropped_ = 0;
+
+    // Данные фонового потока.
+    String fileName_;
+    FileSystem* fileSystem_;
+    SharedPtr<File> file_;
+    // Не удалось создать файл, записи отбрасываются.
+    bool failed_ = false;
+    unsigned startTime_ = 0;
+    // Последняя запись GEV_BOARD и счет после последней записи (повторяются в начале каждого файла).
+    GameEventRecord lastBoard_;
+    bool hasBoard_ = false;
+    int lastScore_ = 0;
+
+    // Общие данные.
+    GameEventRecord* queue_;
+    std::atomic<unsigned> head_;
+    std::atomic<unsigned> tail_;
+
+    void HandleGameStep(StringHash eventType, VariantMap& eventData);
+
+    // Вызываются в фоновом потоке (и в главном, когда фоновый не запущен или уже остановлен).
+    void Flush();
+    void WriteRecords(const GameEventRecord* records, unsigned count);
+    bool OpenFile();
+    void RotateFiles();
+    // Сдвигает текущий файл и старые файлы на один номер.
+    void ShiftFiles();
+    String GetRotatedFileName(unsigned index) const;
+};
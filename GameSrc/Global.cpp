@@ -1,6 +1,8 @@
 #include "Global.h"
 #include "Urho3DAliases.h"
 #include "UIManager.h"
+#include "TraceProfiler.h"
+#include "PerfHud.h"
 
 Global::Global(Context* context) :
     Object(context)
@@ -23,6 +25,8 @@ String Global::GameStateToString()
 
 void Global::PlaySound(const String& fileName)
 {
+    GAME_PROFILE(PlaySound);
+
     // Имя ноды равно имени проигрываемого звукового файла.
     Node* soundNode = soundRoot_->GetChild(fileName);
     if (!soundNode)
@@ -31,11 +35,16 @@ void Global::PlaySound(const String& fileName)
     SoundSource* soundSource = soundNode->GetOrCreateComponent<SoundSource>();
 
     if (!soundSource->IsPlaying())
+    {
         soundSource->Play(GET_SOUND(fileName));
+        perfCounters.soundTriggers_++;
+    }
 }
 
 void Global::PlaySound(const String& type, const String& fileNameBegin, int num_variations)
 {
+    GAME_PROFILE(PlaySound);
+
     Node* soundNode = soundRoot_->GetChild(type);
     if (!soundNode)
     {
@@ -49,6 +58,8 @@ void Global::PlaySound(const String& type, const String& fileNameBegin, int num_
     if (soundSource->IsPlaying())
         return;
 
+    perfCounters.soundTriggers_++;
+
     if (num_variations <= 1)
     {
         soundSource->Play(GET_SOUND(fileNameBegin + "0.wav"));
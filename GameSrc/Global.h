@@ -41,6 +41,9 @@ public:
     // следующей итерации игрового цикла.
     GameState neededGameState_ = GS_START_MENU;
 
+    // Ходы поступают из скрипта (см. InputScript), а не от мыши.
+    bool scriptedInput_ = false;
+
     Global(Context* context);
 
     // Одинаковые звуки не будут воспроизводиться одновременно.
@@ -0,0 +1,245 @@
+#include "HintEngine.h"
+#include "BoardLogic.h"
+#include "Urho3DAliases.h"
+#include "TraceProfiler.h"
+#include "LogicThread.h"
+#include <atomic>
+
+// Во сколько удаленных юнитов оценивается риск закончить игру.
+static const float HINT_RISK_PENALTY = 10.0f;
+
+struct HintJob : public RefCounted
+{
+    // Копия доски. Рабочие потоки только читают ее.
+    BoardState state_;
+    unsigned boardVersion_ = 0;
+    // Каждая задача пишет только в свой элемент.
+    PODVector<PushHint> hints_;
+    // Изменяется только в главном потоке.
+    unsigned numPendingItems_ = 0;
+    // Лучший ход уже подсвечен.
+    bool published_ = false;
+    std::atomic<bool> cancelled_;
+
+    HintJob() : cancelled_(false) {}
+};
+
+static float GetHintValue(const PushHint& hint)
+{
+    return hint.expectedRemoved_ - hint.gameOverRisk_ * HINT_RISK_PENALTY;
+}
+
+// Выполняется в рабочем потоке. Оценивает один толчок.
+static void EvaluatePushWork(const WorkItem* item, unsigned threadIndex)
+{
+    GAME_PROFILE(EvaluatePush);
+
+    HintJob* job = static_cast<HintJob*>(item->start_);
+    PushHint& hint = job->hints_[(unsigned)(size_t)item->aux_];
+
+    int numRemoved = 0;
+    int numGameOvers = 0;
+
+    for (unsigned sample = 0; sample < HINT_NUM_SAMPLES; sample++)
+    {
+        // Игрок уже походил, результат никому не нужен.
+        if (job->cancelled_.load(std::memory_order_relaxed))
+            return;
+
+        // Настоящее зерно не используется, иначе подсказка знала бы будущие цвета.
+        BoardState state = job->state_;
+        state.SetRandomSeed(job->state_.GetRandomSeed() ^ (sample + 1) * 2654435761u);
+        state.Push(hint.cell_.x_, hint.cell_.y_);
+        numRemoved += state.Settle();
+
+        if (state.IsGameOver())
+            numGameOvers++;
+    }
+
+    hint.expectedRemoved_ = (float)numRemoved / HINT_NUM_SAMPLES;
+    hint.gameOverRisk_ = (float)numGameOvers / HINT_NUM_SAMPLES;
+}
+
+HintEngine::HintEngine(Context* context) :
+    Object(context)
+{
+    SubscribeToEvent(E_BOARDREADY, URHO3D_HANDLER(HintEngine, HandleBoardReady));
+    SubscribeToEvent(E_UNITPUSHED, URHO3D_HANDLER(HintEngine, HandleUnitPushed));
+    SubscribeToEvent(E_LOGICUPDATED, URHO3D_HANDLER(HintEngine, HandleLogicUpdated));
+    SubscribeToEvent(E_WORKITEMCOMPLETED, URHO3D_HANDLER(HintEngine, HandleWorkItemCompleted));
+}
+
+HintEngine::~HintEngine()
+{
+    // Задачи ссылаются на оценки, поэтому дожидаемся их завершения.
+    // Отмененные задачи завершаются сразу.
+    UnsubscribeFromAllEvents();
+
+    foreach(SharedPtr<HintJob>& job, jobs_)
+        job->cancelled_ = true;
+
+    WorkQueue* workQueue = WORK_QUEUE;
+    if (workQueue && !jobs_.Empty())
+        workQueue->Complete(0);
+}
+
+void HintEngine::SetEnabled(bool enable)
+{
+    if (enable == enabled_)
+        return;
+
+    enabled_ = enable;
+
+    if (!enabled_)
+    {
+        CancelJob();
+        hints_.Clear();
+        BOARD_LOGIC->SetHintedCell(-1, -1);
+    }
+}
+
+bool HintEngine::GetBestHint(PushHint& result) const
+{
+    if (hints_.Empty())
+        return false;
+
+    result = hints_[0];
+    for (unsigned i = 1; i < hints_.Size(); i++)
+    {
+        if (GetHintValue(hints_[i]) > GetHintValue(result))
+            result = hints_[i];
+    }
+
+    return true;
+}
+
+// Событие отправляется на каждом шаге, пока поле ждет хода, но оценка
+// запускается только один раз для каждого положения на доске.
+void HintEngine::HandleBoardReady(StringHash eventType, VariantMap& eventData)
+{
+    if (!enabled_)
+        return;
+
+    BoardLogic* boardLogic = BOARD_LOGIC;
+    readyVersion_ = boardLogic->GetVersion();
+
+    // Обычно оценка уже запущена по снимку потока логики.
+    if (!job_ || job_->boardVersion_ != readyVersion_)
+    {
+        BoardState state;
+        boardLogic->GetState(state);
+        StartJob(state, readyVersion_);
+    }
+    else if (!job_->numPendingItems_ && !job_->published_ && !job_->cancelled_)
+    {
+        PublishHints();
+    }
+}
+
+void HintEngine::HandleUnitPushed(StringHash eventType, VariantMap& eventData)
+{
+    // Подсветку BoardLogic снимает сам.
+    CancelJob();
+    hints_.Clear();
+    readyVersion_ = 0;
+}
+
+void HintEngine::HandleLogicUpdated(StringHash eventType, VariantMap& eventData)
+{
+    if (!enabled_)
+        return;
+
+    const LogicSnapshot* snapshot = LOGIC_THREAD->GetCurrentSnapshot();
+    if (!snapshot)
+        return;
+
+    // Снимок может быть заменен копией настоящего поля с той же версией (см. LogicThread.h).
+    if (job_ && job_->boardVersion_ == snapshot->boardVersion_ &&
+        job_->state_.GetHash() == snapshot->state_.GetHash())
+    {
+        return;
+    }
+
+    StartJob(snapshot->state_, snapshot->boardVersion_);
+}
+
+void HintEngine::StartJob(const BoardState& state, unsigned boardVersion)
+{
+    GAME_PROFILE(StartHintJob);
+
+    CancelJob();
+    hints_.Clear();
+
+    job_ = new HintJob();
+    job_->boardVersion_ = boardVersion;
+    job_->state_ = state;
+
+    PODVector<IntVector2> pushes;
+    job_->state_.GetPushes(pushes);
+    if (pushes.Empty())
+        return;
+
+    job_->hints_.Resize(pushes.Size());
+    for (unsigned i = 0; i < pushes.Size(); i++)
+    {
+        job_->hints_[i].cell_ = pushes[i];
+        job_->hints_[i].expectedRemoved_ = 0.0f;
+        job_->hints_[i].gameOverRisk_ = 0.0f;
+    }
+
+    // По задаче на каждый толчок, чтобы загрузить все рабочие потоки.
+    // Низкий приоритет: рендер ждет только задачи с максимальным приоритетом.
+    WorkQueue* workQueue = WORK_QUEUE;
+    for (unsigned i = 0; i < pushes.Size(); i++)
+    {
+        SharedPtr<WorkItem> item = workQueue->GetFreeItem();
+        item->workFunction_ = EvaluatePushWork;
+        item->start_ = job_.Get();
+        item->aux_ = (void*)(size_t)i;
+        item->priority_ = 0;
+        item->sendEvent_ = true;
+        workQueue->AddWorkItem(item);
+    }
+
+    job_->numPendingItems_ = pushes.Size();
+    jobs_.Push(job_);
+}
+
+void HintEngine::CancelJob()
+{
+    if (!job_)
+        return;
+
+    job_->cancelled_ = true;
+    job_ = nullptr;
+}
+
+void HintEngine::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+{
+    using namespace WorkItemCompleted;
+
+    WorkItem* item = static_cast<WorkItem*>(eventData[P_ITEM].GetVoidPtr());
+    if (item->workFunction_ != EvaluatePushWork)
+        return;
+
+    SharedPtr<HintJob> job(static_cast<HintJob*>(item->start_));
+    if (--job->numPendingItems_ > 0)
+        return;
+
+    jobs_.Remove(job);
+
+    if (job == job_ && !job->cancelled_ && job->boardVersion_ == readyVersion_)
+        PublishHints();
+}
+
+void HintEngine::PublishHints()
+{
+    hints_ = job_->hints_;
+    job_->published_ = true;
+
+    PushHint best;
+    if (GetBestHint(best))
+        BOARD_LOGIC->SetHintedCell(best.cell_.x_, best.cell_.y_);
+
+    SendEvent(E_HINTSUPDATED);
+}
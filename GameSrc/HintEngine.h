@@ -0,0 +1,87 @@
+/*
+Подсказки для тренировки.
+
+Когда игровое поле готово к ходу, копия поля (BoardState) оценивается
+в рабочих потоках движка (WorkQueue): для каждого возможного толчка
+проигрываются сам толчок, движение очереди по периметру и все последующие
+удаления линий. Цвета новых юнитов игроку заранее неизвестны, поэтому каждый
+толчок проигрывается несколько раз с разными зернами.
+
+Оценка запускается еще во время анимации хода, как только поток логики
+(см. LogicThread.h) опубликует положение после всех каскадов.
+
+Главный поток не ждет результатов: они забираются по событию
+E_WORKITEMCOMPLETED, и когда поле готово к ходу, лучший ход подсвечивается на доске.
+Если игрок походил раньше, то оценка отменяется флагом, который рабочие
+потоки проверяют перед каждым проигрыванием.
+*/
+
+#pragma once
+#include "Global.h"
+#include "BoardState.h"
+
+#define HINT_ENGINE GetSubsystem<HintEngine>()
+
+// Сколько раз проигрывается каждый толчок.
+#define HINT_NUM_SAMPLES 16
+
+// Оценка хода завершена. Результаты доступны через HintEngine::GetHints.
+URHO3D_EVENT(E_HINTSUPDATED, HintsUpdated)
+{
+}
+
+// Оценка одного толчка.
+struct PushHint
+{
+    // Клетка, из которой толкается юнит.
+    IntVector2 cell_;
+    // Среднее количество удаленных юнитов с учетом каскадов.
+    float expectedRemoved_;
+    // Доля проигрываний, после которых игра закончилась.
+    float gameOverRisk_;
+};
+
+struct HintJob;
+
+class HintEngine : public Object
+{
+    URHO3D_OBJECT(HintEngine, Object);
+
+public:
+    HintEngine(Context* context);
+    ~HintEngine();
+
+    // По умолчанию подсказки выключены.
+    void SetEnabled(bool enable);
+    bool IsEnabled() const { return enabled_; }
+
+    // Оценки всех толчков для текущего положения на доске.
+    // Пусто, если оценка еще не завершена.
+    const PODVector<PushHint>& GetHints() const { return hints_; }
+    // Возвращает false, если оценок нет.
+    bool GetBestHint(PushHint& result) const;
+
+private:
+    bool enabled_ = false;
+
+    // Оценка текущего положения на доске (выполняется или уже завершена).
+    SharedPtr<HintJob> job_;
+    // Все оценки, у которых остались незавершенные задачи, включая отмененные.
+    // Задачи ссылаются на оценку, поэтому она должна жить до их завершения.
+    Vector<SharedPtr<HintJob> > jobs_;
+
+    PODVector<PushHint> hints_;
+
+    // Версия поля, которое ждет хода (0 - юниты еще двигаются).
+    // До этого момента подсветка указала бы не на те юниты.
+    unsigned readyVersion_ = 0;
+
+    void HandleBoardReady(StringHash eventType, VariantMap& eventData);
+    void HandleUnitPushed(StringHash eventType, VariantMap& eventData);
+    void HandleLogicUpdated(StringHash eventType, VariantMap& eventData);
+    void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
+
+    void StartJob(const BoardState& state, unsigned boardVersion);
+    void CancelJob();
+    void PublishHints();
+};
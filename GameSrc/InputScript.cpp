@@ -0,0 +1,351 @@
+#include "InputScript.h"
+#include "BoardLogic.h"
+#include "Urho3DAliases.h"
+#include "GameClock.h"
+#include "LogicThread.h"
+
+// Количество аргументов каждой команды.
+static int GetNumArguments(const String& commandName)
+{
+    if (commandName == "quit")
+        return 0;
+    if (commandName == "push" || commandName == "bot")
+        return 2;
+    if (commandName == "seed" || commandName == "mode" || commandName == "press" ||
+        commandName == "random" || commandName == "wait" || commandName == "state")
+    {
+        return 1;
+    }
+
+    return -1; // Неизвестная команда.
+}
+
+InputScript::InputScript(Context* context) :
+    Object(context)
+{
+    SubscribeToEvent(E_GAMESTEP, URHO3D_HANDLER(InputScript, HandleGameStep));
+    SubscribeToEvent(E_BOARDREADY, URHO3D_HANDLER(InputScript, HandleBoardReady));
+    SubscribeToEvent(E_LOGICUPDATED, URHO3D_HANDLER(InputScript, HandleLogicUpdated));
+}
+
+InputScript::~InputScript()
+{
+    delete solver_;
+}
+
+bool InputScript::Play(const String& fileName)
+{
+    File file(context_, fileName, FILE_READ);
+    if (!file.IsOpen())
+    {
+        URHO3D_LOGERROR("Can't open script " + fileName);
+        return false;
+    }
+
+    commands_.Clear();
+    current_ = 0;
+    waitSteps_ = -1;
+    randomPushes_ = -1;
+    botPushes_ = -1;
+
+    // Поиск хода для прошлого скрипта больше не нужен.
+    if (botSearching_)
+    {
+        solver_->FinishSearch();
+        botSearching_ = false;
+    }
+
+    int lineNumber = 0;
+    while (!file.IsEof())
+    {
+        String line = file.ReadLine().Trimmed();
+        lineNumber++;
+
+        if (line.Empty() || line.StartsWith("#"))
+            continue;
+
+        StringVector command = line.Split(' ');
+        if (GetNumArguments(command[0]) != (int)command.Size() - 1)
+        {
+            URHO3D_LOGWARNING(fileName + "(" + String(lineNumber) + "): invalid command \"" + line + "\"");
+            continue;
+        }
+
+        commands_.Push(command);
+    }
+
+    GLOBAL->scriptedInput_ = IsPlaying();
+    return true;
+}
+
+bool InputScript::StartRecording(const String& fileName)
+{
+    recordFile_ = new File(context_, fileName, FILE_WRITE);
+    if (!recordFile_->IsOpen())
+    {
+        URHO3D_LOGERROR("Can't open " + fileName + " for recording");
+        recordFile_.Reset();
+        return false;
+    }
+
+    SubscribeToEvent(E_PRESSED, URHO3D_HANDLER(InputScript, HandlePressed));
+    SubscribeToEvent(E_UNITPUSHED, URHO3D_HANDLER(InputScript, HandleUnitPushed));
+
+    // Запись начинается с нового поля, созданного с известным зерном.
+    unsigned seed = (unsigned)Rand() << 16 | (unsigned)Rand();
+    BOARD_LOGIC->SetRandomSeed(seed);
+    BOARD_LOGIC->CreateBoard();
+
+    recordedState_ = GLOBAL->gameState_;
+    WriteRecord("seed " + String(seed));
+    WriteRecord("mode " + BOARD_LOGIC->BoardModeToString());
+    WriteRecord("state " + GLOBAL->GameStateToString());
+
+    return true;
+}
+
+void InputScript::WriteRecord(const String& line)
+{
+    recordFile_->WriteLine(line);
+    recordFile_->Flush();
+}
+
+void InputScript::HandlePressed(StringHash eventType, VariantMap& eventData)
+{
+    UIElement* element = static_cast<UIElement*>(eventData[Pressed::P_ELEMENT].GetPtr());
+
+    // Элементы без имени нельзя найти при воспроизведении.
+    if (element && !element->GetName().Empty())
+        WriteRecord("press " + element->GetName());
+}
+
+void InputScript::HandleUnitPushed(StringHash eventType, VariantMap& eventData)
+{
+    using namespace UnitPushed;
+    WriteRecord("push " + String(eventData[P_GRIDX].GetInt()) + " " + String(eventData[P_GRIDY].GetInt()));
+}
+
+void InputScript::HandleGameStep(StringHash eventType, VariantMap& eventData)
+{
+    // Смена игрового состояния записывается, чтобы при воспроизведении
+    // следующие команды ждали этого же состояния.
+    if (recordFile_ && recordedState_ != GLOBAL->gameState_)
+    {
+        recordedState_ = GLOBAL->gameState_;
+        WriteRecord("state " + GLOBAL->GameStateToString());
+    }
+
+    while (IsPlaying() && ExecuteCommand(commands_[current_]))
+        NextCommand();
+}
+
+bool InputScript::ExecuteCommand(const StringVector& command)
+{
+    const String& name = command[0];
+
+    if (name == "seed")
+    {
+        randomSeed_ = ToUInt(command[1]);
+        BOARD_LOGIC->SetRandomSeed(randomSeed_);
+    }
+    else if (name == "mode")
+    {
+        if (BOARD_LOGIC->BoardModeFromString(command[1]))
+            BOARD_LOGIC->CreateBoard();
+        else
+            URHO3D_LOGWARNING("Invalid board mode " + command[1]);
+    }
+    else if (name == "press")
+    {
+        UIElement* element = UI_ROOT->GetChild(command[1], true);
+        if (!element)
+        {
+            URHO3D_LOGWARNING("UI element " + command[1] + " not found");
+            return true;
+        }
+
+        using namespace Pressed;
+        VariantMap& eventData = GetEventDataMap();
+        eventData[P_ELEMENT] = element;
+        element->SendEvent(E_PRESSED, eventData);
+    }
+    else if (name == "wait")
+    {
+        if (waitSteps_ < 0)
+            waitSteps_ = ToInt(command[1]);
+
+        if (waitSteps_ > 0)
+        {
+            waitSteps_--;
+            return false;
+        }
+    }
+    else if (name == "state")
+    {
+        return GLOBAL->GameStateToString() == command[1];
+    }
+    else if (name == "quit")
+    {
+        ENGINE->Exit();
+    }
+    else if (name == "push" || name == "random" || name == "bot")
+    {
+        // Ходы делаются в HandleBoardReady. Но если игра закончилась, то ждать нечего.
+        return GLOBAL->gameState_ == GS_GAME_OVER;
+    }
+
+    return true;
+}
+
+void InputScript::HandleBoardReady(StringHash eventType, VariantMap& eventData)
+{
+    if (!IsPlaying())
+        return;
+
+    const StringVector& command = commands_[current_];
+
+    if (command[0] == "push")
+    {
+        int gridX = ToInt(command[1]);
+        int gridY = ToInt(command[2]);
+        if (!BOARD_LOGIC->PushUnit(gridX, gridY))
+            URHO3D_LOGWARNING("Can't push unit " + String(gridX) + " " + String(gridY));
+
+        NextCommand();
+    }
+    else if (command[0] == "random")
+    {
+        if (randomPushes_ < 0)
+            randomPushes_ = ToInt(command[1]);
+
+        // Если ходов нет, то команда тоже завершается.
+        if (randomPushes_ == 0 || !PushRandomUnit() || --randomPushes_ == 0)
+            NextCommand();
+    }
+    else if (command[0] == "bot")
+    {
+        if (botPushes_ < 0)
+            botPushes_ = ToInt(command[1]);
+
+        // Поиск хода для этого положения еще идет в рабочих потоках.
+        if (botPushes_ > 0 && !IsBotMoveReady(ToUInt(command[2])))
+            return;
+
+        if (botPushes_ == 0 || !PushBestUnit() || --botPushes_ == 0)
+            NextCommand();
+    }
+}
+
+// Поток логики узнает положение после хода раньше, чем закончатся анимации,
+// поэтому поиск следующего хода бота запускается по его снимку.
+void InputScript::HandleLogicUpdated(StringHash eventType, VariantMap& eventData)
+{
+    if (!IsPlaying() || botSearching_ || botPushes_ <= 0)
+        return;
+
+    const StringVector& command = commands_[current_];
+    if (command[0] != "bot")
+        return;
+
+    const LogicSnapshot* snapshot = LOGIC_THREAD->GetCurrentSnapshot();
+    if (snapshot)
+        StartBotSearch(snapshot->state_, ToUInt(command[2]));
+}
+
+void InputScript::StartBotSearch(const BoardState& state, unsigned timeBudgetMs)
+{
+    if (!solver_)
+        solver_ = new BoardSolver();
+
+    // Записи прошлых ходов (и прошлых режимов) поиску не видны, очищать таблицу не нужно.
+    // Если ходов нет, то поиск не запускается и FinishSearch вернет пустой результат.
+    solver_->StartSearch(WORK_QUEUE, state, timeBudgetMs);
+    botSearching_ = true;
+    botSearchHash_ = state.GetHash();
+    botSearchSeed_ = state.GetRandomSeed();
+}
+
+bool InputScript::IsBotMoveReady(unsigned timeBudgetMs)
+{
+    BoardState state;
+    BOARD_LOGIC->GetState(state);
+
+    // Поиск по снимку потока логики запущен не для этого положения
+    // (поле пересоздано или загружено). Его результат не нужен.
+    if (botSearching_ && (botSearchHash_ != state.GetHash() || botSearchSeed_ != state.GetRandomSeed()))
+    {
+        solver_->FinishSearch();
+        botSearching_ = false;
+    }
+
+    if (!botSearching_)
+        StartBotSearch(state, timeBudgetMs);
+
+    // Без рабочих потоков поиск выполняется только внутри FinishSearch.
+    return solver_->IsSearchFinished() || !WORK_QUEUE->GetNumThreads();
+}
+
+bool InputScript::PushBestUnit()
+{
+    SolverResult result = solver_->FinishSearch();
+    botSearching_ = false;
+    if (result.depth_ == 0)
+        return false;
+
+    return BOARD_LOGIC->PushUnit(result.cell_.x_, result.cell_.y_);
+}
+
+bool InputScript::PushRandomUnit()
+{
+    BoardLogic* boardLogic = BOARD_LOGIC;
+    int width = boardLogic->width_;
+    int height = boardLogic->height_;
+
+    // Все клетки, юниты из которых можно толкнуть (см. BoardLogic::OnClickUnit).
+    PODVector<IntVector2> cells;
+    for (int gridX = 0; gridX < width - 1; gridX++)
+    {
+        cells.Push(IntVector2(gridX, 0));
+        cells.Push(IntVector2(gridX, height - 1));
+    }
+    for (int gridY = 1; gridY < height - 1; gridY++)
+        cells.Push(IntVector2(width - 1, gridY));
+
+    while (!cells.Empty())
+    {
+        // Тот же алгоритм, что и в BoardLogic::NextRandom.
+        randomSeed_ = randomSeed_ * 214013 + 2531011;
+        unsigned index = ((randomSeed_ >> 16) & 32767) * cells.Size() / 32768;
+
+        if (boardLogic->PushUnit(cells[index].x_, cells[index].y_))
+            return true;
+
+        cells.Erase(index);
+    }
+
+    return false;
+}
+
+void InputScript::NextCommand()
+{
+    current_++;
+    waitSteps_ = -1;
+    randomPushes_ = -1;
+    botPushes_ = -1;
+
+    // Команда bot могла завершиться раньше, чем поиск (например, игра закончилась).
+    if (botSearching_)
+    {
+        solver_->FinishSearch();
+        botSearching_ = false;
+    }
+
+    if (IsPlaying())
+        return;
+
+    // Скрипт завершен. Без графики больше делать нечего,
+    // а в обычном режиме управление возвращается игроку.
+    GLOBAL->scriptedInput_ = false;
+    if (exitOnFinish_ && ENGINE->IsHeadless())
+        ENGINE->Exit();
+}
@@ -0,0 +1,91 @@
+/*
+Скриптовый ввод для автоматических прогонов (в том числе без графики).
+
+Скрипт - это текстовый файл с одной командой в строке:
+    seed 12345          - зерно генератора случайных чисел игровой логики;
+    mode w6h6c6p0l3d1   - настройки игрового поля (поле пересоздается);
+    press Start         - нажатие на элемент интерфейса с указанным именем;
+    push 3 0            - толкнуть юнит в клетке (3, 0), как только поле будет готово к ходу;
+    random 100          - сделать 100 случайных ходов;
+    bot 100 30          - сделать 100 ходов, выбранных BoardSolver (не более 30 мс на ход;
+                          поиск идет в рабочих потоках и не задерживает кадры);
+    wait 60             - пропустить 60 шагов логики (1 секунда, см. GameClock.h);
+    state Gameplay      - дождаться указанного игрового состояния;
+    quit                - выйти из игры.
+Пустые строки и строки, начинающиеся с #, игнорируются.
+
+Если игра закончилась, то оставшиеся ходы команд push, random и bot пропускаются.
+
+В этом же формате записываются сессии игрока (ключ командной строки -record),
+поэтому записанную сессию можно воспроизвести как скрипт.
+*/
+
+#pragma once
+#include "Global.h"
+#include "BoardSolver.h"
+
+#define INPUT_SCRIPT GetSubsystem<InputScript>()
+
+class InputScript : public Object
+{
+    URHO3D_OBJECT(InputScript, Object);
+
+public:
+    InputScript(Context* context);
+    ~InputScript();
+
+    // Загружает скрипт и запускает его выполнение.
+    bool Play(const String& fileName);
+    bool IsPlaying() const { return current_ < commands_.Size(); }
+
+    // Завершать ли игру без графики после окончания скрипта (по умолчанию да).
+    void SetExitOnFinish(bool enable) { exitOnFinish_ = enable; }
+
+    // Начинает запись действий игрока. Игровое поле пересоздается
+    // с новым зерном, чтобы запись можно было повторить.
+    bool StartRecording(const String& fileName);
+
+private:
+    Vector<StringVector> commands_;
+    unsigned current_ = 0;
+
+    // Сколько еще шагов логики ждать для команды wait. -1 - команда еще не начата.
+    int waitSteps_ = -1;
+    // Сколько еще случайных ходов сделать для команды random. -1 - команда еще не начата.
+    int randomPushes_ = -1;
+    // Генератор для команды random не зависит от генератора игровой логики.
+    unsigned randomSeed_ = 1;
+    // Сколько еще ходов сделать для команды bot. -1 - команда еще не начата.
+    int botPushes_ = -1;
+    // Создается при первом использовании команды bot.
+    BoardSolver* solver_ = nullptr;
+    // Поиск хода бота запущен и еще не забран, и для какого положения.
+    bool botSearching_ = false;
+    unsigned long long botSearchHash_ = 0;
+    unsigned botSearchSeed_ = 0;
+    bool exitOnFinish_ = true;
+
+    SharedPtr<File> recordFile_;
+    GameState recordedState_ = GS_START_MENU;
+
+    // Выполняет команды, не зависящие от готовности игрового поля.
+    // Вызывается на каждом шаге логики, поэтому скрипт не зависит от частоты кадров.
+    void HandleGameStep(StringHash eventType, VariantMap& eventData);
+    // Выполняет команды push, random и bot.
+    void HandleBoardReady(StringHash eventType, VariantMap& eventData);
+
+    // Запускает поиск хода бота заранее, пока анимируется предыдущий ход.
+    void HandleLogicUpdated(StringHash eventType, VariantMap& eventData);
+    void HandlePressed(StringHash eventType, VariantMap& eventData);
+    void HandleUnitPushed(StringHash eventType, VariantMap& eventData);
+
+    // Возвращает false, если команда еще не завершена.
+    bool ExecuteCommand(const StringVector& command);
+    void NextCommand();
+    bool PushRandomUnit();
+    void StartBotSearch(const BoardState& state, unsigned timeBudgetMs);
+    // Запускает поиск для текущего положения, если он еще не запущен. Возвращает true, когда ход найден.
+    bool IsBotMoveReady(unsigned timeBudgetMs);
+    bool PushBestUnit();
+    void WriteRecord(const String& line);
+};
@@ -0,0 +1,237 @@
+#include "LineKernels.h"
+#include "BoardState.h"
+#include "TraceProfiler.h"
+
+// Направления поиска: вправо, вниз, вправо вниз, влево вниз.
+// Первые два используются всегда, диагональные - только в режиме с диагоналями.
+static constexpr int LINE_DIR_X[] = { 1, 0, 1, -1 };
+static constexpr int LINE_DIR_Y[] = { 0, 1, 1, 1 };
+
+// Пределы перебора выбраны так, чтобы окно не выходило за доску,
+// поэтому проверки границ во внутреннем цикле не нужны.
+template <int LineLength, int Dir>
+static void MarkLines(const signed char* cells, int width, int height,
+    int firstRow, int lastRow, bool* removed)
+{
+    const int dirX = LINE_DIR_X[Dir];
+    const int dirY = LINE_DIR_Y[Dir];
+    const int step = dirY * width + dirX;
+    const int minX = dirX < 0 ? LineLength - 1 : 0;
+    const int maxX = dirX > 0 ? width - LineLength : width - 1;
+    const int maxY = Min(dirY > 0 ? height - LineLength : height - 1, lastRow - 1);
+
+    for (int gridY = firstRow; gridY <= maxY; gridY++)
+    {
+        for (int gridX = minX; gridX <= maxX; gridX++)
+        {
+            const int start = gridY * width + gridX;
+            const int color = cells[start];
+
+            bool line = color != EMPTY_CELL;
+            for (int i = 1; i < LineLength; i++)
+                line &= cells[start + step * i] == color;
+
+            for (int i = 0; i < LineLength; i++)
+                removed[start + step * i] |= line;
+        }
+    }
+}
+
+template <bool Diagonal, int LineLength>
+static void FindLines(const signed char* cells, int width, int height,
+    int firstRow, int lastRow, bool* removed)
+{
+    MarkLines<LineLength, 0>(cells, width, height, firstRow, lastRow, removed);
+    MarkLines<LineLength, 1>(cells, width, height, firstRow, lastRow, removed);
+
+    if (Diagonal)
+    {
+        MarkLines<LineLength, 2>(cells, width, height, firstRow, lastRow, removed);
+        MarkLines<LineLength, 3>(cells, width, height, firstRow, lastRow, removed);
+    }
+}
+
+// Явный список всех функций. При изменении MIN_LINE_LENGTH или MAX_LINE_LENGTH
+// таблицу нужно поправить (проверяется static_assert'ом ниже).
+static const LineKernel lineKernels[2][MAX_LINE_LENGTH - MIN_LINE_LENGTH + 1] =
+{
+    {
+        FindLines<false, 3>, FindLines<false, 4>, FindLines<false, 5>, FindLines<false, 6>,
+        FindLines<false, 7>, FindLines<false, 8>, FindLines<false, 9>, FindLines<false, 10>
+    },
+    {
+        FindLines<true, 3>, FindLines<true, 4>, FindLines<true, 5>, FindLines<true, 6>,
+        FindLines<true, 7>, FindLines<true, 8>, FindLines<true, 9>, FindLines<true, 10>
+    }
+};
+
+static_assert(MIN_LINE_LENGTH == 3 && MAX_LINE_LENGTH == 10, "Line kernel table must cover all line lengths");
+
+LineKernel GetLineKernel(int lineLength, bool diagonal)
+{
+    lineLength = Clamp(lineLength, MIN_LINE_LENGTH, MAX_LINE_LENGTH);
+    return lineKernels[diagonal ? 1 : 0][lineLength - MIN_LINE_LENGTH];
+}
+
+// Полоса строк для одной задачи.
+struct LineBand
+{
+    LineKernel kernel_;
+    const signed char* cells_;
+    int width_;
+    int height_;
+    int firstRow_;
+    int lastRow_;
+    // Отметки полосы (массив размером во всю доску).
+    bool* marks_;
+};
+
+static void FindLinesBandWork(const WorkItem* item, unsigned threadIndex)
+{
+    GAME_PROFILE(FindLinesBand);
+
+    const LineBand* band = static_cast<const LineBand*>(item->start_);
+    band->kernel_(band->cells_, band->width_, band->height_, band->firstRow_, band->lastRow_, band->marks_);
+}
+
+void FindLinesInBands(WorkQueue* workQueue, LineKernel kernel, const signed char* cells,
+    int width, int height, bool* removed, PODVector<bool>& bandMarks)
+{
+    int numBands = 1;
+    if (workQueue && width * height >= PARALLEL_LINES_MIN_CELLS)
+    {
+        numBands = Min((int)workQueue->GetNumThreads() + 1, height / LINES_MIN_BAND_ROWS);
+        numBands = Min(numBands, LINES_MAX_BANDS);
+    }
+
+    if (numBands < 2)
+    {
+        kernel(cells, width, height, 0, height, removed);
+        return;
+    }
+
+    GAME_PROFILE(FindLinesInBands);
+
+    const int numCells = width * height;
+
+#ifdef SOULMATES_STRESS_LINE_BANDS
+    // Эталон - поиск в одном потоке по тем же исходным отметкам.
+    PODVector<bool> expected(removed, numCells);
+    kernel(cells, width, height, 0, height, &expected[0]);
+#endif
+
+    bandMarks.Resize(numCells * numBands);
+    for (unsigned i = 0; i < bandMarks.Size(); i++)
+        bandMarks[i] = false;
+
+    LineBand bands[LINES_MAX_BANDS];
+    for (int i = 0; i < numBands; i++)
+    {
+        LineBand& band = bands[i];
+        band.kernel_ = kernel;
+        band.cells_ = cells;
+        band.width_ = width;
+        band.height_ = height;
+        band.firstRow_ = height * i / numBands;
+        band.lastRow_ = height * (i + 1) / numBands;
+        band.marks_ = &bandMarks[numCells * i];
+
+        SharedPtr<WorkItem> item = workQueue->GetFreeItem();
+        item->workFunction_ = FindLinesBandWork;
+        item->start_ = &band;
+        item->priority_ = M_MAX_UNSIGNED;
+        item->sendEvent_ = false;
+        workQueue->AddWorkItem(item);
+    }
+
+    workQueue->Complete(M_MAX_UNSIGNED);
+
+    // Окна полосы заканчиваются не ниже, чем через MAX_LINE_LENGTH - 1 строк после ее конца.
+    for (int i = 0; i < numBands; i++)
+    {
+        const LineBand& band = bands[i];
+        int first = band.firstRow_ * width;
+        int last = Min(band.lastRow_ + MAX_LINE_LENGTH - 1, height) * width;
+        for (int j = first; j < last; j++)
+            removed[j] |= band.marks_[j];
+    }
+
+#ifdef SOULMATES_STRESS_LINE_BANDS
+    for (int i = 0; i < numCells; i++)
+    {
+        if (removed[i] != expected[i])
+        {
+            URHO3D_LOGERROR(ToString("Banded line search differs from the serial one at cell %d (%dx%d, %d bands)",
+                i, width, height, numBands));
+            break;
+        }
+    }
+#endif
+}
+
+bool CheckLineBands(WorkQueue* workQueue)
+{
+    if (!workQueue || workQueue->GetNumThreads() == 0)
+    {
+        URHO3D_LOGERROR("Line bands check: no worker threads, banded search is not used");
+        return false;
+    }
+
+    // Размеры подобраны так, чтобы полосы были разной высоты и граница не совпадала с длиной линии.
+    static const IntVector2 sizes[] = { IntVector2(64, 64), IntVector2(200, 48), IntVector2(37, 129) };
+
+    PODVector<signed char> cells;
+    PODVector<bool> banded;
+    PODVector<bool> serial;
+    PODVector<bool> bandMarks;
+    unsigned random = 1;
+    bool ok = true;
+
+    foreach(const IntVector2& size, sizes)
+    {
+        const int numCells = size.x_ * size.y_;
+        cells.Resize(numCells);
+        banded.Resize(numCells);
+        serial.Resize(numCells);
+
+        // Мало цветов и немного пустых клеток, чтобы линий было много и они пересекали границы полос.
+        for (int i = 0; i < numCells; i++)
+        {
+            random = random * 1103515245 + 12345;
+            int value = (random >> 16) % 4;
+            cells[i] = value == 3 ? (signed char)EMPTY_CELL : (signed char)value;
+        }
+
+        for (int diagonal = 0; diagonal < 2; diagonal++)
+        {
+            for (int lineLength = MIN_LINE_LENGTH; lineLength <= MAX_LINE_LENGTH; lineLength++)
+            {
+                LineKernel kernel = GetLineKernel(lineLength, diagonal != 0);
+
+                for (int i = 0; i < numCells; i++)
+                {
+                    banded[i] = false;
+                    serial[i] = false;
+                }
+
+                FindLinesInBands(workQueue, kernel, &cells[0], size.x_, size.y_, &banded[0], bandMarks);
+                kernel(&cells[0], size.x_, size.y_, 0, size.y_, &serial[0]);
+
+                for (int i = 0; i < numCells; i++)
+                {
+                    if (banded[i] != serial[i])
+                    {
+                        URHO3D_LOGERROR(ToString("Line bands check: %dx%d, line %d, diagonal %d differs at cell %d",
+                            size.x_, size.y_, lineLength, diagonal, i));
+                        ok = false;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (ok)
+        URHO3D_LOGINFO("Line bands check passed");
+    return ok;
+}
@@ -0,0 +1,67 @@
+/*
+Поиск линий из одноцветных юнитов (общий для BoardLogic и BoardState).
+
+Для каждого набора направлений (только прямые или еще и диагонали) и каждой длины
+линии заранее создана своя функция: длина и направления в ней - константы времени
+компиляции, поэтому внутренние циклы полностью разворачиваются и не содержат ветвлений.
+Функция выбирается по таблице один раз при смене режима (см. GetLineKernel).
+
+Функция проверяет каждое окно из lineLength клеток вдоль каждого направления
+и отмечает окно целиком, если все его клетки одного цвета. Объединение таких окон
+совпадает с объединением всех линий не короче lineLength.
+
+На очень больших досках (стресс-тесты) поиск делится на полосы строк, которые
+обрабатываются параллельно (см. FindLinesInBands). Полоса проверяет окна, которые
+начинаются в ее строках, но читает клетки и ниже своей границы, поэтому линии,
+пересекающие границу полос (в том числе диагональные), находятся без отдельной
+склейки. Каждая полоса пишет отметки в свой массив, и после завершения всех задач
+массивы объединяются, поэтому блокировки не нужны.
+
+Игровые доски меньше порога, поэтому для стресс-тестов пороги уменьшаются при сборке:
+    cmake .. -DSOULMATES_STRESS_LINE_BANDS=ON
+Тогда на полосы делится любая доска, а результат каждого поиска по полосам сверяется
+с поиском в одном потоке. Сверку на больших случайных досках в обычной сборке
+выполняет ключ -self-test lines (см. CheckLineBands).
+*/
+
+#pragma once
+#include "BoardMode.h"
+
+// Максимальная длина линии (линия не может быть длиннее стороны доски).
+#define MAX_LINE_LENGTH (MAX_BOARD_WIDTH > MAX_BOARD_HEIGHT ? MAX_BOARD_WIDTH : MAX_BOARD_HEIGHT)
+
+#ifdef SOULMATES_STRESS_LINE_BANDS
+#define PARALLEL_LINES_MIN_CELLS 0
+#define LINES_MIN_BAND_ROWS 1
+#else
+// Доски с меньшим количеством клеток обрабатываются в одном потоке:
+// запуск задач обходится дороже, чем сам поиск.
+#define PARALLEL_LINES_MIN_CELLS 4096
+
+// Минимальная высота полосы в строках.
+#define LINES_MIN_BAND_ROWS 16
+#endif
+
+// Максимальное количество полос (по одной на поток и еще одна для главного потока).
+#define LINES_MAX_BANDS 64
+
+// cells - цвета клеток построчно (EMPTY_CELL для пустых), width * height значений.
+// Проверяются окна, которые начинаются в строках firstRow - (lastRow - 1).
+// В removed отмечаются клетки, которые входят в линии (остальные значения не меняются).
+typedef void (*LineKernel)(const signed char* cells, int width, int height,
+    int firstRow, int lastRow, bool* removed);
+
+// Длина линии ограничивается пределами MIN_LINE_LENGTH - MAX_LINE_LENGTH.
+LineKernel GetLineKernel(int lineLength, bool diagonal);
+
+// Ищет линии на всей доске. Большие доски делятся на полосы, которые обрабатываются
+// рабочими потоками (главный поток ждет их завершения и тоже участвует в работе).
+// bandMarks - временный буфер для отметок полос, хранится вызывающей стороной,
+// чтобы не выделять память каждый раз. Вызывать только из главного потока.
+void FindLinesInBands(WorkQueue* workQueue, LineKernel kernel, const signed char* cells,
+    int width, int height, bool* removed, PODVector<bool>& bandMarks);
+
+// Сравнивает поиск по полосам с поиском в одном потоке на случайных досках, которые больше
+// порога, для всех длин линий и направлений. Возвращает false при расхождении или если
+// у очереди нет рабочих потоков (тогда полосы не проверяются).
+bool CheckLineBands(WorkQueue* workQueue);
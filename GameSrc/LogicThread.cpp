@@ -0,0 +1,219 @@
+#include "LogicThread.h"
+#include "BoardLogic.h"
+#include "Urho3DAliases.h"
+#include "TraceProfiler.h"
+
+// Младшие биты middleSnapshot_ - индекс буфера, этот бит - снимок еще не забран.
+static const unsigned LOGIC_SNAPSHOT_INDEX = 3;
+static const unsigned LOGIC_SNAPSHOT_NEW = 4;
+
+enum LogicCommandType
+{
+    // Заменить состояние потока копией настоящего поля.
+    LC_RESET,
+    // Толкнуть юнит и удалить все линии.
+    LC_PUSH
+};
+
+struct LogicCommand
+{
+    LogicCommandType type_ = LC_RESET;
+    unsigned serial_ = 0;
+    unsigned boardVersion_ = 0;
+    // LC_RESET.
+    BoardState state_;
+    // LC_PUSH.
+    IntVector2 cell_;
+};
+
+LogicThread::LogicThread(Context* context) :
+    Object(context),
+    commands_(new LogicCommand[LOGIC_QUEUE_SIZE]),
+    middleSnapshot_(1),
+    commandsHead_(0),
+    commandsTail_(0)
+{
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(LogicThread, HandleBeginFrame));
+    SubscribeToEvent(E_UNITPUSHED, URHO3D_HANDLER(LogicThread, HandleUnitPushed));
+    SubscribeToEvent(E_BOARDREADY, URHO3D_HANDLER(LogicThread, HandleBoardReady));
+
+    if (!Run())
+        URHO3D_LOGERROR("Failed to start logic thread");
+}
+
+LogicThread::~LogicThread()
+{
+    // Поток может спать в ожидании команд, поэтому его нужно разбудить.
+    shouldRun_ = false;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+    }
+    wakeCondition_.notify_one();
+    Stop();
+
+    delete[] commands_;
+}
+
+const LogicSnapshot* LogicThread::GetCurrentSnapshot() const
+{
+    const LogicSnapshot& snapshot = snapshots_[frontSnapshot_];
+    if (snapshot.serial_ != postedSerial_ || snapshot.boardVersion_ != BOARD_LOGIC->GetVersion())
+        return nullptr;
+
+    return &snapshot;
+}
+
+bool LogicThread::Post(LogicCommand& command)
+{
+    unsigned head = commandsHead_.load(std::memory_order_relaxed);
+    if (head - commandsTail_.load(std::memory_order_acquire) >= LOGIC_QUEUE_SIZE)
+    {
+        // Поток не успевает или не запустился. Когда поле
+        // будет готово к ходу, поток получит копию поля заново.
+        URHO3D_LOGWARNING("Logic thread queue is full");
+        postedVersion_ = 0;
+        return false;
+    }
+
+    command.serial_ = nextSerial_++;
+    commands_[head % LOGIC_QUEUE_SIZE] = command;
+    commandsHead_.store(head + 1, std::memory_order_release);
+    postedSerial_ = command.serial_;
+
+    // Поток проверяет очередь под этим же мьютексом, поэтому сигнал не потеряется.
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+    }
+    wakeCondition_.notify_one();
+
+    return true;
+}
+
+void LogicThread::PostReset()
+{
+    GAME_PROFILE(PostLogicReset);
+
+    BoardLogic* boardLogic = BOARD_LOGIC;
+
+    LogicCommand command;
+    command.type_ = LC_RESET;
+    command.boardVersion_ = boardLogic->GetVersion();
+    boardLogic->GetState(command.state_);
+
+    if (!Post(command))
+        return;
+
+    // Копия настоящего поля сверки не требует.
+    postedVersion_ = command.boardVersion_;
+    verifiedVersion_ = command.boardVersion_;
+}
+
+void LogicThread::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (!(middleSnapshot_.load(std::memory_order_relaxed) & LOGIC_SNAPSHOT_NEW))
+        return;
+
+    frontSnapshot_ = middleSnapshot_.exchange(frontSnapshot_, std::memory_order_acq_rel) & LOGIC_SNAPSHOT_INDEX;
+    SendEvent(E_LOGICUPDATED);
+}
+
+void LogicThread::HandleUnitPushed(StringHash eventType, VariantMap& eventData)
+{
+    unsigned version = BOARD_LOGIC->GetVersion();
+
+    // Поток не знает предыдущее положение. Он получит копию поля, когда ход завершится.
+    if (!postedVersion_ || postedVersion_ + 1 != version)
+        return;
+
+    using namespace UnitPushed;
+    LogicCommand command;
+    command.type_ = LC_PUSH;
+    command.boardVersion_ = version;
+    command.cell_ = IntVector2(eventData[P_GRIDX].GetInt(), eventData[P_GRIDY].GetInt());
+
+    if (Post(command))
+        postedVersion_ = version;
+}
+
+// Событие отправляется на каждом шаге, пока поле ждет хода, но сверка
+// выполняется только один раз для каждого положения на доске.
+void LogicThread::HandleBoardReady(StringHash eventType, VariantMap& eventData)
+{
+    BoardLogic* boardLogic = BOARD_LOGIC;
+    unsigned version = boardLogic->GetVersion();
+    if (version == verifiedVersion_)
+        return;
+
+    // Поле пересоздано или изменено без хода игрока.
+    if (version != postedVersion_)
+    {
+        PostReset();
+        return;
+    }
+
+    const LogicSnapshot* snapshot = GetCurrentSnapshot();
+    if (!snapshot)
+        return;
+
+    verifiedVersion_ = version;
+
+    BoardState state;
+    boardLogic->GetState(state);
+    if (state.GetHash() == snapshot->state_.GetHash() && state.GetRandomSeed() == snapshot->state_.GetRandomSeed())
+        return;
+
+    URHO3D_LOGWARNING("Logic thread state differs from the board");
+    PostReset();
+}
+
+void LogicThread::ThreadFunction()
+{
+    while (shouldRun_)
+    {
+        unsigned tail = commandsTail_.load(std::memory_order_relaxed);
+        if (tail == commandsHead_.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            wakeCondition_.wait(lock, [this, tail]
+            {
+                return !shouldRun_ || commandsHead_.load(std::memory_order_acquire) != tail;
+            });
+            continue;
+        }
+
+        Execute(commands_[tail % LOGIC_QUEUE_SIZE]);
+        commandsTail_.store(tail + 1, std::memory_order_release);
+        Publish();
+    }
+}
+
+void LogicThread::Execute(const LogicCommand& command)
+{
+    GAME_PROFILE(LogicCommand);
+
+    current_.serial_ = command.serial_;
+
+    if (command.type_ == LC_RESET)
+    {
+        current_.boardVersion_ = command.boardVersion_;
+        current_.state_ = command.state_;
+        current_.numRemoved_ = 0;
+        hasState_ = true;
+    }
+    else if (command.type_ == LC_PUSH)
+    {
+        if (!hasState_)
+            return;
+
+        current_.boardVersion_ = command.boardVersion_;
+        current_.state_.Push(command.cell_.x_, command.cell_.y_);
+        current_.numRemoved_ = current_.state_.Settle();
+    }
+}
+
+void LogicThread::Publish()
+{
+    snapshots_[backSnapshot_] = current_;
+    backSnapshot_ = middleSnapshot_.exchange(backSnapshot_ | LOGIC_SNAPSHOT_NEW, std::memory_order_acq_rel) &
+        LOGIC_SNAPSHOT_INDEX;
+}
@@ -0,0 +1,109 @@
+/*
+Поток просчета ходов вперед.
+
+Настоящим полем остается BoardLogic в главном потоке: он сам применяет ходы,
+удаляет линии и анимирует юниты, а поток на это никак не влияет. Поток владеет
+копией основного игрового поля (BoardState) и проигрывает на ней каждый ход
+игрока сразу, как только он сделан: толчок, движение очереди по периметру
+и все последующие удаления линий. Поэтому положение после хода известно еще
+до окончания анимаций, и оценка подсказок (см. HintEngine.h) и поиск хода бота
+(команда bot в InputScript.h) запускаются по снимку потока, а не после того,
+как поле будет готово к ходу. Сами они выполняются в рабочих потоках движка.
+
+Главный поток передает команды (сброс поля, толчок) через
+очередь без блокировок с одним писателем и одним читателем. Поток после каждой
+команды публикует неизменяемый снимок состояния. Снимки хранятся в трех буферах:
+поток пишет в свой буфер, главный поток читает свой, а готовый снимок передается
+через третий обменом индексов, поэтому ни одна сторона не ждет другую.
+
+Когда поле готово к ходу, главный поток один раз сверяет снимок с настоящим
+полем. Если они не совпали (поле пересоздано, загружено состояние и т.п.),
+то поток получает копию настоящего поля.
+*/
+
+#pragma once
+#include "Global.h"
+#include "BoardState.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#define LOGIC_THREAD GetSubsystem<LogicThread>()
+
+// Размер очереди команд. Команды отправляются не чаще, чем ходит игрок.
+#define LOGIC_QUEUE_SIZE 16
+
+// Поток логики опубликовал новый снимок. Снимок доступен через LogicThread::GetCurrentSnapshot.
+URHO3D_EVENT(E_LOGICUPDATED, LogicUpdated)
+{
+}
+
+// Состояние основного поля после всех команд, отправленных потоку.
+struct LogicSnapshot
+{
+    // Номер последней выполненной команды.
+    unsigned serial_ = 0;
+    // Версия поля (см. BoardLogic::GetVersion), которой соответствует состояние.
+    unsigned boardVersion_ = 0;
+    // Поле после толчка и всех каскадов.
+    BoardState state_;
+    // Сколько юнитов удалил последний толчок с учетом каскадов.
+    int numRemoved_ = 0;
+};
+
+struct LogicCommand;
+
+class LogicThread : public Object, public Thread
+{
+    URHO3D_OBJECT(LogicThread, Object);
+
+public:
+    LogicThread(Context* context);
+    ~LogicThread();
+
+    // Снимок для текущего положения на основном поле или nullptr, если
+    // поток еще не выполнил все команды.
+    const LogicSnapshot* GetCurrentSnapshot() const;
+
+    virtual void ThreadFunction();
+
+private:
+    // Данные, которые изменяет только главный поток.
+    LogicCommand* commands_;
+    unsigned nextSerial_ = 1;
+    unsigned postedSerial_ = 0;
+    // Версия поля, до которой доведено состояние потока (0 - поток не знает поле).
+    unsigned postedVersion_ = 0;
+    // Версия поля, которая уже сверена со снимком.
+    unsigned verifiedVersion_ = 0;
+    // Индекс буфера, из которого читает главный поток.
+    unsigned frontSnapshot_ = 0;
+
+    // Данные, которые изменяет только поток логики.
+    LogicSnapshot current_;
+    bool hasState_ = false;
+    // Индекс буфера, в который пишет поток логики.
+    unsigned backSnapshot_ = 2;
+
+    // Общие данные.
+    LogicSnapshot snapshots_[3];
+    // Индекс готового снимка. Бит LOGIC_SNAPSHOT_NEW означает, что главный поток его еще не забрал.
+    std::atomic<unsigned> middleSnapshot_;
+    // Очередь команд: главный поток пишет в head, поток логики читает из tail.
+    std::atomic<unsigned> commandsHead_;
+    std::atomic<unsigned> commandsTail_;
+    // Поток спит, пока нет команд.
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCondition_;
+
+    // Вызываются в главном потоке.
+    bool Post(LogicCommand& command);
+    void PostReset();
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    void HandleUnitPushed(StringHash eventType, VariantMap& eventData);
+    void HandleBoardReady(StringHash eventType, VariantMap& eventData);
+
+    // Вызываются в потоке логики.
+    void Execute(const LogicCommand& command);
+    void Publish();
+};
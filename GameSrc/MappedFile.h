@@ -0,0 +1,39 @@
+/*
+Файл, отображенный в память только для чтения.
+
+Данные не копируются: операционная система подгружает страницы файла
+по мере обращения к ним и делит их между процессами.
+*/
+
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Возвращает false, если файл не удалось открыть или он пустой.
+    bool Open(const String& fileName);
+    void Close();
+
+    bool IsOpen() const { return data_ != nullptr; }
+    const unsigned char* GetData() const { return data_; }
+    unsigned GetSize() const { return size_; }
+
+private:
+    const unsigned char* data_;
+    unsigned size_;
+
+#ifdef _WIN32
+    void* fileHandle_;
+    void* mappingHandle_;
+#else
+    int fileDescriptor_;
+#endif
+
+    // Копирование запрещено.
+    MappedFile(const MappedFile&);
+    MappedFile& operator =(const MappedFile&);
+};
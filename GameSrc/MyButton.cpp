@@ -23,13 +23,20 @@ MyButton::MyButton(Context* context) :
     hoverColor_(BUTTON_HOVER_COLOR),
     normalColor_(BUTTON_NORMAL_COLOR),
     oldHover_(false),
-    oldPressed_(false)
+    oldPressed_(false),
+    awake_(false)
 {
     SetEnabled(true);
     focusMode_ = FM_FOCUSABLE;
 
     // Добавлено.
     SetColor(normalColor_);
+
+    // Видимость проверяется у любых элементов, так как кнопку могут скрыть вместе с родителем
+    // (см. HandleVisibleChanged).
+    SubscribeToEvent(this, E_HOVERBEGIN, URHO3D_HANDLER(MyButton, HandleStateChanged));
+    SubscribeToEvent(this, E_HOVEREND, URHO3D_HANDLER(MyButton, HandleStateChanged));
+    SubscribeToEvent(E_VISIBLECHANGED, URHO3D_HANDLER(MyButton, HandleVisibleChanged));
 }
 
 void MyButton::SetNormalColor(const Color& color)
@@ -90,8 +97,33 @@ void MyButton::GetBatches(PODVector<UIBatch>& batches, PODVector<float>& vertexD
     BorderImage::GetBatches(batches, vertexData, currentScissor, IntVector2::ZERO);
 }
 
-void MyButton::Update(float timeStep)
+void MyButton::Wake()
+{
+    if (awake_)
+        return;
+
+    awake_ = true;
+    // UI обновляет состояние кнопок в своем обработчике E_POSTUPDATE, который вызывается раньше.
+    SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(MyButton, HandlePostUpdate));
+}
+
+void MyButton::HandleStateChanged(StringHash eventType, VariantMap& eventData)
+{
+    Wake();
+}
+
+// Кнопка просыпается, только если изменилась видимость ее самой или одного из ее предков.
+void MyButton::HandleVisibleChanged(StringHash eventType, VariantMap& eventData)
 {
+    UIElement* element = static_cast<UIElement*>(eventData[VisibleChanged::P_ELEMENT].GetPtr());
+    if (element == this || (element && IsChildOf(element)))
+        Wake();
+}
+
+void MyButton::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    float timeStep = eventData[PostUpdate::P_TIMESTEP].GetFloat();
+
     if (!hovering_ && pressed_)
         SetPressed(false);
 
@@ -140,9 +172,16 @@ void MyButton::Update(float timeStep)
             SendEvent(E_PRESSED, eventData);
         }
     }
+
+    // Состояние обработано, анимация цвета обновляется движком.
+    if (!pressed_)
+    {
+        UnsubscribeFromEvent(E_POSTUPDATE);
+        awake_ = false;
+    }
 }
 
-// То, что ниже, не тронуто (за исключением имени класса).
+// То, что ниже, не тронуто (за исключением имени класса и пробуждения кнопки в SetPressed).
 
 MyButton::~MyButton()
 {
@@ -225,4 +264,5 @@ void MyButton::SetPressed(bool enable)
 {
     pressed_ = enable;
     SetChildOffset(pressed_ ? pressedChildOffset_ : IntVector2::ZERO);
+    Wake();
 }
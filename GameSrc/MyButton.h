@@ -13,6 +13,12 @@ https://github.com/urho3d/Urho3D/issues/1453.
 Но при этом будут заняты события, что не очень удобно, так как
 они могут потребоваться для других целей (в Urho3D новый обработчик
 события перезаписывает старый).
+
+Кнопка обновляется не каждый кадр, а только пока что-то меняется (см. Wake):
+после наведения мыши, ухода мыши, нажатия и смены видимости элементов.
+Пока кнопка нажата, она обновляется каждый кадр (отпускание при уходе мыши и
+повтор нажатий). Когда состояние обработано, кнопка отписывается от обновлений.
+Саму анимацию цвета движок обновляет только пока она идет.
 */
 
 #pragma once
@@ -27,7 +33,6 @@ public:
     virtual ~MyButton();
     static void RegisterObject(Context* context);
 
-    virtual void Update(float timeStep);
     virtual void OnClickBegin
         (const IntVector2& position, const IntVector2& screenPosition, int button, int buttons, int qualifiers, Cursor* cursor);
     virtual void OnClickEnd
@@ -61,6 +66,13 @@ public:
 protected:
     void SetPressed(bool enable);
 
+    // Добавлено.
+    // Подписывает кнопку на обновление до тех пор, пока ее состояние не перестанет меняться.
+    void Wake();
+    void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleStateChanged(StringHash eventType, VariantMap& eventData);
+    void HandleVisibleChanged(StringHash eventType, VariantMap& eventData);
+
     IntVector2 pressedChildOffset_;
     float repeatDelay_;
     float repeatRate_;
@@ -73,8 +85,10 @@ protected:
     Color normalColor_;
 
     // Актуальное состояние IsHovering и IsPressed гарантированно доступно
-    // только в функции Update (см https://github.com/urho3d/Urho3D/issues/1453).
+    // только после обновления интерфейса (см https://github.com/urho3d/Urho3D/issues/1453).
     // Поэтому вводим переменные для детектирования смены состояния.
     bool oldHover_;
     bool oldPressed_;
+    // Кнопка подписана на E_POSTUPDATE.
+    bool awake_;
 };
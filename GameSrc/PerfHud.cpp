@@ -0,0 +1,241 @@
+#include "PerfHud.h"
+#include "Urho3DAliases.h"
+#include "AllocationTracker.h"
+
+PerfCounters perfCounters;
+
+static const char* metricNames[] =
+{
+    "Frame ms",
+    "Units",
+    "Animating units",
+    "Cascade depth",
+    "Line searches",
+    "Line search ms",
+    "Border moves",
+    "Border move ms",
+    "Sound triggers",
+    "Draw calls",
+    "Batches",
+    "Input blocked",
+    "Allocations"
+};
+
+static_assert(sizeof(metricNames) / sizeof(metricNames[0]) == PM_COUNT, "Every perf metric needs a name");
+
+static const int SPARKLINE_WIDTH = PERF_HISTORY_SIZE / 2;
+static const int SPARKLINE_HEIGHT = 16;
+static const Color SPARKLINE_BACK_COLOR(0.0f, 0.0f, 0.0f, 0.5f);
+static const Color SPARKLINE_COLOR(0.3f, 1.0f, 0.3f);
+
+// График одного показателя за последние кадры. Каждый кадр рисуется
+// столбиком шириной в пиксель, масштаб подбирается по максимуму.
+class Sparkline : public UIElement
+{
+    URHO3D_OBJECT(Sparkline, UIElement);
+
+public:
+    Sparkline(Context* context, PerfHud* hud, PerfMetric metric) :
+        UIElement(context),
+        hud_(hud),
+        metric_(metric)
+    {
+        SetFixedSize(SPARKLINE_WIDTH, SPARKLINE_HEIGHT);
+    }
+
+    void GetBatches(PODVector<UIBatch>& batches, PODVector<float>& vertexData, const IntRect& currentScissor)
+    {
+        UIBatch batch(this, BLEND_ALPHA, currentScissor, nullptr, &vertexData);
+        batch.SetColor(SPARKLINE_BACK_COLOR);
+        batch.AddQuad(0, 0, GetWidth(), GetHeight(), 0, 0);
+
+        // Каждый столбик - два кадра, так как график вдвое уже истории.
+        unsigned numBars = Min((hud_->GetHistorySize() + 1) / 2, (unsigned)SPARKLINE_WIDTH);
+        float maxValue = 0.0f;
+        for (unsigned i = 0; i < numBars * 2 && i < hud_->GetHistorySize(); i++)
+            maxValue = Max(maxValue, hud_->GetValue(metric_, i));
+
+        if (maxValue > 0.0f)
+        {
+            batch.SetColor(SPARKLINE_COLOR);
+            for (unsigned i = 0; i < numBars; i++)
+            {
+                float value = hud_->GetValue(metric_, i * 2);
+                if (i * 2 + 1 < hud_->GetHistorySize())
+                    value = Max(value, hud_->GetValue(metric_, i * 2 + 1));
+
+                int height = (int)Ceil(value / maxValue * SPARKLINE_HEIGHT);
+                if (height > 0)
+                    batch.AddQuad(SPARKLINE_WIDTH - 1 - i, SPARKLINE_HEIGHT - height, 1, height, 0, 0);
+            }
+        }
+
+        UIBatch::AddOrMerge(batch, batches);
+    }
+
+private:
+    // Худ живет дольше своих элементов.
+    PerfHud* hud_;
+    PerfMetric metric_;
+};
+
+PerfHud::PerfHud(Context* context) :
+    Object(context)
+{
+    CreateUI();
+    SetVisible(false);
+
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(PerfHud, HandleBeginFrame));
+    SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(PerfHud, HandleEndRendering));
+}
+
+void PerfHud::CreateUI()
+{
+    Font* font = GET_FONT("Fonts/Anonymous Pro.ttf");
+
+    // Окно справа вверху, так как отладочный худ движка занимает левую часть экрана.
+    window_ = new UIElement(context_);
+    window_->SetAlignment(HA_RIGHT, VA_TOP);
+    window_->SetLayout(LM_VERTICAL, 2, IntRect(4, 4, 4, 4));
+    window_->SetPriority(100);
+    UI_ROOT->AddChild(window_);
+
+    for (int i = 0; i < PM_COUNT; i++)
+    {
+        UIElement* row = window_->CreateChild<UIElement>();
+        row->SetLayout(LM_HORIZONTAL, 4);
+
+        SharedPtr<Text> text(new Text(context_));
+        text->SetFont(font, 10);
+        text->SetFixedWidth(150);
+        text->SetVerticalAlignment(VA_CENTER);
+        row->AddChild(text);
+        texts_.Push(text);
+
+        row->AddChild(new Sparkline(context_, this, (PerfMetric)i));
+    }
+}
+
+void PerfHud::SetVisible(bool enable)
+{
+    window_->SetVisible(enable);
+}
+
+bool PerfHud::IsVisible() const
+{
+    return window_->IsVisible();
+}
+
+float PerfHud::GetValue(PerfMetric metric, unsigned age) const
+{
+    if (age >= historySize_)
+        return 0.0f;
+
+    unsigned index = (historyPos_ + PERF_HISTORY_SIZE - 1 - age) % PERF_HISTORY_SIZE;
+    return history_[index][metric];
+}
+
+void PerfHud::FinishFrame()
+{
+    float* values = history_[historyPos_];
+
+    BoardLogic* boardLogic = BOARD_LOGIC;
+    values[PM_FRAME_TIME] = frameTimer_.GetUSec(false) / 1000.0f;
+    values[PM_UNITS] = (float)boardLogic->GetNumUnits();
+    values[PM_ANIMATING_UNITS] = (float)perfCounters.animatingUnits_;
+    values[PM_CASCADE_DEPTH] = (float)boardLogic->GetCascadeDepth();
+    values[PM_LINE_SEARCHES] = (float)perfCounters.lineSearches_;
+    values[PM_LINE_SEARCH_TIME] = perfCounters.lineSearchUSec_ / 1000.0f;
+    values[PM_BORDER_MOVES] = (float)perfCounters.borderMoves_;
+    values[PM_BORDER_MOVE_TIME] = perfCounters.borderMoveUSec_ / 1000.0f;
+    values[PM_SOUND_TRIGGERS] = (float)perfCounters.soundTriggers_;
+    values[PM_DRAW_CALLS] = (float)numDrawCalls_;
+    values[PM_BATCHES] = (float)numBatches_;
+    values[PM_INPUT_BLOCKED] = perfCounters.inputBlocked_ ? 1.0f : 0.0f;
+    values[PM_ALLOCATIONS] = (float)(GetAllocationCount() - frameAllocStart_);
+
+    historyPos_ = (historyPos_ + 1) % PERF_HISTORY_SIZE;
+    historySize_ = Min(historySize_ + 1, (unsigned)PERF_HISTORY_SIZE);
+}
+
+void PerfHud::UpdateTexts()
+{
+    for (int i = 0; i < PM_COUNT; i++)
+    {
+        float value = GetValue((PerfMetric)i, 0);
+        String valueStr = (i == PM_FRAME_TIME || i == PM_LINE_SEARCH_TIME || i == PM_BORDER_MOVE_TIME) ?
+            ToString("%.2f", value) : String((int)value);
+
+        // Для заблокированного ввода важнее доля кадров, чем последний кадр.
+        if (i == PM_INPUT_BLOCKED)
+        {
+            unsigned numBlocked = 0;
+            for (unsigned age = 0; age < historySize_; age++)
+                numBlocked += GetValue(PM_INPUT_BLOCKED, age) > 0.0f;
+            valueStr = String(numBlocked) + "/" + String(historySize_);
+        }
+
+        texts_[i]->SetText(String(metricNames[i]) + ": " + valueStr);
+    }
+}
+
+bool PerfHud::Export(const String& fileName) const
+{
+    File file(context_, fileName, FILE_WRITE);
+    if (!file.IsOpen())
+        return false;
+
+    String header = "Frame";
+    for (int i = 0; i < PM_COUNT; i++)
+        header += String(",") + metricNames[i];
+    file.WriteLine(header);
+
+    // От старых кадров к новым.
+    for (unsigned age = historySize_; age-- > 0;)
+    {
+        String line = String(historySize_ - 1 - age);
+        for (int i = 0; i < PM_COUNT; i++)
+            line += "," + String(GetValue((PerfMetric)i, age));
+        file.WriteLine(line);
+    }
+
+    return true;
+}
+
+String PerfHud::ExportToPreferencesDir() const
+{
+    String fileName = FILE_SYSTEM->GetAppPreferencesDir("1vanK", "Soulmates")
+        + "Perf" + String(Time::GetSystemTime()) + ".csv";
+
+    if (!Export(fileName))
+    {
+        URHO3D_LOGERROR("Failed to save perf counters " + fileName);
+        return String::EMPTY;
+    }
+
+    URHO3D_LOGINFO("Perf counters saved to " + fileName);
+    return fileName;
+}
+
+void PerfHud::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (frameStarted_)
+    {
+        FinishFrame();
+        if (IsVisible())
+            UpdateTexts();
+    }
+
+    perfCounters = PerfCounters();
+    numDrawCalls_ = 0;
+    numBatches_ = 0;
+    frameAllocStart_ = GetAllocationCount();
+    frameTimer_.Reset();
+    frameStarted_ = true;
+}
+
+void PerfHud::HandleEndRendering(StringHash eventType, VariantMap& eventData)
+{
+    numDrawCalls_ = GRAPHICS->GetNumBatches();
+    numBatches_ = RENDERER->GetNumBatches();
+}
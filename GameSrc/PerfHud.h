@@ -0,0 +1,128 @@
+/*
+Худ производительности игры.
+
+Отладочный худ движка (F2) показывает только общую статистику рендеринга.
+Вместе с ним включается этот худ: счетчики игровой логики за последний кадр
+и график каждого счетчика за последние PERF_HISTORY_SIZE кадров. По F4 история
+счетчиков сохраняется в CSV-файл в папку с настройками игры.
+
+Счетчики заполняет игровой код в главном потоке (см. perfCounters и PERF_COUNT),
+а худ в начале каждого кадра переносит их в историю и обнуляет. История
+записывается и при скрытом худе, поэтому ее можно сохранить сразу после
+подозрительного момента.
+*/
+
+#pragma once
+#include "Global.h"
+#include "TraceProfiler.h"
+
+#define PERF_HUD GetSubsystem<PerfHud>()
+
+// Количество кадров в истории счетчиков.
+#define PERF_HISTORY_SIZE 240
+
+// Считает вызовы блока кода и суммарное время его выполнения за кадр.
+// Аргументы - имена полей PerfCounters.
+#define PERF_COUNT(calls, time) PerfScope perfScope_ ## calls(perfCounters.calls, perfCounters.time)
+
+// Счетчики текущего кадра. Изменяются только в главном потоке.
+struct PerfCounters
+{
+    // Юниты, которые двигаются или улетают (на всех досках).
+    unsigned animatingUnits_ = 0;
+    unsigned lineSearches_ = 0;
+    long long lineSearchUSec_ = 0;
+    unsigned borderMoves_ = 0;
+    long long borderMoveUSec_ = 0;
+    // Запущенные звуки.
+    unsigned soundTriggers_ = 0;
+    // Игрок не мог ходить, так как на основной доске что-то происходило (см. BoardLogic::needBreakUpdate_).
+    bool inputBlocked_ = false;
+};
+
+extern PerfCounters perfCounters;
+
+class PerfScope
+{
+public:
+    PerfScope(unsigned& calls, long long& time) :
+        time_(time),
+        begin_(TraceProfiler::GetUSec())
+    {
+        calls++;
+    }
+
+    ~PerfScope()
+    {
+        time_ += TraceProfiler::GetUSec() - begin_;
+    }
+
+private:
+    long long& time_;
+    long long begin_;
+};
+
+// Показатели, которые хранятся в истории. Имена - в PerfHud.cpp.
+enum PerfMetric
+{
+    PM_FRAME_TIME,
+    PM_UNITS,
+    PM_ANIMATING_UNITS,
+    PM_CASCADE_DEPTH,
+    PM_LINE_SEARCHES,
+    PM_LINE_SEARCH_TIME,
+    PM_BORDER_MOVES,
+    PM_BORDER_MOVE_TIME,
+    PM_SOUND_TRIGGERS,
+    PM_DRAW_CALLS,
+    PM_BATCHES,
+    PM_INPUT_BLOCKED,
+    PM_ALLOCATIONS,
+    PM_COUNT
+};
+
+class PerfHud : public Object
+{
+    URHO3D_OBJECT(PerfHud, Object);
+
+public:
+    PerfHud(Context* context);
+
+    void SetVisible(bool enable);
+    bool IsVisible() const;
+
+    // Значение показателя. age == 0 - последний завершенный кадр.
+    float GetValue(PerfMetric metric, unsigned age) const;
+    // Количество кадров в истории.
+    unsigned GetHistorySize() const { return historySize_; }
+
+    // Сохраняет историю в CSV-файл.
+    bool Export(const String& fileName) const;
+    // Сохраняет историю в папку с настройками игры и возвращает имя файла.
+    String ExportToPreferencesDir() const;
+
+private:
+    float history_[PERF_HISTORY_SIZE][PM_COUNT];
+    // Индекс, куда будет записан следующий кадр.
+    unsigned historyPos_ = 0;
+    unsigned historySize_ = 0;
+
+    HiresTimer frameTimer_;
+    bool frameStarted_ = false;
+    // Статистика рендеринга берется в конце рендеринга, так как в начале кадра она обнуляется.
+    unsigned numDrawCalls_ = 0;
+    unsigned numBatches_ = 0;
+    // Счетчик выделений памяти (всех потоков) на начало кадра.
+    unsigned long long frameAllocStart_ = 0;
+
+    SharedPtr<UIElement> window_;
+    Vector<SharedPtr<Text> > texts_;
+
+    void CreateUI();
+    // Переносит счетчики прошедшего кадра в историю.
+    void FinishFrame();
+    void UpdateTexts();
+
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    void HandleEndRendering(StringHash eventType, VariantMap& eventData);
+};
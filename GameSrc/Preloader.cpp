@@ -0,0 +1,118 @@
+#include "Preloader.h"
+#include "Urho3DAliases.h"
+#include <cstdlib>
+
+// Задает переменную окружения, если пользователь не задал ее сам.
+static void SetDefaultEnvironmentVariable(const char* name, const String& value)
+{
+    if (getenv(name))
+        return;
+
+#ifdef _WIN32
+    _putenv_s(name, value.CString());
+#else
+    setenv(name, value.CString(), 0);
+#endif
+}
+
+Preloader::Preloader(Context* context) :
+    Object(context)
+{
+    SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(Preloader, HandleResourceLoaded));
+}
+
+void Preloader::Load(const String& manifestName)
+{
+    // Сам манифест маленький, поэтому загружается сразу.
+    XMLFile* manifest = GET_XML_FILE(manifestName);
+    if (!manifest)
+        return;
+
+    for (XMLElement element = manifest->GetRoot().GetChild("resource"); element.NotNull();
+        element = element.GetNext("resource"))
+    {
+        String name = element.GetAttribute("name");
+        StringHash type(element.GetAttribute("type"));
+
+        // Если ресурс уже в кэше или в очереди, то событие о его загрузке не придет.
+        if (CACHE->BackgroundLoadResource(type, name))
+            pending_.Insert(StringHash(name));
+    }
+
+    MarkStage("Preload queued (" + String(pending_.Size()) + " resources)");
+}
+
+void Preloader::HandleResourceLoaded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ResourceBackgroundLoaded;
+
+    // Вместе с ресурсами из манифеста подгружаются их зависимости
+    // (например, текстуры материалов). Их не учитываем.
+    StringHash nameHash(eventData[P_RESOURCENAME].GetString());
+    if (!pending_.Erase(nameHash))
+        return;
+
+    if (!eventData[P_SUCCESS].GetBool())
+        numFailed_++;
+
+    if (pending_.Empty())
+    {
+        String stageName = "Preload finished";
+        if (numFailed_)
+            stageName += " (" + String(numFailed_) + " failed)";
+        MarkStage(stageName);
+    }
+}
+
+void Preloader::EnableDriverShaderCache()
+{
+    // CreateDir не создает вложенные папки.
+    String cacheDir = FILE_SYSTEM->GetAppPreferencesDir("1vanK", "Soulmates") + "ShaderCache/";
+    if (!FILE_SYSTEM->CreateDir(cacheDir))
+        return;
+
+    String nativeDir = GetNativePath(cacheDir);
+
+    // NVIDIA (Windows и Linux).
+    SetDefaultEnvironmentVariable("__GL_SHADER_DISK_CACHE", "1");
+    SetDefaultEnvironmentVariable("__GL_SHADER_DISK_CACHE_PATH", nativeDir);
+
+    // Mesa (Linux, в том числе программный рендеринг llvmpipe). Старые версии читают MESA_GLSL_CACHE_DIR.
+    SetDefaultEnvironmentVariable("MESA_SHADER_CACHE_DIR", nativeDir);
+    SetDefaultEnvironmentVariable("MESA_GLSL_CACHE_DIR", nativeDir);
+}
+
+void Preloader::WarmUpShaders(const String& listName)
+{
+    // Без графики компилировать нечего.
+    if (!GRAPHICS)
+        return;
+
+    SharedPtr<File> file = CACHE->GetFile(listName);
+    if (file)
+        GRAPHICS->PrecacheShaders(*file);
+}
+
+void Preloader::MarkStage(const String& name)
+{
+    Stage stage;
+    stage.name_ = name;
+    stage.usec_ = timer_.GetUSec(false);
+    stages_.Push(stage);
+}
+
+void Preloader::LogTimeline()
+{
+    String text = "Startup timeline:";
+    long long prevUsec = 0;
+
+    for (unsigned i = 0; i < stages_.Size(); i++)
+    {
+        const Stage& stage = stages_[i];
+        text += ToString("\n%9.1f ms (+%7.1f ms) ", stage.usec_ / 1000.0, (stage.usec_ - prevUsec) / 1000.0);
+        text += stage.name_;
+        prevUsec = stage.usec_;
+    }
+
+    URHO3D_LOGINFO(text);
+}
@@ -0,0 +1,77 @@
+/*
+Подсистема для фоновой загрузки ресурсов при старте игры.
+
+Список ресурсов берется из манифеста (GameData/Preload.xml). Все ресурсы
+ставятся в очередь фоновой загрузки кэша, поэтому главный поток не блокируется
+и первый кадр показывается сразу же после инициализации движка.
+
+После загрузки и создания сцены все используемые игрой варианты шейдеров
+компилируются заранее (см. WarmUpShaders), иначе каждый вариант компилируется
+при первом рисовании и вызывает рывок (первое выделение юнита, первое размытие меню).
+Список вариантов для материалов сцены и интерфейса хранится в GameData/Shaders/Precache.xml.
+Его нужно обновлять после изменения материалов или способа рисования (например, инстансинга):
+игра с ключом -dump-shaders <файл> запишет в файл все варианты, которые реально использовались.
+
+Движок не умеет сохранять связанные программы GL, поэтому на диске их хранит сам драйвер.
+Драйверы NVIDIA и Mesa ведут такой кэш, если он разрешен переменными окружения, и сами
+сбрасывают его при смене версии драйвера или исходников шейдеров. Игра включает этот кэш
+и направляет его в папку пользователя (см. EnableDriverShaderCache), поэтому на этих
+драйверах повторные запуски не компилируют программы заново. Остальные драйверы
+используют свой кэш по умолчанию (если он есть).
+
+Заодно подсистема ведет хронологию старта: каждый этап отмечается вызовом
+MarkStage, а итоговая таблица выводится в лог.
+*/
+
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+#define PRELOADER GetSubsystem<Preloader>()
+
+class Preloader : public Object
+{
+    URHO3D_OBJECT(Preloader, Object);
+
+public:
+    // Подсистема создается в конструкторе игры, чтобы хронология
+    // включала в себя инициализацию движка.
+    Preloader(Context* context);
+
+    // Ставит в очередь фоновой загрузки все ресурсы из манифеста.
+    void Load(const String& manifestName);
+
+    // Все ресурсы из манифеста загружены (или не смогли загрузиться).
+    bool IsFinished() const { return pending_.Empty(); }
+
+    // Включает дисковый кэш программ драйвера в папке пользователя. Вызывается до создания
+    // окна (контекст GL читает переменные окружения при создании). Значения, заданные
+    // пользователем, не меняются.
+    void EnableDriverShaderCache();
+
+    // Компилирует шейдеры и связывает программы из списка (формат Graphics::PrecacheShaders).
+    // Если кэш драйвера уже содержит программу, драйвер берет ее из кэша.
+    void WarmUpShaders(const String& listName);
+
+    // Отмечает завершение очередного этапа старта.
+    void MarkStage(const String& name);
+
+    // Выводит в лог время каждого этапа относительно запуска игры.
+    void LogTimeline();
+
+private:
+    struct Stage
+    {
+        String name_;
+        long long usec_;
+    };
+
+    // Отсчитывает время с момента запуска игры.
+    HiresTimer timer_;
+    Vector<Stage> stages_;
+
+    // Имена ресурсов, которые еще не загрузились.
+    HashSet<StringHash> pending_;
+    unsigned numFailed_ = 0;
+
+    void HandleResourceLoaded(StringHash eventType, VariantMap& eventData);
+};
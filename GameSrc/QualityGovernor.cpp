@@ -0,0 +1,250 @@
+#include "QualityGovernor.h"
+#include "CameraLogic.h"
+#include "Urho3DAliases.h"
+#include "TraceProfiler.h"
+
+static const char* tierNames[] =
+{
+    "full",
+    "low blur",
+    "half outline",
+    "no FXAA",
+    "few particles",
+    "low resolution"
+};
+
+static_assert(sizeof(tierNames) / sizeof(tierNames[0]) == QT_COUNT, "Every quality tier needs a name");
+
+QualityGovernor::QualityGovernor(Context* context) :
+    Object(context)
+{
+    for (int i = 0; i < QT_COUNT; i++)
+        probeDelays_[i] = QUALITY_PROBE_DELAY;
+}
+
+static ParticleEmitter* GetFireflies(Scene* scene)
+{
+    Node* node = scene->GetChild("Fireflies");
+    return node ? node->GetComponent<ParticleEmitter>() : nullptr;
+}
+
+void QualityGovernor::Start(QualityTier tier, float targetFps, bool adaptive)
+{
+    budget_ = 1000.0f / Max(targetFps, 1.0f);
+    adaptive_ = adaptive;
+
+    ParticleEmitter* emitter = GetFireflies(GLOBAL->scene_);
+    if (emitter && emitter->GetEffect())
+    {
+        minEmissionRate_ = emitter->GetEffect()->GetMinEmissionRate();
+        maxEmissionRate_ = emitter->GetEffect()->GetMaxEmissionRate();
+    }
+
+    tier_ = (QualityTier)Clamp((int)tier, (int)QT_FULL, QT_COUNT - 1);
+    ApplyTier();
+    URHO3D_LOGINFO("Quality tier: " + String(tierNames[tier_]) + (adaptive_ ? ", adaptive" : ", fixed"));
+
+    if (!adaptive_)
+        return;
+
+    // Первые кадры после загрузки неровные.
+    windowStart_ = Time::GetSystemTime();
+    skipWindow_ = true;
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(QualityGovernor, HandleBeginFrame));
+    SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(QualityGovernor, HandleEndRendering));
+}
+
+void QualityGovernor::SetTier(QualityTier tier)
+{
+    tier = (QualityTier)Clamp((int)tier, (int)QT_FULL, QT_COUNT - 1);
+    if (tier == tier_)
+        return;
+
+    tier_ = tier;
+    ApplyTier();
+    skipWindow_ = true;
+}
+
+SharedPtr<RenderPath> QualityGovernor::BuildRenderPath(QualityTier tier) const
+{
+    SharedPtr<RenderPath> renderPath(new RenderPath());
+    renderPath->Load(GET_XML_FILE(tier >= QT_LOW_RESOLUTION ?
+        "RenderPaths/MyForwardLowRes.xml" : "RenderPaths/MyForward.xml"));
+
+    // Сглаживание и размытие фона для меню.
+    renderPath->Append(GET_XML_FILE("PostProcess/FXAA3.xml"));
+    renderPath->Append(GET_XML_FILE("PostProcess/MyBlur.xml"));
+
+    if (tier >= QT_LOW_BLUR)
+    {
+        for (unsigned i = 0; i < renderPath->GetNumCommands(); i++)
+        {
+            RenderPathCommand* command = renderPath->GetCommand(i);
+            if (command->tag_ == "Blur" && command->pixelShaderName_ == "Blur")
+                command->pixelShaderDefines_ = "BLUR3";
+        }
+    }
+
+    if (tier >= QT_HALF_OUTLINE)
+    {
+        foreach(RenderTargetInfo& target, renderPath->renderTargets_)
+        {
+            if (target.name_ == "outlineMask")
+                target.size_ *= 2.0f;
+        }
+    }
+
+    renderPath->SetEnabled("FXAA3", tier < QT_NO_FXAA);
+
+    return renderPath;
+}
+
+unsigned QualityGovernor::WarmUpShaders() const
+{
+    GAME_PROFILE(WarmUpRenderPathShaders);
+
+    Graphics* graphics = GRAPHICS;
+    HashSet<Pair<ShaderVariation*, ShaderVariation*> > programs;
+
+    // Выключенные команды тоже компилируются: размытие включается в меню,
+    // а FXAA - при повышении качества.
+    for (int tier = QT_FULL; tier < QT_COUNT; tier++)
+    {
+        SharedPtr<RenderPath> renderPath = BuildRenderPath((QualityTier)tier);
+
+        for (unsigned i = 0; i < renderPath->GetNumCommands(); i++)
+        {
+            const RenderPathCommand* command = renderPath->GetCommand(i);
+            if (command->type_ != CMD_QUAD)
+                continue;
+
+            // Те же варианты, что запрашивает View при рисовании прямоугольника.
+            ShaderVariation* vs = graphics->GetShader(VS, command->vertexShaderName_, command->vertexShaderDefines_);
+            ShaderVariation* ps = graphics->GetShader(PS, command->pixelShaderName_, command->pixelShaderDefines_);
+            if (!vs || !ps || programs.Contains(MakePair(vs, ps)))
+                continue;
+
+            // Компилирует оба шейдера и связывает программу (в OpenGL).
+            graphics->SetShaders(vs, ps);
+            programs.Insert(MakePair(vs, ps));
+        }
+    }
+
+    graphics->SetShaders(nullptr, nullptr);
+    return programs.Size();
+}
+
+void QualityGovernor::ApplyTier()
+{
+    GAME_PROFILE(ApplyQualityTier);
+
+    Viewport* viewport = RENDERER->GetViewport(0);
+
+    // Сила размытия анимируется (см. CameraLogic), поэтому переносится из старого рендерпаса.
+    // В рендерпасе по умолчанию размытия нет, а игра стартует в стартовом меню с полным размытием.
+    float blurSigma = viewport->GetRenderPath()->GetShaderParameter("BlurSigma").GetFloat();
+    if (blurSigma < MIN_BLUR_SIGMA)
+        blurSigma = MAX_BLUR_SIGMA;
+
+    SharedPtr<RenderPath> renderPath = BuildRenderPath(tier_);
+    renderPath->SetShaderParameter("BlurSigma", blurSigma);
+    renderPath->SetEnabled("Blur", blurSigma > MIN_BLUR_SIGMA);
+    viewport->SetRenderPath(renderPath);
+
+    ParticleEmitter* emitter = GetFireflies(GLOBAL->scene_);
+    if (emitter && emitter->GetEffect())
+    {
+        float scale = tier_ >= QT_FEW_PARTICLES ? 0.5f : 1.0f;
+        emitter->GetEffect()->SetMinEmissionRate(minEmissionRate_ * scale);
+        emitter->GetEffect()->SetMaxEmissionRate(maxEmissionRate_ * scale);
+    }
+}
+
+void QualityGovernor::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (frameStarted_)
+    {
+        float frameTime = frameTimer_.GetUSec(false) / 1000.0f;
+        numFrames_++;
+        frameTimeSum_ += frameTime;
+        maxFrameTime_ = Max(maxFrameTime_, frameTime);
+        if (frameTime > budget_ * QUALITY_SLOW_FRAME_FACTOR)
+            numSlowFrames_++;
+    }
+
+    frameTimer_.Reset();
+    frameStarted_ = true;
+
+    if (Time::GetSystemTime() - windowStart_ >= QUALITY_WINDOW)
+        EvaluateWindow();
+}
+
+void QualityGovernor::HandleEndRendering(StringHash eventType, VariantMap& eventData)
+{
+    workTimeSum_ += frameTimer_.GetUSec(false) / 1000.0f;
+}
+
+void QualityGovernor::EvaluateWindow()
+{
+    unsigned now = Time::GetSystemTime();
+    unsigned windowLength = now - windowStart_;
+    float slowShare = numFrames_ ? (float)numSlowFrames_ / numFrames_ : 0.0f;
+    float meanFrameTime = numFrames_ ? frameTimeSum_ / numFrames_ : 0.0f;
+    float meanWorkTime = numFrames_ ? workTimeSum_ / numFrames_ : 0.0f;
+    float maxFrameTime = maxFrameTime_;
+
+    windowStart_ = now;
+    numFrames_ = 0;
+    numSlowFrames_ = 0;
+    maxFrameTime_ = 0.0f;
+    frameTimeSum_ = 0.0f;
+    workTimeSum_ = 0.0f;
+
+    if (skipWindow_)
+    {
+        skipWindow_ = false;
+        return;
+    }
+
+    QualityTier newTier = tier_;
+
+    if (slowShare > QUALITY_DOWNGRADE_SHARE)
+    {
+        calmTime_ = 0;
+
+        // Повышенный уровень не выдержал. Следующая проба на него - вдвое позже.
+        if (probing_)
+        {
+            probing_ = false;
+            probeDelays_[tier_] = Min(probeDelays_[tier_] * 2, (unsigned)QUALITY_MAX_PROBE_DELAY);
+        }
+
+        if (tier_ + 1 < QT_COUNT)
+            newTier = (QualityTier)(tier_ + 1);
+    }
+    else if (slowShare < QUALITY_CALM_SHARE)
+    {
+        probing_ = false;
+        calmTime_ += windowLength;
+
+        if (tier_ > QT_FULL && calmTime_ >= probeDelays_[tier_ - 1])
+        {
+            newTier = (QualityTier)(tier_ - 1);
+            probing_ = true;
+            calmTime_ = 0;
+        }
+    }
+    else
+    {
+        calmTime_ = 0;
+    }
+
+    if (newTier == tier_)
+        return;
+
+    URHO3D_LOGINFO("Quality tier: " + String(tierNames[tier_]) + " -> " + String(tierNames[newTier]) +
+        " (frame " + String(meanFrameTime) + " ms, max " + String(maxFrameTime) +
+        " ms, cpu " + String(meanWorkTime) + " ms, slow " + String((int)(slowShare * 100.0f)) + "%)");
+
+    SetTier(newTier);
+}
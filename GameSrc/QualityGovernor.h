@@ -0,0 +1,118 @@
+/*
+Регулятор качества графики: держит время кадра в пределах бюджета, отключая
+дорогие эффекты по очереди (уровни QualityTier) и возвращая их, когда запас появляется.
+
+Время кадра измеряется между соседними E_BEGINFRAME, поэтому в него входит и ожидание
+видеокарты при выводе кадра. Отдельно замеряется работа процессора (от начала кадра
+до E_ENDRENDERING). Таймеров видеокарты в движке нет, поэтому разница этих двух времен -
+только оценка нагрузки на видеокарту (для лога).
+
+Ограничитель ФПС и вертикальная синхронизация не дают кадру стать короче бюджета,
+поэтому запас измерить нельзя. Вместо этого качество пробно повышается, если
+перегрузок давно не было. Если после пробы кадры снова стали медленными, уровень
+возвращается, а следующая проба на этот уровень откладывается вдвое дольше.
+Так регулятор не качается между соседними уровнями.
+
+Рендерпас вьюпорта собирается здесь же (см. ApplyTier), поэтому все эффекты
+рендерпаса добавляются в функции BuildRenderPath. Шейдеры команд постобработки
+всех уровней компилируются при старте (см. WarmUpShaders).
+
+Настройки в конфиге:
+    TargetFps       - целевая частота кадров (бюджет кадра 1000 / TargetFps мс);
+    QualityTier     - начальный уровень;
+    QualityGovernor - 0 отключает автоматическую регулировку.
+*/
+
+#pragma once
+#include "Global.h"
+
+#define QUALITY_GOVERNOR GetSubsystem<QualityGovernor>()
+
+// Уровни качества. Каждый уровень включает все упрощения предыдущих уровней.
+enum QualityTier
+{
+    QT_FULL,
+    // Размытие фона меню по 3 точкам вместо 5.
+    QT_LOW_BLUR,
+    // Маска обводки в половинном разрешении.
+    QT_HALF_OUTLINE,
+    // Без сглаживания FXAA.
+    QT_NO_FXAA,
+    // Вдвое меньше частиц.
+    QT_FEW_PARTICLES,
+    // Сцена рисуется в уменьшенном разрешении и растягивается на экран.
+    QT_LOW_RESOLUTION,
+    QT_COUNT
+};
+
+// Кадры оцениваются окнами такой длительности (мс).
+#define QUALITY_WINDOW 1000
+
+// Кадр считается медленным, если он длиннее бюджета во столько раз.
+#define QUALITY_SLOW_FRAME_FACTOR 1.2f
+
+// Качество снижается, если в окне медленных кадров больше этой доли.
+#define QUALITY_DOWNGRADE_SHARE 0.2f
+
+// Медленных кадров меньше этой доли - окно считается спокойным.
+#define QUALITY_CALM_SHARE 0.02f
+
+// Через сколько спокойных миллисекунд делается первая проба повышения качества.
+// После каждой неудачной пробы на тот же уровень задержка удваивается.
+#define QUALITY_PROBE_DELAY 3000
+#define QUALITY_MAX_PROBE_DELAY 120000
+
+class QualityGovernor : public Object
+{
+    URHO3D_OBJECT(QualityGovernor, Object);
+
+public:
+    QualityGovernor(Context* context);
+
+    // Собирает рендерпас для указанного уровня. При adaptive == false уровень не меняется.
+    void Start(QualityTier tier, float targetFps, bool adaptive);
+
+    QualityTier GetTier() const { return tier_; }
+    void SetTier(QualityTier tier);
+
+    // Заранее компилирует шейдеры постобработки всех уровней, чтобы смена уровня,
+    // первое размытие фона и первая обводка не вызывали рывков. Возвращает количество программ.
+    unsigned WarmUpShaders() const;
+
+private:
+    QualityTier tier_ = QT_FULL;
+    bool adaptive_ = false;
+    // Бюджет кадра (мс).
+    float budget_ = 16.7f;
+
+    HiresTimer frameTimer_;
+    bool frameStarted_ = false;
+
+    // Счетчики текущего окна.
+    unsigned windowStart_ = 0;
+    unsigned numFrames_ = 0;
+    unsigned numSlowFrames_ = 0;
+    float maxFrameTime_ = 0.0f;
+    float workTimeSum_ = 0.0f;
+    float frameTimeSum_ = 0.0f;
+
+    // Первое окно после смены уровня пропускается (компиляция шейдеров, пересоздание текстур).
+    bool skipWindow_ = false;
+    // Сколько миллисекунд подряд перегрузок не было.
+    unsigned calmTime_ = 0;
+    // Уровень был только что повышен пробно. Если он не выдержит, проба считается неудачной.
+    bool probing_ = false;
+    unsigned probeDelays_[QT_COUNT];
+
+    // Исходная частота появления частиц.
+    float minEmissionRate_ = 0.0f;
+    float maxEmissionRate_ = 0.0f;
+
+    SharedPtr<RenderPath> BuildRenderPath(QualityTier tier) const;
+    void ApplyTier();
+    // Оценивает очередное окно и меняет уровень при необходимости.
+    void EvaluateWindow();
+
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    void HandleEndRendering(StringHash eventType, VariantMap& eventData);
+};
@@ -0,0 +1,231 @@
+#include "RecordTable.h"
+
+RecordTable::RecordTable() :
+    bestOverall_(-1)
+{
+    for (int i = 0; i < 32; i++)
+        bestByWidth_[i] = -1;
+    for (int i = 0; i < 16; i++)
+        bestByNumColors_[i] = -1;
+}
+
+RecordTable::Entry& RecordTable::GetOrCreateEntry(unsigned mode)
+{
+    HashMap<unsigned, unsigned>::ConstIterator it = index_.Find(mode);
+    if (it != index_.End())
+        return entries_[it->second_];
+
+    Entry entry;
+    entry.mode_ = mode;
+    entry.best_ = 0;
+    entry.numGames_ = 0;
+    index_[mode] = entries_.Size();
+    entries_.Push(entry);
+
+    return entries_.Back();
+}
+
+int RecordTable::GetBest(unsigned mode) const
+{
+    HashMap<unsigned, unsigned>::ConstIterator it = index_.Find(mode);
+    return it != index_.End() ? entries_[it->second_].best_ : 0;
+}
+
+bool RecordTable::UpdateBest(unsigned mode, int score)
+{
+    // Нет смысла хранить нулевые рекорды.
+    if (score <= GetBest(mode))
+        return false;
+
+    Entry& entry = GetOrCreateEntry(mode);
+    entry.best_ = score;
+    UpdateBestIndices(index_[mode]);
+
+    return true;
+}
+
+// Рекорды только растут, поэтому достаточно сравнить измененную запись с текущими лидерами.
+void RecordTable::UpdateBestIndices(unsigned entryIndex)
+{
+    const Entry& entry = entries_[entryIndex];
+    BoardMode mode = BoardMode::Unpack(entry.mode_);
+
+    int& byWidth = bestByWidth_[mode.width_];
+    if (byWidth < 0 || entries_[byWidth].best_ < entry.best_)
+        byWidth = entryIndex;
+
+    int& byNumColors = bestByNumColors_[mode.numColors_];
+    if (byNumColors < 0 || entries_[byNumColors].best_ < entry.best_)
+        byNumColors = entryIndex;
+
+    if (bestOverall_ < 0 || entries_[bestOverall_].best_ < entry.best_)
+        bestOverall_ = entryIndex;
+}
+
+void RecordTable::AddScore(unsigned mode, int score)
+{
+    Entry& entry = GetOrCreateEntry(mode);
+    entry.numGames_++;
+
+    if (entry.history_.Size() >= RECORD_HISTORY_SIZE)
+        entry.history_.Erase(0);
+    entry.history_.Push(score);
+
+    UpdateBest(mode, score);
+}
+
+const PODVector<int>* RecordTable::GetHistory(unsigned mode) const
+{
+    HashMap<unsigned, unsigned>::ConstIterator it = index_.Find(mode);
+    if (it == index_.End() || entries_[it->second_].history_.Empty())
+        return nullptr;
+
+    return &entries_[it->second_].history_;
+}
+
+unsigned RecordTable::GetNumGames(unsigned mode) const
+{
+    HashMap<unsigned, unsigned>::ConstIterator it = index_.Find(mode);
+    return it != index_.End() ? entries_[it->second_].numGames_ : 0;
+}
+
+float RecordTable::GetAverage(unsigned mode) const
+{
+    const PODVector<int>* history = GetHistory(mode);
+    if (!history)
+        return 0.0f;
+
+    int sum = 0;
+    for (unsigned i = 0; i < history->Size(); i++)
+        sum += history->At(i);
+
+    return (float)sum / history->Size();
+}
+
+int RecordTable::GetBestByWidth(int width, unsigned* outMode) const
+{
+    if (width < 0 || width >= 32 || bestByWidth_[width] < 0)
+        return 0;
+
+    const Entry& entry = entries_[bestByWidth_[width]];
+    if (outMode)
+        *outMode = entry.mode_;
+    return entry.best_;
+}
+
+int RecordTable::GetBestByNumColors(int numColors, unsigned* outMode) const
+{
+    if (numColors < 0 || numColors >= 16 || bestByNumColors_[numColors] < 0)
+        return 0;
+
+    const Entry& entry = entries_[bestByNumColors_[numColors]];
+    if (outMode)
+        *outMode = entry.mode_;
+    return entry.best_;
+}
+
+int RecordTable::GetBestOverall(unsigned* outMode) const
+{
+    if (bestOverall_ < 0)
+        return 0;
+
+    const Entry& entry = entries_[bestOverall_];
+    if (outMode)
+        *outMode = entry.mode_;
+    return entry.best_;
+}
+
+void RecordTable::GetNearestModes(PODVector<unsigned>& result, unsigned mode, unsigned count) const
+{
+    // Результат упорядочен по возрастанию расстояния. Параллельно храним расстояния.
+    PODVector<int> distances;
+    result.Clear();
+
+    foreach(const Entry& entry, entries_)
+    {
+        if (entry.mode_ == mode || entry.best_ <= 0)
+            continue;
+
+        int distance = BoardMode::Distance(mode, entry.mode_);
+        if (result.Size() == count && distance >= distances.Back())
+            continue;
+
+        unsigned pos = distances.Size();
+        while (pos > 0 && distances[pos - 1] > distance)
+            pos--;
+
+        distances.Insert(pos, distance);
+        result.Insert(pos, entry.mode_);
+
+        if (result.Size() > count)
+        {
+            distances.Pop();
+            result.Pop();
+        }
+    }
+}
+
+void RecordTable::Load(const XMLElement& table)
+{
+    entries_.Clear();
+    index_.Clear();
+    bestOverall_ = -1;
+    for (int i = 0; i < 32; i++)
+        bestByWidth_[i] = -1;
+    for (int i = 0; i < 16; i++)
+        bestByNumColors_[i] = -1;
+
+    // Рекорды хранятся атрибутами вида w6h6c6p0l3d1="12".
+    Vector<String> names = table.GetAttributeNames();
+    foreach(const String& name, names)
+    {
+        BoardMode mode;
+        if (mode.FromString(name))
+            UpdateBest(mode.Pack(), ToInt(table.GetAttribute(name)));
+    }
+
+    // История результатов хранится в дочерних элементах.
+    for (XMLElement element = table.GetChild("History"); element.NotNull(); element = element.GetNext("History"))
+    {
+        BoardMode mode;
+        if (!mode.FromString(element.GetAttribute("mode")))
+            continue;
+
+        Entry& entry = GetOrCreateEntry(mode.Pack());
+        entry.numGames_ = element.GetUInt("games");
+
+        Vector<String> scores = element.GetAttribute("scores").Split(' ');
+        foreach(const String& score, scores)
+        {
+            if (entry.history_.Size() < RECORD_HISTORY_SIZE)
+                entry.history_.Push(ToInt(score));
+        }
+    }
+}
+
+void RecordTable::Save(XMLElement& table) const
+{
+    foreach(const Entry& entry, entries_)
+    {
+        String modeStr = BoardMode::Unpack(entry.mode_).ToString();
+
+        if (entry.best_ > 0)
+            table.SetAttribute(modeStr, String(entry.best_));
+
+        if (entry.history_.Empty())
+            continue;
+
+        String scores;
+        for (unsigned i = 0; i < entry.history_.Size(); i++)
+        {
+            if (i > 0)
+                scores += " ";
+            scores += String(entry.history_[i]);
+        }
+
+        XMLElement element = table.CreateChild("History");
+        element.SetAttribute("mode", modeStr);
+        element.SetUInt("games", entry.numGames_);
+        element.SetAttribute("scores", scores);
+    }
+}
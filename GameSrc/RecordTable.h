@@ -0,0 +1,75 @@
+/*
+Таблица рекордов для всех режимов игры.
+
+Режимы хранятся в упакованном виде (см. BoardMode::Pack), поэтому строки
+разбираются только при загрузке конфига. Лучшие рекорды по ширине поля,
+по числу цветов и общий рекорд обновляются при каждом изменении,
+так что эти запросы выполняются за постоянное время. Стартовое меню показывает
+их вместе с рекордом самого похожего режима.
+
+Для каждого режима также хранится история результатов последних игр.
+*/
+
+#pragma once
+#include "BoardMode.h"
+
+// Количество последних результатов, которые хранятся для каждого режима.
+#define RECORD_HISTORY_SIZE 50
+
+class RecordTable
+{
+public:
+    RecordTable();
+
+    // Возвращает 0, если в этом режиме еще не играли.
+    int GetBest(unsigned mode) const;
+    // Обновляет рекорд, если счет больше. Возвращает true, если рекорд обновлен.
+    bool UpdateBest(unsigned mode, int score);
+
+    // Добавляет результат завершенной игры в историю (и обновляет рекорд).
+    void AddScore(unsigned mode, int score);
+    // Результаты последних игр от старых к новым. Возвращает nullptr, если истории нет.
+    const PODVector<int>* GetHistory(unsigned mode) const;
+    // Общее количество сыгранных игр (история хранит только последние).
+    unsigned GetNumGames(unsigned mode) const;
+    // Средний результат по истории. Возвращает 0, если истории нет.
+    float GetAverage(unsigned mode) const;
+
+    // Лучший рекорд среди режимов с указанной шириной поля или числом цветов и
+    // общий рекорд. Режим, в котором достигнут рекорд, записывается в outMode.
+    // Возвращают 0, если подходящих рекордов нет.
+    int GetBestByWidth(int width, unsigned* outMode = nullptr) const;
+    int GetBestByNumColors(int numColors, unsigned* outMode = nullptr) const;
+    int GetBestOverall(unsigned* outMode = nullptr) const;
+
+    // Режимы с рекордами, наиболее похожие на указанный (см. BoardMode::Distance).
+    // Сам режим в результат не попадает.
+    void GetNearestModes(PODVector<unsigned>& result, unsigned mode, unsigned count) const;
+
+    unsigned GetNumModes() const { return entries_.Size(); }
+
+    // Поддерживается старый формат, в котором были только атрибуты с рекордами.
+    void Load(const XMLElement& table);
+    void Save(XMLElement& table) const;
+
+private:
+    struct Entry
+    {
+        unsigned mode_;
+        int best_;
+        unsigned numGames_;
+        PODVector<int> history_;
+    };
+
+    Vector<Entry> entries_;
+    // Режим -> индекс в entries_.
+    HashMap<unsigned, unsigned> index_;
+
+    // Индексы записей с лучшими рекордами. -1 - записи нет.
+    int bestByWidth_[32];
+    int bestByNumColors_[16];
+    int bestOverall_;
+
+    Entry& GetOrCreateEntry(unsigned mode);
+    void UpdateBestIndices(unsigned entryIndex);
+};
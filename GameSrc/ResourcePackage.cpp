@@ -0,0 +1,250 @@
+#include "ResourcePackage.h"
+#include "DifficultyTable.h"
+#include "Urho3DAliases.h"
+
+// Размер страницы памяти (достаточно обратиться к одному байту страницы, чтобы она загрузилась).
+#define PREFETCH_PAGE_SIZE 4096
+
+// Файлы, которые игра читает в обход GetFile (например, отображает в память), поэтому
+// роутер их не видит. Они попадают в пакет всегда, даже если сессия их не использовала.
+static const char* packageIncludes[] =
+{
+    // Таблица сложности (см. DifficultyTable::Load).
+    "Difficulty.bin"
+};
+
+// Запоминает имена всех файлов, которые запрашивает кэш ресурсов.
+// Вызывается и из потоков фоновой загрузки, поэтому имена защищены мьютексом.
+class ResourceRecorder : public ResourceRouter
+{
+    URHO3D_OBJECT(ResourceRecorder, ResourceRouter);
+
+public:
+    ResourceRecorder(Context* context) :
+        ResourceRouter(context)
+    {
+    }
+
+    void Route(String& name, ResourceRequest requestType)
+    {
+        if (requestType != RESOURCE_GETFILE)
+            return;
+
+        MutexLock lock(mutex_);
+        names_.Insert(name);
+    }
+
+    void GetNames(Vector<String>& result)
+    {
+        MutexLock lock(mutex_);
+        result.Clear();
+        foreach(const String& name, names_)
+            result.Push(name);
+    }
+
+private:
+    Mutex mutex_;
+    HashSet<String> names_;
+};
+
+ResourcePackage::ResourcePackage(Context* context) :
+    Object(context)
+{
+}
+
+ResourcePackage::~ResourcePackage()
+{
+    // Нельзя закрывать отображение, пока рабочий поток читает его страницы.
+    // Если очередь уже уничтожена, то ее потоки остановлены.
+    WorkQueue* workQueue = WORK_QUEUE;
+    if (workQueue && prefetchItem_ && !prefetchItem_->completed_)
+        workQueue->Complete(0);
+}
+
+void ResourcePackage::StartRecording()
+{
+    if (recorder_)
+        return;
+
+    recorder_ = new ResourceRecorder(context_);
+    CACHE->AddResourceRouter(recorder_);
+}
+
+bool ResourcePackage::Save(const String& fileName)
+{
+    if (!recorder_)
+        return false;
+
+    HiresTimer timer;
+
+    Vector<String> names;
+    static_cast<ResourceRecorder*>(recorder_.Get())->GetNames(names);
+    CACHE->RemoveResourceRouter(recorder_);
+
+    for (unsigned i = 0; i < sizeof(packageIncludes) / sizeof(packageIncludes[0]); i++)
+    {
+        String name = packageIncludes[i];
+        if (!CACHE->Exists(name))
+        {
+            URHO3D_LOGERROR("Package file " + name + " not found");
+            return false;
+        }
+
+        if (!names.Contains(name))
+            names.Push(name);
+    }
+
+    // DDS подставляется роутером сжатых текстур (см. TextureBuilder.h) после записи
+    // имени PNG, поэтому в пакет он добавляется отдельно. PNG тоже остается в пакете
+    // для видеокарт без поддержки DXT.
+    for (unsigned i = 0, numNames = names.Size(); i < numNames; i++)
+    {
+        if (GetExtension(names[i]) == ".png")
+        {
+            String ddsName = ReplaceExtension(names[i], ".dds");
+            if (!names.Contains(ddsName) && CACHE->Exists(ddsName))
+                names.Push(ddsName);
+        }
+    }
+
+    Sort(names.Begin(), names.End());
+
+    // Запрошенные, но отсутствующие файлы (например, необязательные параметры текстур) пропускаются.
+    Vector<String> entryNames;
+    Vector<PODVector<unsigned char> > contents;
+    foreach(const String& name, names)
+    {
+        SharedPtr<File> file = CACHE->GetFile(name, false);
+        if (!file)
+            continue;
+
+        PODVector<unsigned char> data;
+        data.Resize(file->GetSize());
+        if (!data.Empty() && file->Read(&data[0], data.Size()) != data.Size())
+        {
+            URHO3D_LOGERROR("Can't read " + name);
+            return false;
+        }
+
+        entryNames.Push(name);
+        contents.Push(data);
+    }
+
+    File package(context_, fileName, FILE_WRITE);
+    if (!package.IsOpen())
+    {
+        URHO3D_LOGERROR("Can't open " + fileName + " for writing");
+        return false;
+    }
+
+    // Формат PackageFile: оглавление (имя, смещение, размер и контрольная сумма записи),
+    // а за ним данные записей подряд. Смещения отсчитываются от начала файла.
+    unsigned offset = 12;
+    foreach(const String& name, entryNames)
+        offset += name.Length() + 1 + 12;
+
+    unsigned packageChecksum = 0;
+    unsigned long long totalSize = 0;
+
+    package.WriteFileID("UPAK");
+    package.WriteUInt(entryNames.Size());
+    package.WriteUInt(0); // Контрольная сумма пакета, записывается в конце.
+
+    for (unsigned i = 0; i < entryNames.Size(); i++)
+    {
+        const PODVector<unsigned char>& data = contents[i];
+
+        unsigned checksum = 0;
+        for (unsigned j = 0; j < data.Size(); j++)
+            checksum = SDBMHash(checksum, data[j]);
+        packageChecksum = SDBMHash(packageChecksum, (unsigned char)checksum);
+
+        package.WriteString(entryNames[i]);
+        package.WriteUInt(offset);
+        package.WriteUInt(data.Size());
+        package.WriteUInt(checksum);
+
+        offset += data.Size();
+        totalSize += data.Size();
+    }
+
+    foreach(const PODVector<unsigned char>& data, contents)
+    {
+        if (!data.Empty())
+            package.Write(&data[0], data.Size());
+    }
+
+    package.Seek(8);
+    package.WriteUInt(packageChecksum);
+
+    URHO3D_LOGINFO("Package " + fileName + " with " + String(entryNames.Size()) + " files (" +
+        String((unsigned)(totalSize / 1024)) + " KB) saved in " + String(timer.GetUSec(false) / 1000000.0f) + " s");
+
+    return true;
+}
+
+static void PrefetchWork(const WorkItem* item, unsigned threadIndex)
+{
+    const unsigned char* begin = static_cast<const unsigned char*>(item->start_);
+    const unsigned char* end = static_cast<const unsigned char*>(item->end_);
+
+    // Результат не нужен, volatile не дает компилятору выбросить чтение.
+    volatile unsigned char sum = 0;
+    for (const unsigned char* page = begin; page < end; page += PREFETCH_PAGE_SIZE)
+        sum += *page;
+}
+
+bool ResourcePackage::Prefetch(const String& fileName)
+{
+    if (!mappedFile_.Open(fileName))
+    {
+        URHO3D_LOGWARNING("Can't map " + fileName);
+        return false;
+    }
+
+    WorkQueue* workQueue = WORK_QUEUE;
+    prefetchItem_ = workQueue->GetFreeItem();
+    prefetchItem_->workFunction_ = PrefetchWork;
+    prefetchItem_->start_ = const_cast<unsigned char*>(mappedFile_.GetData());
+    prefetchItem_->end_ = const_cast<unsigned char*>(mappedFile_.GetData() + mappedFile_.GetSize());
+    // Низкий приоритет: задачи игры важнее.
+    prefetchItem_->priority_ = 0;
+    prefetchItem_->sendEvent_ = false;
+    workQueue->AddWorkItem(prefetchItem_);
+
+    return true;
+}
+
+bool ResourcePackage::SelfTest()
+{
+    const Vector<SharedPtr<PackageFile> >& packages = CACHE->GetPackageFiles();
+    if (packages.Empty())
+    {
+        URHO3D_LOGERROR("Package self-test: no package is loaded");
+        return false;
+    }
+
+    // Папка GameData может подменять записи пакета, поэтому наличие записей проверяется в самих пакетах.
+    for (unsigned i = 0; i < sizeof(packageIncludes) / sizeof(packageIncludes[0]); i++)
+    {
+        bool found = false;
+        foreach(const SharedPtr<PackageFile>& package, packages)
+            found = found || package->Exists(packageIncludes[i]);
+
+        if (!found)
+        {
+            URHO3D_LOGERROR("Package self-test: " + String(packageIncludes[i]) + " is not packaged");
+            return false;
+        }
+    }
+
+    DifficultyTable table;
+    if (!table.Load(context_, "Difficulty.bin"))
+    {
+        URHO3D_LOGERROR("Package self-test: difficulty table is not loaded");
+        return false;
+    }
+
+    URHO3D_LOGINFO("Package self-test passed");
+    return true;
+}
@@ -0,0 +1,61 @@
+/*
+Пакет ресурсов.
+
+Без пакета ресурсы ищутся в трех папках (GameData, Data, CoreData), и при старте
+открываются сотни мелких файлов. На сетевых дисках старт упирается в задержки
+файловой системы, а не в распаковку ресурсов.
+
+Пакет собирается ключом -build-package <файл>: игра запускается как обычно (можно
+вместе с -script), а при выходе все ресурсы, которые игра запрашивала, записываются
+в один файл в формате пакетов движка (PackageFile) с готовым оглавлением.
+Файлы, которые игра читает мимо кэша ресурсов (таблица сложности отображается
+в память), роутер не видит, поэтому они перечислены в packageIncludes
+(ResourcePackage.cpp) и входят в пакет всегда.
+
+Если рядом с игрой лежит RESOURCE_PACKAGE_NAME, то папки Data и CoreData
+не подключаются. Папка GameData (если она есть) просматривается раньше пакета,
+поэтому при разработке измененные файлы подменяют упакованные. В поставке
+папки GameData нет, и все ресурсы берутся из пакета.
+
+Кэш ресурсов движка читает записи пакета только через File, поэтому отдать
+ресурсы прямо из отображения в память нельзя. Вместо этого пакет отображается
+в память, и рабочий поток последовательно проходит по всем его страницам
+(см. Prefetch). Пакет целиком оказывается в кэше операционной системы, и
+последующие чтения записей не обращаются к диску.
+*/
+
+#pragma once
+#include "MappedFile.h"
+
+#define RESOURCE_PACKAGE GetSubsystem<ResourcePackage>()
+
+// Имя пакета относительно папки с игрой.
+#define RESOURCE_PACKAGE_NAME "Resources.pak"
+
+class ResourcePackage : public Object
+{
+    URHO3D_OBJECT(ResourcePackage, Object);
+
+public:
+    ResourcePackage(Context* context);
+    ~ResourcePackage();
+
+    // Начинает записывать имена запрошенных ресурсов. Вызывается как можно раньше,
+    // до инициализации движка, чтобы попали и ресурсы самого движка.
+    void StartRecording();
+    // Сохраняет все записанные ресурсы в пакет.
+    bool Save(const String& fileName);
+
+    // Отображает подключенный пакет в память и подгружает его в фоне.
+    bool Prefetch(const String& fileName);
+
+    // Проверяет, что подключенный пакет содержит все обязательные файлы
+    // и что таблица сложности загружается.
+    bool SelfTest();
+
+private:
+    SharedPtr<ResourceRouter> recorder_;
+
+    MappedFile mappedFile_;
+    SharedPtr<WorkItem> prefetchItem_;
+};
@@ -0,0 +1,419 @@
+#include "TextureBuilder.h"
+
+// Заголовок DDS (https://docs.microsoft.com/windows/win32/direct3ddds/dds-header).
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE 0x80000
+#define DDPF_FOURCC 0x4
+#define DDSCAPS_COMPLEX 0x8
+#define DDSCAPS_TEXTURE 0x1000
+#define DDSCAPS_MIPMAP 0x400000
+
+static unsigned short ToRGB565(const float color[3])
+{
+    int r = Clamp((int)(color[0] + 0.5f), 0, 255);
+    int g = Clamp((int)(color[1] + 0.5f), 0, 255);
+    int b = Clamp((int)(color[2] + 0.5f), 0, 255);
+    return (unsigned short)((r >> 3) << 11 | (g >> 2) << 5 | (b >> 3));
+}
+
+static void FromRGB565(unsigned short value, int color[3])
+{
+    int r = value >> 11 & 31;
+    int g = value >> 5 & 63;
+    int b = value & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+static void WriteUShort(unsigned char* dest, unsigned value)
+{
+    dest[0] = (unsigned char)value;
+    dest[1] = (unsigned char)(value >> 8);
+}
+
+// Блок 4x4 пикселей в RGBA. За краем изображения повторяются крайние пиксели.
+static void GetBlock(const unsigned char* pixels, int width, int height, unsigned components,
+    int blockX, int blockY, unsigned char block[64])
+{
+    for (int y = 0; y < 4; y++)
+    {
+        int srcY = Min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++)
+        {
+            int srcX = Min(blockX * 4 + x, width - 1);
+            const unsigned char* src = pixels + (srcY * width + srcX) * components;
+            unsigned char* dest = block + (y * 4 + x) * 4;
+            dest[0] = src[0];
+            dest[1] = src[1];
+            dest[2] = src[2];
+            dest[3] = components == 4 ? src[3] : 255;
+        }
+    }
+}
+
+// Цвета блока аппроксимируются отрезком вдоль главной оси разброса цветов.
+static void CompressColorBlock(const unsigned char block[64], unsigned char* dest)
+{
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[i * 4 + c];
+    }
+    for (int c = 0; c < 3; c++)
+        mean[c] /= 16.0f;
+
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+    {
+        float r = block[i * 4] - mean[0];
+        float g = block[i * 4 + 1] - mean[1];
+        float b = block[i * 4 + 2] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+
+    // Главная ось находится степенным методом.
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float r = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+        float g = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+        float b = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+        float length = Max(Max(Abs(r), Abs(g)), Abs(b));
+        if (length < M_EPSILON)
+            break;
+        axis[0] = r / length;
+        axis[1] = g / length;
+        axis[2] = b / length;
+    }
+
+    int minIndex = 0;
+    int maxIndex = 0;
+    float minDot = M_INFINITY;
+    float maxDot = -M_INFINITY;
+    for (int i = 0; i < 16; i++)
+    {
+        float dot = block[i * 4] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+        if (dot < minDot)
+        {
+            minDot = dot;
+            minIndex = i;
+        }
+        if (dot > maxDot)
+        {
+            maxDot = dot;
+            maxIndex = i;
+        }
+    }
+
+    float maxColor[3];
+    float minColor[3];
+    for (int c = 0; c < 3; c++)
+    {
+        maxColor[c] = block[maxIndex * 4 + c];
+        minColor[c] = block[minIndex * 4 + c];
+    }
+
+    unsigned short color0 = ToRGB565(maxColor);
+    unsigned short color1 = ToRGB565(minColor);
+    // Четыре цвета в палитре только при color0 > color1.
+    if (color0 < color1)
+        Swap(color0, color1);
+
+    WriteUShort(dest, color0);
+    WriteUShort(dest + 2, color1);
+
+    unsigned indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        FromRGB565(color0, palette[0]);
+        FromRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            unsigned bestIndex = 0;
+            int bestError = M_MAX_INT;
+            for (unsigned j = 0; j < 4; j++)
+            {
+                int r = block[i * 4] - palette[j][0];
+                int g = block[i * 4 + 1] - palette[j][1];
+                int b = block[i * 4 + 2] - palette[j][2];
+                int error = r * r + g * g + b * b;
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = j;
+                }
+            }
+            indices |= bestIndex << (i * 2);
+        }
+    }
+
+    WriteUShort(dest + 4, indices);
+    WriteUShort(dest + 6, indices >> 16);
+}
+
+static void CompressAlphaBlock(const unsigned char block[64], unsigned char* dest)
+{
+    int alpha0 = 0;
+    int alpha1 = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        alpha0 = Max(alpha0, (int)block[i * 4 + 3]);
+        alpha1 = Min(alpha1, (int)block[i * 4 + 3]);
+    }
+
+    dest[0] = (unsigned char)alpha0;
+    dest[1] = (unsigned char)alpha1;
+
+    // Восемь значений в палитре при alpha0 > alpha1. Если значения равны, все индексы нулевые.
+    unsigned long long indices = 0;
+    if (alpha0 != alpha1)
+    {
+        int palette[8];
+        palette[0] = alpha0;
+        palette[1] = alpha1;
+        for (int j = 1; j < 7; j++)
+            palette[j + 1] = ((7 - j) * alpha0 + j * alpha1) / 7;
+
+        for (int i = 0; i < 16; i++)
+        {
+            unsigned long long bestIndex = 0;
+            int bestError = M_MAX_INT;
+            for (int j = 0; j < 8; j++)
+            {
+                int error = Abs(block[i * 4 + 3] - palette[j]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = j;
+                }
+            }
+            indices |= bestIndex << (i * 3);
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+        dest[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+unsigned GetDXTDataSize(int width, int height, bool alpha)
+{
+    unsigned numBlocks = (unsigned)((width + 3) / 4) * (unsigned)((height + 3) / 4);
+    return numBlocks * (alpha ? 16 : 8);
+}
+
+void CompressDXT(const unsigned char* pixels, int width, int height, unsigned components,
+    bool alpha, unsigned char* dest)
+{
+    unsigned char block[64];
+
+    for (int blockY = 0; blockY < (height + 3) / 4; blockY++)
+    {
+        for (int blockX = 0; blockX < (width + 3) / 4; blockX++)
+        {
+            GetBlock(pixels, width, height, components, blockX, blockY, block);
+
+            if (alpha)
+            {
+                CompressAlphaBlock(block, dest);
+                dest += 8;
+            }
+
+            CompressColorBlock(block, dest);
+            dest += 8;
+        }
+    }
+}
+
+static bool SaveDDS(Context* context, const String& fileName, const Vector<SharedPtr<Image> >& levels, bool alpha)
+{
+    File file(context, fileName, FILE_WRITE);
+    if (!file.IsOpen())
+    {
+        URHO3D_LOGERROR("Can't open " + fileName + " for writing");
+        return false;
+    }
+
+    const Image* image = levels[0];
+    bool mipmap = levels.Size() > 1;
+
+    file.WriteFileID("DDS ");
+    file.WriteUInt(124);
+    file.WriteUInt(DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE |
+        (mipmap ? DDSD_MIPMAPCOUNT : 0));
+    file.WriteUInt(image->GetHeight());
+    file.WriteUInt(image->GetWidth());
+    file.WriteUInt(GetDXTDataSize(image->GetWidth(), image->GetHeight(), alpha));
+    file.WriteUInt(0); // Глубина.
+    file.WriteUInt(levels.Size());
+    for (int i = 0; i < 11; i++)
+        file.WriteUInt(0);
+
+    // Формат пикселей.
+    file.WriteUInt(32);
+    file.WriteUInt(DDPF_FOURCC);
+    file.WriteFileID(alpha ? "DXT5" : "DXT1");
+    for (int i = 0; i < 5; i++)
+        file.WriteUInt(0);
+
+    file.WriteUInt(DDSCAPS_TEXTURE | (mipmap ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+    for (int i = 0; i < 4; i++)
+        file.WriteUInt(0);
+
+    PODVector<unsigned char> data;
+    foreach(const SharedPtr<Image>& level, levels)
+    {
+        data.Resize(GetDXTDataSize(level->GetWidth(), level->GetHeight(), alpha));
+        CompressDXT(level->GetData(), level->GetWidth(), level->GetHeight(), level->GetComponents(), alpha, &data[0]);
+        file.Write(&data[0], data.Size());
+    }
+
+    return true;
+}
+
+// Параметры текстуры, которые движок читает из XML-файла с тем же именем, что и текстура.
+static bool SaveParameters(Context* context, const String& fileName, bool mipmap)
+{
+    SharedPtr<XMLFile> xml(new XMLFile(context));
+    XMLElement root = xml->CreateRoot("texture");
+    root.CreateChild("mipmap").SetBool("enable", mipmap);
+    root.CreateChild("quality").SetInt("low", 0);
+
+    File file(context, fileName, FILE_WRITE);
+    return file.IsOpen() && xml->Save(file);
+}
+
+bool TextureBuilder::Build(Context* context, const String& manifestName)
+{
+    HiresTimer timer;
+    ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+
+    XMLFile* manifest = cache->GetResource<XMLFile>(manifestName);
+    if (!manifest)
+        return false;
+
+    unsigned numTextures = 0;
+    unsigned long long sourceSize = 0;
+    unsigned long long compressedSize = 0;
+
+    for (XMLElement element = manifest->GetRoot().GetChild("texture"); element.NotNull();
+        element = element.GetNext("texture"))
+    {
+        String name = element.GetAttribute("name");
+        bool mipmap = element.GetBool("mipmap");
+
+        // Результат кладется рядом с исходным файлом, поэтому он должен лежать в папке, а не в пакете.
+        String sourceFileName = cache->GetResourceFileName(name);
+        SharedPtr<File> source = cache->GetFile(name);
+        if (sourceFileName.Empty() || !source)
+        {
+            URHO3D_LOGERROR("Texture " + name + " not found in resource directories");
+            return false;
+        }
+
+        SharedPtr<Image> image(new Image(context));
+        if (!image->Load(*source) || image->IsCompressed() || image->GetDepth() > 1 || image->GetComponents() < 3)
+        {
+            URHO3D_LOGERROR("Texture " + name + " must be an RGB or RGBA image");
+            return false;
+        }
+
+        bool alpha = image->GetComponents() == 4;
+
+        Vector<SharedPtr<Image> > levels;
+        levels.Push(image);
+        while (mipmap && (levels.Back()->GetWidth() > 1 || levels.Back()->GetHeight() > 1))
+            levels.Push(levels.Back()->GetNextLevel());
+
+        String ddsFileName = ReplaceExtension(sourceFileName, ".dds");
+        if (!SaveDDS(context, ddsFileName, levels, alpha))
+            return false;
+
+        if (!SaveParameters(context, ReplaceExtension(sourceFileName, ".xml"), mipmap))
+        {
+            URHO3D_LOGERROR("Can't save texture parameters for " + name);
+            return false;
+        }
+
+        numTextures++;
+        sourceSize += image->GetWidth() * image->GetHeight() * 4;
+        foreach(const SharedPtr<Image>& level, levels)
+            compressedSize += GetDXTDataSize(level->GetWidth(), level->GetHeight(), alpha);
+
+        URHO3D_LOGINFO("Texture " + name + " compressed to " + String(alpha ? "DXT5" : "DXT1") +
+            " with " + String(levels.Size()) + " mip levels");
+    }
+
+    // Сравнивается с размером несжатой текстуры без мипмапов.
+    URHO3D_LOGINFO(String(numTextures) + " textures compressed in " + String(timer.GetUSec(false) / 1000000.0f) +
+        " s, video memory " + String((unsigned)(sourceSize / 1024)) + " KB -> " +
+        String((unsigned)(compressedSize / 1024)) + " KB");
+
+    return true;
+}
+
+class CompressedTextureRouter : public ResourceRouter
+{
+    URHO3D_OBJECT(CompressedTextureRouter, ResourceRouter);
+
+public:
+    CompressedTextureRouter(Context* context) :
+        ResourceRouter(context)
+    {
+    }
+
+    void Route(String& name, ResourceRequest requestType)
+    {
+        HashMap<String, String>::ConstIterator i = routes_.Find(name);
+        if (i != routes_.End())
+            name = i->second_;
+    }
+
+    // Исходное имя текстуры -> имя DDS.
+    HashMap<String, String> routes_;
+};
+
+void TextureBuilder::RegisterRouter(Context* context, const String& manifestName)
+{
+    // Без поддержки DXT движок распаковывал бы DDS процессором, поэтому загружается PNG.
+    Graphics* graphics = context->GetSubsystem<Graphics>();
+    if (!graphics || !graphics->GetDXTSupport())
+        return;
+
+    ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+    XMLFile* manifest = cache->GetResource<XMLFile>(manifestName);
+    if (!manifest)
+        return;
+
+    SharedPtr<CompressedTextureRouter> router(new CompressedTextureRouter(context));
+    for (XMLElement element = manifest->GetRoot().GetChild("texture"); element.NotNull();
+        element = element.GetNext("texture"))
+    {
+        String name = element.GetAttribute("name");
+        String ddsName = ReplaceExtension(name, ".dds");
+
+        // DDS может быть не собран (тогда загружается PNG).
+        if (cache->Exists(ddsName))
+            router->routes_[name] = ddsName;
+    }
+
+    if (!router->routes_.Empty())
+        cache->AddResourceRouter(router);
+}
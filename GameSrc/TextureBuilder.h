@@ -0,0 +1,44 @@
+/*
+Сборка сжатых текстур.
+
+Текстуры игры хранятся в PNG, который при загрузке распаковывается процессором
+и загружается в видеопамять без сжатия. Ключ командной строки -build-textures <манифест>
+заранее сжимает перечисленные в манифесте текстуры в формат DXT1 (без прозрачности)
+или DXT5 (с прозрачностью), строит цепочку мипмапов и сохраняет результат в DDS
+рядом с исходным PNG. Заодно записывается файл параметров текстуры (XML с тем же
+именем), который движок читает при загрузке.
+
+Манифест (GameData/Textures/Compressed.xml):
+    <textures>
+        <texture name="Textures/Sky.png" mipmap="true" />
+    </textures>
+
+При запуске игры роутер ресурсов (см. RegisterRouter) подменяет запросы PNG
+на DDS, поэтому материалы и стили интерфейса продолжают ссылаться на PNG.
+Если видеокарта не поддерживает DXT или DDS не собран, загружается PNG.
+
+Сжатие с потерями, поэтому в манифест попадают только текстуры, которые растягиваются
+или фильтруются (фон). Атлас интерфейса рисуется пиксель в пиксель и остаётся в PNG.
+*/
+
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+// Размер сжатых данных для изображения указанного размера (в байтах).
+unsigned GetDXTDataSize(int width, int height, bool alpha);
+
+// Сжимает изображение (components - 3 или 4 байта на пиксель) в DXT1 (alpha == false)
+// или DXT5 (alpha == true). В dest должно поместиться GetDXTDataSize байт.
+// Не использует движок, можно вызывать из любого потока.
+void CompressDXT(const unsigned char* pixels, int width, int height, unsigned components,
+    bool alpha, unsigned char* dest);
+
+class TextureBuilder
+{
+public:
+    // Сжимает все текстуры из манифеста. Вызывать до RegisterRouter.
+    static bool Build(Context* context, const String& manifestName);
+
+    // Направляет запросы PNG из манифеста на собранные DDS, если видеокарта поддерживает DXT.
+    static void RegisterRouter(Context* context, const String& manifestName);
+};
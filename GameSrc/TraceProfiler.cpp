@@ -0,0 +1,181 @@
+#include "TraceProfiler.h"
+#include "Urho3DAliases.h"
+#include "AllocationTracker.h"
+#include <atomic>
+
+struct TraceEvent
+{
+    const char* name_;
+    long long begin_;
+    long long end_;
+};
+
+// Кольцевой буфер одного потока. Пишет в него только поток-владелец,
+// а читает главный поток при экспорте, поэтому блокировки не нужны.
+struct TraceBuffer
+{
+    // Порядковый номер потока. Используется как идентификатор потока в трассировке.
+    unsigned threadIndex_;
+    bool mainThread_;
+    // Общее количество записанных интервалов (а не только хранящихся в буфере).
+    std::atomic<unsigned> count_;
+    TraceEvent events_[TRACE_BUFFER_SIZE];
+};
+
+// Таймер создается вместе с первой подсистемой и никогда не удаляется: рабочие потоки
+// движка могут закончить интервал уже после того, как подсистема удалена.
+static HiresTimer* traceTimer = nullptr;
+// Интервалы записываются, только пока существует подсистема.
+static std::atomic<bool> traceActive(false);
+
+// Список буферов изменяется только при первом обращении нового потока к профайлеру.
+// Буферы живут до завершения процесса, так как рабочие потоки движка
+// могут пережить подсистему профайлера.
+static Mutex buffersMutex;
+static PODVector<TraceBuffer*> buffers;
+static thread_local TraceBuffer* threadBuffer = nullptr;
+
+static TraceBuffer* RegisterThreadBuffer()
+{
+    MutexLock lock(buffersMutex);
+
+    threadBuffer = new TraceBuffer();
+    threadBuffer->threadIndex_ = buffers.Size();
+    threadBuffer->mainThread_ = Thread::IsMainThread();
+    threadBuffer->count_ = 0;
+    buffers.Push(threadBuffer);
+
+    return threadBuffer;
+}
+
+ProfileScope::ProfileScope(const char* name) :
+    name_(name),
+    begin_(TraceProfiler::GetUSec()),
+    parentAllocationScope_(SetAllocationScope(name))
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+    TraceProfiler::AddEvent(name_, begin_, TraceProfiler::GetUSec());
+    SetAllocationScope(parentAllocationScope_);
+}
+
+TraceProfiler::TraceProfiler(Context* context) :
+    Object(context)
+{
+    if (!traceTimer)
+        traceTimer = new HiresTimer();
+    traceActive = true;
+
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(TraceProfiler, HandleBeginFrame));
+    SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(TraceProfiler, HandleEndFrame));
+}
+
+TraceProfiler::~TraceProfiler()
+{
+    traceActive = false;
+}
+
+long long TraceProfiler::GetUSec()
+{
+    return traceTimer ? traceTimer->GetUSec(false) : 0;
+}
+
+void TraceProfiler::AddEvent(const char* name, long long begin, long long end)
+{
+    if (!traceActive.load(std::memory_order_relaxed))
+        return;
+
+    TraceBuffer* buffer = threadBuffer;
+    if (!buffer)
+        buffer = RegisterThreadBuffer();
+
+    unsigned count = buffer->count_.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events_[count % TRACE_BUFFER_SIZE];
+    event.name_ = name;
+    event.begin_ = begin;
+    event.end_ = end;
+
+    // Читатель увидит новый интервал только после того, как он полностью записан.
+    buffer->count_.store(count + 1, std::memory_order_release);
+}
+
+void TraceProfiler::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    frameBegin_ = GetUSec();
+}
+
+void TraceProfiler::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    AddEvent("Frame", frameBegin_, GetUSec());
+}
+
+bool TraceProfiler::Export(const String& fileName)
+{
+    PODVector<TraceBuffer*> buffersCopy;
+    {
+        MutexLock lock(buffersMutex);
+        buffersCopy = buffers;
+    }
+
+    String text = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    PODVector<TraceEvent> events;
+
+    foreach(TraceBuffer* buffer, buffersCopy)
+    {
+        String threadName = buffer->mainThread_ ? "Main" : "Worker " + String(buffer->threadIndex_);
+        if (!first)
+            text += ",";
+        first = false;
+        text += ToString("\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            buffer->threadIndex_, threadName.CString());
+
+        unsigned end = buffer->count_.load(std::memory_order_acquire);
+        unsigned begin = end > TRACE_BUFFER_SIZE ? end - TRACE_BUFFER_SIZE : 0;
+
+        events.Clear();
+        for (unsigned i = begin; i < end; i++)
+            events.Push(buffer->events_[i % TRACE_BUFFER_SIZE]);
+
+        // Пока мы копировали, поток-владелец мог перезаписать самые старые интервалы.
+        // Интервал с номером after он, возможно, пишет прямо сейчас, а это та же ячейка,
+        // что и у интервала after - TRACE_BUFFER_SIZE, поэтому он тоже отбрасывается.
+        unsigned after = buffer->count_.load(std::memory_order_acquire) + 1;
+        unsigned skip = 0;
+        if (after > TRACE_BUFFER_SIZE && after - TRACE_BUFFER_SIZE > begin)
+            skip = Min(after - TRACE_BUFFER_SIZE - begin, events.Size());
+
+        for (unsigned i = skip; i < events.Size(); i++)
+        {
+            const TraceEvent& event = events[i];
+            text += ToString(",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld}",
+                event.name_, buffer->threadIndex_, event.begin_, event.end_ - event.begin_);
+        }
+    }
+
+    text += "\n]}\n";
+
+    File file(context_, fileName, FILE_WRITE);
+    if (!file.IsOpen())
+        return false;
+
+    file.Write(text.CString(), text.Length());
+    return true;
+}
+
+String TraceProfiler::ExportToPreferencesDir()
+{
+    String fileName = FILE_SYSTEM->GetAppPreferencesDir("1vanK", "Soulmates")
+        + "Trace" + String(Time::GetSystemTime()) + ".json";
+
+    if (!Export(fileName))
+    {
+        URHO3D_LOGERROR("Failed to save trace " + fileName);
+        return String::EMPTY;
+    }
+
+    URHO3D_LOGINFO("Trace saved to " + fileName);
+    return fileName;
+}
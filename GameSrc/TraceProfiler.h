@@ -0,0 +1,70 @@
+/*
+Профайлер игровых подсистем.
+
+Встроенный профайлер движка работает только в главном потоке и показывает
+результаты лишь в отладочном худе. Этот профайлер записывает именованные
+интервалы в кольцевой буфер своего потока (без блокировок), а по запросу
+сохраняет последние интервалы всех потоков в JSON-файл формата Chrome Trace Event.
+Файл можно открыть в chrome://tracing или в https://ui.perfetto.dev.
+
+Пример использования:
+void Foo()
+{
+    GAME_PROFILE(Foo);
+    ...
+}
+*/
+
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+#define TRACE_PROFILER GetSubsystem<TraceProfiler>()
+
+// Замеряет время выполнения блока кода, в котором объявлен.
+#define GAME_PROFILE(name) ProfileScope profileScope_ ## name(#name)
+
+// Количество интервалов, которые хранятся для каждого потока.
+// При переполнении самые старые интервалы перезаписываются.
+#define TRACE_BUFFER_SIZE 32768
+
+class ProfileScope
+{
+public:
+    // Имя должно быть строковой константой, так как сохраняется только указатель.
+    ProfileScope(const char* name);
+    ~ProfileScope();
+
+private:
+    const char* name_;
+    long long begin_;
+    // Область, которой приписывались выделения памяти до входа в эту (см. AllocationTracker.h).
+    const char* parentAllocationScope_;
+};
+
+class TraceProfiler : public Object
+{
+    URHO3D_OBJECT(TraceProfiler, Object);
+
+public:
+    TraceProfiler(Context* context);
+    ~TraceProfiler();
+
+    // Время в микросекундах с момента создания профайлера. Можно вызывать из любого потока.
+    static long long GetUSec();
+
+    // Записывает интервал в буфер текущего потока. Можно вызывать из любого потока.
+    static void AddEvent(const char* name, long long begin, long long end);
+
+    // Сохраняет содержимое буферов всех потоков в формате Chrome Trace Event.
+    bool Export(const String& fileName);
+
+    // Сохраняет трассировку в папку с настройками игры и возвращает имя файла.
+    String ExportToPreferencesDir();
+
+private:
+    // Начало текущего кадра.
+    long long frameBegin_ = 0;
+
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+};
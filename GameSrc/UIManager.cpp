@@ -2,65 +2,177 @@
 #include "BoardLogic.h"
 #include "Urho3DAliases.h"
 #include "Config.h"
+#include "TraceProfiler.h"
+#include "HintEngine.h"
+#include "VersusMode.h"
+#include "CompiledUI.h"
+#include "PerfHud.h"
+#include "GameClock.h"
+
+// Имена элементов в порядке UIElementHandle.
+static const char* uiElementNames[] =
+{
+    "Score",
+    "Record",
+    "Versus",
+    "LangButton",
+    "ReturnButton",
+    "SoundButton",
+    "MusicButton",
+    "StatsText",
+    "DifficultyText",
+    "RecordsText",
+    "WidthDecrease",
+    "WidthText",
+    "WidthIncrease",
+    "HeightDecrease",
+    "HeightText",
+    "HeightIncrease",
+    "NumColorsDecrease",
+    "NumColorsText",
+    "NumColorsIncrease",
+    "PopulationDecrease",
+    "PopulationText",
+    "PopulationIncrease",
+    "LineLengthDecrease",
+    "LineLengthText",
+    "LineLengthIncrease",
+    "DiagonalDecrease",
+    "DiagonalText",
+    "DiagonalIncrease",
+    "Start",
+    "ReplayButton"
+};
+
+static_assert(sizeof(uiElementNames) / sizeof(uiElementNames[0]) == UE_COUNT, "Every UI element handle needs a name");
+
+// Файлы, из которых создается интерфейс. Скомпилированный интерфейс устаревает при изменении любого из них.
+static const char* uiSourceNames[] =
+{
+    "UI/Style.xml",
+    "UI/StartMenu.xml",
+    "UI/GameOver.xml"
+};
+
+static const unsigned NUM_UI_SOURCES = sizeof(uiSourceNames) / sizeof(uiSourceNames[0]);
+
+typedef void (UIManager::*UIHandler)(StringHash eventType, VariantMap& eventData);
+
+// Обработчики нажатий на кнопки.
+static const struct
+{
+    UIElementHandle element_;
+    UIHandler handler_;
+}
+pressHandlers[] =
+{
+    { UE_LANG_BUTTON, &UIManager::HandleLangButtonClick },
+    { UE_RETURN_BUTTON, &UIManager::HandleReturnButtonClick },
+    { UE_SOUND_BUTTON, &UIManager::HandleSoundButtonClick },
+    { UE_MUSIC_BUTTON, &UIManager::HandleMusicButtonClick },
+    { UE_WIDTH_DECREASE, &UIManager::HandleWidthDecreaseClick },
+    { UE_WIDTH_INCREASE, &UIManager::HandleWidthIncreaseClick },
+    { UE_HEIGHT_DECREASE, &UIManager::HandleHeightDecreaseClick },
+    { UE_HEIGHT_INCREASE, &UIManager::HandleHeightIncreaseClick },
+    { UE_NUM_COLORS_DECREASE, &UIManager::HandleNumColorsDecreaseClick },
+    { UE_NUM_COLORS_INCREASE, &UIManager::HandleNumColorsIncreaseClick },
+    { UE_POPULATION_DECREASE, &UIManager::HandlePopulationDecreaseClick },
+    { UE_POPULATION_INCREASE, &UIManager::HandlePopulationIncreaseClick },
+    { UE_LINE_LENGTH_DECREASE, &UIManager::HandleLineLengthDecreaseClick },
+    { UE_LINE_LENGTH_INCREASE, &UIManager::HandleLineLengthIncreaseClick },
+    { UE_DIAGONAL_DECREASE, &UIManager::HandleDiagonalDecreaseClick },
+    { UE_DIAGONAL_INCREASE, &UIManager::HandleDiagonalIncreaseClick },
+    { UE_START, &UIManager::HandleStartClick },
+    { UE_REPLAY_BUTTON, &UIManager::HandleReplayButtonClick }
+};
 
 UIManager::UIManager(Context* context) : Object(context)
 {
     INPUT->SetMouseVisible(true);
 
-    // Создаем отладочный худ.
+    // Создаем отладочный худ. Без графики он не создается.
     XMLFile* defaultStyle = GET_XML_FILE("UI/DefaultStyle.xml");
     DebugHud* debugHud = ENGINE->CreateDebugHud();
-    debugHud->SetDefaultStyle(defaultStyle);
+    if (debugHud)
+        debugHud->SetDefaultStyle(defaultStyle);
 
-    // Остальные элементы используют кастомный стиль.
+    // Остальные элементы используют кастомный стиль. Он нужен и для скомпилированного
+    // интерфейса, так как кнопки громкости меняют свой стиль (см. Global::ApplySoundVolume).
     XMLFile* style = GET_XML_FILE("UI/Style.xml");
     UI_ROOT->SetDefaultStyle(style);
 
+    if (!CompiledUI::Load(context_, "UI/Compiled.bin", UI_ROOT, uiSourceNames, NUM_UI_SOURCES,
+        uiElementNames, UE_COUNT, elements_))
+    {
+        CreateFromXML(context_, UI_ROOT);
+        CompiledUI::FindHandles(UI_ROOT, uiElementNames, UE_COUNT, elements_);
+    }
+
+    soundButton_ = GetElement<MyButton>(UE_SOUND_BUTTON);
+    musicButton_ = GetElement<MyButton>(UE_MUSIC_BUTTON);
+
+    for (unsigned i = 0; i < sizeof(pressHandlers) / sizeof(pressHandlers[0]); i++)
+    {
+        SubscribeToEvent(elements_[pressHandlers[i].element_], E_PRESSED,
+            new EventHandlerImpl<UIManager>(this, pressHandlers[i].handler_));
+    }
+
+    // Таблицы может не быть (например, при смене правил ее нужно пересчитать).
+    if (!difficultyTable_.Load(context_, "Difficulty.bin"))
+        URHO3D_LOGWARNING("Difficulty table is not loaded");
+
+    UpdateUIVisibility();
+
+    SubscribeToEvent(E_GAMESTEP, URHO3D_HANDLER(UIManager, HandleGameStep));
+    SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(UIManager, HandlePostUpdate));
+}
+
+void UIManager::CreateFromXML(Context* context, UIElement* root)
+{
+    ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+
     // Создаем текстовый элемент для отображения счета.
-    Text* scoreText = UI_ROOT->CreateChild<Text>("Score");
+    Text* scoreText = root->CreateChild<Text>("Score");
     scoreText->SetStyle("ScoreText");
 
     // Создаем текстовый элемент для отображения рекорда.
-    Text* recordText = UI_ROOT->CreateChild<Text>("Record");
+    Text* recordText = root->CreateChild<Text>("Record");
     recordText->SetStyle("RecordText");
 
-    // Создаем кнопку для смены языка.
-    MyButton* langButton = UI_ROOT->CreateChild<MyButton>();
+    // Создаем текстовый элемент для состояния матча в режиме "на двоих".
+    Text* versusText = root->CreateChild<Text>("Versus");
+    versusText->SetStyle("VersusText");
+
+    // Создаем кнопку для смены языка. Имена кнопок нужны для записи и воспроизведения скриптов.
+    MyButton* langButton = root->CreateChild<MyButton>("LangButton");
     langButton->SetStyle("LangButton");
-    SubscribeToEvent(langButton, E_PRESSED, URHO3D_HANDLER(UIManager, HandleLangButtonClick));
 
     // Создаем кнопку возврата в стартовое меню.
-    MyButton* returnButton = UI_ROOT->CreateChild<MyButton>();
+    MyButton* returnButton = root->CreateChild<MyButton>("ReturnButton");
     returnButton->SetStyle("ReturnButton");
-    SubscribeToEvent(returnButton, E_PRESSED, URHO3D_HANDLER(UIManager, HandleReturnButtonClick));
 
     // Создаем кнопку для управления громкостью звуков.
-    soundButton_ = UI_ROOT->CreateChild<MyButton>();
-    soundButton_->SetStyle("SoundButton");
-    SubscribeToEvent(soundButton_, E_PRESSED, URHO3D_HANDLER(UIManager, HandleSoundButtonClick));
+    MyButton* soundButton = root->CreateChild<MyButton>("SoundButton");
+    soundButton->SetStyle("SoundButton");
 
     // Создаем кнопку для управления громкостью музыки.
-    musicButton_ = UI_ROOT->CreateChild<MyButton>();
-    musicButton_->SetStyle("MusicButton");
-    SubscribeToEvent(musicButton_, E_PRESSED, URHO3D_HANDLER(UIManager, HandleMusicButtonClick));
+    MyButton* musicButton = root->CreateChild<MyButton>("MusicButton");
+    musicButton->SetStyle("MusicButton");
 
-    LoadStartMenuLayout();
-    LoadGameOverLayout();
-
-    UpdateUIVisibility();
-
-    SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(UIManager, HandlePostUpdate));
+    UI* ui = context->GetSubsystem<UI>();
+    XMLFile* style = root->GetDefaultStyle();
+    root->AddChild(ui->LoadLayout(cache->GetResource<XMLFile>("UI/StartMenu.xml"), style));
+    root->AddChild(ui->LoadLayout(cache->GetResource<XMLFile>("UI/GameOver.xml"), style));
 }
 
-void UIManager::LoadGameOverLayout()
+bool UIManager::BuildCompiledUI(Context* context, const String& fileName)
 {
-    // Стиль "UI/Style.xml" был выбран ранее.
+    // Интерфейс собирается во временном элементе, а не в руте.
+    SharedPtr<UIElement> root(new UIElement(context));
+    root->SetDefaultStyle(context->GetSubsystem<ResourceCache>()->GetResource<XMLFile>("UI/Style.xml"));
+    CreateFromXML(context, root);
 
-    SharedPtr<UIElement> element = UI->LoadLayout(GET_XML_FILE("UI/GameOver.xml"));
-    UI_ROOT->AddChild(element);
-
-    UIElement* replayButton = element->GetChild("ReplayButton", false);
-    SubscribeToEvent(replayButton, E_PRESSED, URHO3D_HANDLER(UIManager, HandleReplayButtonClick));
+    return CompiledUI::Save(context, root, uiSourceNames, NUM_UI_SOURCES, uiElementNames, UE_COUNT, fileName);
 }
 
 void UIManager::HandleReplayButtonClick(StringHash eventType, VariantMap& eventData)
@@ -75,73 +187,97 @@ void UIManager::PlayClick()
     GLOBAL->PlaySound("Click", "Sounds/Click", 3);
 }
 
-void UIManager::LoadStartMenuLayout()
-{
-    // Стиль "UI/Style.xml" был выбран ранее.
-    
-    SharedPtr<UIElement> startMenu = UI->LoadLayout(GET_XML_FILE("UI/StartMenu.xml"));
-    UI_ROOT->AddChild(startMenu);
-
-    UIElement* button = startMenu->GetChild("WidthDecrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleWidthDecreaseClick));
-    button = startMenu->GetChild("WidthIncrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleWidthIncreaseClick));
-
-    button = startMenu->GetChild("HeightDecrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleHeightDecreaseClick));
-    button = startMenu->GetChild("HeightIncrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleHeightIncreaseClick));
-
-    button = startMenu->GetChild("NumColorsDecrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleNumColorsDecreaseClick));
-    button = startMenu->GetChild("NumColorsIncrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleNumColorsIncreaseClick));
-
-    button = startMenu->GetChild("PopulationDecrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandlePopulationDecreaseClick));
-    button = startMenu->GetChild("PopulationIncrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandlePopulationIncreaseClick));
-
-    button = startMenu->GetChild("LineLengthDecrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleLineLengthDecreaseClick));
-    button = startMenu->GetChild("LineLengthIncrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleLineLengthIncreaseClick));
-
-    button = startMenu->GetChild("DiagonalDecrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleDiagonalDecreaseClick));
-    button = startMenu->GetChild("DiagonalIncrease", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleDiagonalIncreaseClick));
-
-    button = startMenu->GetChild("Start", false);
-    SubscribeToEvent(button, E_PRESSED, URHO3D_HANDLER(UIManager, HandleStartClick));
-}
-
 void UIManager::UpdateStartMenuTexts()
 {
-    UIElement* startMenu = UI_ROOT->GetChild("StartMenu", false);
+    GAME_PROFILE(UpdateStartMenuTexts);
+
+    // Надписи зависят только от языка, режима и статистики режима.
+    RecordTable& records = CONFIG->GetRecords();
+    unsigned mode = BOARD_LOGIC->GetBoardMode().Pack();
+    int language = LOCALIZATION->GetLanguageIndex();
+    unsigned numGames = records.GetNumGames(mode);
+    int bestOverall = records.GetBestOverall();
 
-    Text* widthText = static_cast<Text*>(startMenu->GetChild("WidthText", false));
+    if (language == menuTextsLanguage_ && mode == menuTextsMode_ &&
+        numGames == menuTextsNumGames_ && bestOverall == menuTextsBestOverall_)
+    {
+        return;
+    }
+
+    menuTextsLanguage_ = language;
+    menuTextsMode_ = mode;
+    menuTextsNumGames_ = numGames;
+    menuTextsBestOverall_ = bestOverall;
+
+    Text* widthText = GetElement<Text>(UE_WIDTH_TEXT);
     widthText->SetText(LOCALIZATION->Get("Width") + ": " + String(BOARD_LOGIC->width_));
 
-    Text* heightText = static_cast<Text*>(startMenu->GetChild("HeightText", false));
+    Text* heightText = GetElement<Text>(UE_HEIGHT_TEXT);
     heightText->SetText(LOCALIZATION->Get("Height") + ": " + String(BOARD_LOGIC->height_));
 
-    Text* numColorsText = static_cast<Text*>(startMenu->GetChild("NumColorsText", false));
+    Text* numColorsText = GetElement<Text>(UE_NUM_COLORS_TEXT);
     numColorsText->SetText(LOCALIZATION->Get("Num Colors") + ": " + String(BOARD_LOGIC->numColors_));
 
-    Text* populationText = static_cast<Text*>(startMenu->GetChild("PopulationText", false));
+    Text* populationText = GetElement<Text>(UE_POPULATION_TEXT);
     populationText->SetText(LOCALIZATION->Get("Population") + ": " + String(BOARD_LOGIC->initialPopulation_));
 
-    Text* lineLengthText = static_cast<Text*>(startMenu->GetChild("LineLengthText", false));
+    Text* lineLengthText = GetElement<Text>(UE_LINE_LENGTH_TEXT);
     lineLengthText->SetText(LOCALIZATION->Get("Line Length") + ": " + String(BOARD_LOGIC->lineLength_));
 
-    Text* diagonalText = static_cast<Text*>(startMenu->GetChild("DiagonalText", false));
+    Text* diagonalText = GetElement<Text>(UE_DIAGONAL_TEXT);
     String diagonalStr = LOCALIZATION->Get("Diagonal") + ": ";
     if (BOARD_LOGIC->diagonal_)
         diagonalStr += LOCALIZATION->Get("ON");
     else
         diagonalStr += LOCALIZATION->Get("OFF");
     diagonalText->SetText(diagonalStr);
+
+    String statsStr = LOCALIZATION->Get("Games") + ": " + String(numGames);
+    if (records.GetHistory(mode))
+        statsStr += "   " + LOCALIZATION->Get("Average") + ": " + String(RoundToInt(records.GetAverage(mode)));
+    statsStr += "   " + LOCALIZATION->Get("Best Overall") + ": " + String(bestOverall);
+    Text* statsText = GetElement<Text>(UE_STATS_TEXT);
+    statsText->SetText(statsStr);
+
+    // Сложность режима берется из заранее рассчитанной таблицы.
+    String difficultyStr;
+    const DifficultyProfile* profile = difficultyTable_.GetProfile(BOARD_LOGIC->GetBoardMode());
+    if (profile)
+    {
+        difficultyStr = LOCALIZATION->Get("Expected Score") + ": " + String(profile->meanScore_) + "   " +
+            LOCALIZATION->Get("Game Length") + ": " + String(profile->movesP10_) + "-" +
+            String(profile->movesP90_) + " " + LOCALIZATION->Get("moves");
+    }
+    Text* difficultyText = GetElement<Text>(UE_DIFFICULTY_TEXT);
+    difficultyText->SetText(difficultyStr);
+
+    // Рекорды по ширине и числу цветов и рекорд самого похожего режима, в котором уже играли.
+    // Индексы таблицы рекордов делают это дешевым даже при тысячах режимов.
+    String recordsStr;
+    int bestByWidth = records.GetBestByWidth(BOARD_LOGIC->width_);
+    if (bestByWidth > 0)
+        recordsStr += LOCALIZATION->Get("Best for Width") + " " + String(BOARD_LOGIC->width_) + ": " + String(bestByWidth);
+
+    int bestByNumColors = records.GetBestByNumColors(BOARD_LOGIC->numColors_);
+    if (bestByNumColors > 0)
+    {
+        if (!recordsStr.Empty())
+            recordsStr += "   ";
+        recordsStr += LOCALIZATION->Get("Best for Colors") + " " + String(BOARD_LOGIC->numColors_) + ": " + String(bestByNumColors);
+    }
+
+    PODVector<unsigned> nearestModes;
+    records.GetNearestModes(nearestModes, mode, 1);
+    if (!nearestModes.Empty())
+    {
+        if (!recordsStr.Empty())
+            recordsStr += "   ";
+        recordsStr += LOCALIZATION->Get("Similar Mode") + " " + BoardMode::Unpack(nearestModes[0]).ToString() + ": " +
+            String(records.GetBest(nearestModes[0]));
+    }
+
+    Text* recordsText = GetElement<Text>(UE_RECORDS_TEXT);
+    recordsText->SetText(recordsStr);
 }
 
 void UIManager::HandleLangButtonClick(StringHash eventType, VariantMap& eventData)
@@ -207,7 +343,7 @@ void UIManager::HandleWidthDecreaseClick(StringHash eventType, VariantMap& event
     {
         BOARD_LOGIC->width_ = newWidth;
         BOARD_LOGIC->ClampPopulationAndLineLength();
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -222,7 +358,7 @@ void UIManager::HandleWidthIncreaseClick(StringHash eventType, VariantMap& event
     {
         BOARD_LOGIC->width_ = newWidth;
         BOARD_LOGIC->ClampPopulationAndLineLength();
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -237,7 +373,7 @@ void UIManager::HandleHeightDecreaseClick(StringHash eventType, VariantMap& even
     {
         BOARD_LOGIC->height_ = newHeight;
         BOARD_LOGIC->ClampPopulationAndLineLength();
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -252,7 +388,7 @@ void UIManager::HandleHeightIncreaseClick(StringHash eventType, VariantMap& even
     {
         BOARD_LOGIC->height_ = newHeight;
         BOARD_LOGIC->ClampPopulationAndLineLength();
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -266,7 +402,7 @@ void UIManager::HandleNumColorsDecreaseClick(StringHash eventType, VariantMap& e
     if (newNumColors != BOARD_LOGIC->numColors_)
     {
         BOARD_LOGIC->numColors_ = newNumColors;
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -280,7 +416,7 @@ void UIManager::HandleNumColorsIncreaseClick(StringHash eventType, VariantMap& e
     if (newNumColors != BOARD_LOGIC->numColors_)
     {
         BOARD_LOGIC->numColors_ = newNumColors;
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -294,7 +430,7 @@ void UIManager::HandlePopulationDecreaseClick(StringHash eventType, VariantMap&
     if (newPopulation != BOARD_LOGIC->initialPopulation_)
     {
         BOARD_LOGIC->initialPopulation_ = newPopulation;
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -308,7 +444,7 @@ void UIManager::HandlePopulationIncreaseClick(StringHash eventType, VariantMap&
     if (newPopulation != BOARD_LOGIC->initialPopulation_)
     {
         BOARD_LOGIC->initialPopulation_ = newPopulation;
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -322,7 +458,7 @@ void UIManager::HandleLineLengthDecreaseClick(StringHash eventType, VariantMap&
     if (newLineLength != BOARD_LOGIC->lineLength_)
     {
         BOARD_LOGIC->lineLength_ = newLineLength;
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -336,7 +472,7 @@ void UIManager::HandleLineLengthIncreaseClick(StringHash eventType, VariantMap&
     if (newLineLength != BOARD_LOGIC->lineLength_)
     {
         BOARD_LOGIC->lineLength_ = newLineLength;
-        BOARD_LOGIC->CreateBoard();
+        BOARD_LOGIC->RebuildBoard();
     }
 }
 
@@ -345,7 +481,7 @@ void UIManager::HandleDiagonalDecreaseClick(StringHash eventType, VariantMap& ev
     PlayClick();
 
     BOARD_LOGIC->diagonal_ = !BOARD_LOGIC->diagonal_;
-    BOARD_LOGIC->CreateBoard();
+    BOARD_LOGIC->RebuildBoard();
 }
 
 void UIManager::HandleDiagonalIncreaseClick(StringHash eventType, VariantMap& eventData)
@@ -353,12 +489,12 @@ void UIManager::HandleDiagonalIncreaseClick(StringHash eventType, VariantMap& ev
     PlayClick();
 
     BOARD_LOGIC->diagonal_ = !BOARD_LOGIC->diagonal_;
-    BOARD_LOGIC->CreateBoard();
+    BOARD_LOGIC->RebuildBoard();
 }
 
-void UIManager::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+void UIManager::HandleGameStep(StringHash eventType, VariantMap& eventData)
 {
-    float timeStep = eventData[PostUpdate::P_TIMESTEP].GetFloat();
+    float timeStep = eventData[GameStep::P_TIMESTEP].GetFloat();
 
     // Если отображаемый счет меньше реального счета, то плавно наращиваем его.
     if (showedScore_ < BOARD_LOGIC->score_)
@@ -366,25 +502,67 @@ void UIManager::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
         showedScore_ += timeStep * 10.0f;
         showedScore_ = Clamp(showedScore_, 0.0f, (float)BOARD_LOGIC->score_);
     }
+}
 
-    String scoreStr = LOCALIZATION->Get("Score") + ": ";
-    scoreStr += (int)showedScore_;
-    Text* scoreText = static_cast<Text*>(UI_ROOT->GetChild("Score", false));
-    scoreText->SetText(scoreStr);
+void UIManager::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    GAME_PROFILE(UIUpdate);
+
+    // Строки собираются только при изменении значений, чтобы не выделять память каждый кадр.
+    int language = LOCALIZATION->GetLanguageIndex();
+    int score = (int)showedScore_;
+    int record = CONFIG->GetRecords().GetBest(BOARD_LOGIC->GetBoardMode().Pack());
+
+    if (score != shownScore_ || language != shownLanguage_)
+    {
+        String scoreStr = LOCALIZATION->Get("Score") + ": ";
+        scoreStr += score;
+        Text* scoreText = GetElement<Text>(UE_SCORE);
+        scoreText->SetText(scoreStr);
+        shownScore_ = score;
+    }
+
+    if (record != shownRecord_ || language != shownLanguage_)
+    {
+        String recordStr = LOCALIZATION->Get("Record") + ": ";
+        recordStr += record;
+        Text* recordText = GetElement<Text>(UE_RECORD);
+        recordText->SetText(recordStr);
+        shownRecord_ = record;
+    }
+
+    shownLanguage_ = language;
 
-    String recordStr = LOCALIZATION->Get("Record") + ": ";
-    recordStr += CONFIG->GetRecord(BOARD_LOGIC->BoardModeToString());
-    Text* recordText = static_cast<Text*>(UI_ROOT->GetChild("Record", false));
-    recordText->SetText(recordStr);
+    Text* versusText = GetElement<Text>(UE_VERSUS);
+    versusText->SetText(VERSUS ? VERSUS->GetStatusText() : String::EMPTY);
 
     UpdateStartMenuTexts();
 
-    if (INPUT->GetKeyPress(KEY_F2))
+    // Худ производительности игры показывается вместе с отладочным худом движка.
+    if (INPUT->GetKeyPress(KEY_F2) && DEBUG_HUD)
+    {
         DEBUG_HUD->ToggleAll();
+        if (PERF_HUD)
+            PERF_HUD->SetVisible(DEBUG_HUD->GetMode() != DEBUGHUD_SHOW_NONE);
+    }
+
+    // Сохраняем трассировку последних кадров.
+    if (INPUT->GetKeyPress(KEY_F3))
+        TRACE_PROFILER->ExportToPreferencesDir();
+
+    // Сохраняем счетчики худа производительности.
+    if (INPUT->GetKeyPress(KEY_F4) && PERF_HUD)
+        PERF_HUD->ExportToPreferencesDir();
+
+    // Включаем и выключаем подсказки.
+    if (INPUT->GetKeyPress(KEY_H) && HINT_ENGINE)
+        HINT_ENGINE->SetEnabled(!HINT_ENGINE->IsEnabled());
 }
 
 void UIManager::UpdateUIVisibility()
 {
+    GAME_PROFILE(UpdateUIVisibility);
+
     String gameStateStr = GLOBAL->GameStateToString();
     
     PODVector<UIElement*> managedElements;
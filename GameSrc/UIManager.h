@@ -15,14 +15,55 @@
 Если у элемента есть тэг "Visible", то он виден в любом состоянии.
 
 Контролируются только дочерние элементы рута.
+
+Интерфейс создается из скомпилированного файла UI/Compiled.bin (см. CompiledUI.h),
+а если его нет или он устарел - из XML. Код обращается к элементам
+по индексам UIElementHandle, а не по именам.
 */
 
 #pragma once
 #include "Global.h"
 #include "MyButton.h"
+#include "DifficultyTable.h"
 
 #define UI_MANAGER GetSubsystem<UIManager>()
 
+// Элементы интерфейса, к которым обращается код. Имена элементов - в UIManager.cpp.
+enum UIElementHandle
+{
+    UE_SCORE,
+    UE_RECORD,
+    UE_VERSUS,
+    UE_LANG_BUTTON,
+    UE_RETURN_BUTTON,
+    UE_SOUND_BUTTON,
+    UE_MUSIC_BUTTON,
+    UE_STATS_TEXT,
+    UE_DIFFICULTY_TEXT,
+    UE_RECORDS_TEXT,
+    UE_WIDTH_DECREASE,
+    UE_WIDTH_TEXT,
+    UE_WIDTH_INCREASE,
+    UE_HEIGHT_DECREASE,
+    UE_HEIGHT_TEXT,
+    UE_HEIGHT_INCREASE,
+    UE_NUM_COLORS_DECREASE,
+    UE_NUM_COLORS_TEXT,
+    UE_NUM_COLORS_INCREASE,
+    UE_POPULATION_DECREASE,
+    UE_POPULATION_TEXT,
+    UE_POPULATION_INCREASE,
+    UE_LINE_LENGTH_DECREASE,
+    UE_LINE_LENGTH_TEXT,
+    UE_LINE_LENGTH_INCREASE,
+    UE_DIAGONAL_DECREASE,
+    UE_DIAGONAL_TEXT,
+    UE_DIAGONAL_INCREASE,
+    UE_START,
+    UE_REPLAY_BUTTON,
+    UE_COUNT
+};
+
 class UIManager : public Object
 {
     URHO3D_OBJECT(UIManager, Object);
@@ -33,6 +74,12 @@ public:
 
     UIManager(Context* context);
 
+    // Создает интерфейс из XML и сохраняет его в скомпилированном виде (ключ -build-ui).
+    static bool BuildCompiledUI(Context* context, const String& fileName);
+
+    // Отображаемый счет догоняет реальный с фиксированным шагом (см. GameClock.h).
+    void HandleGameStep(StringHash eventType, VariantMap& eventData);
+
     // Счет изменяется в Update, поэтому используем PostUpdate для
     // обновления соответствующего ему элемента интерфейса.
     // Заодно остальная UI-логика тоже тут.
@@ -62,7 +109,7 @@ public:
     void UpdateUIVisibility();
 
     // Обновляет все надписи в стартовом меню в соответствии с текущим языком
-    // и настройками игрового поля.
+    // и настройками игрового поля. Надписи пересобираются, только если что-то изменилось.
     void UpdateStartMenuTexts();
 
     // Возвращает элемент интерфейса под курсором мыши.
@@ -73,7 +120,24 @@ public:
     float showedScore_ = 0.0f;
 
 private:
-    void LoadStartMenuLayout();
-    void LoadGameOverLayout();
+    // Профили сложности для стартового меню.
+    DifficultyTable difficultyTable_;
+
+    // Значения, по которым последний раз собирались надписи.
+    int shownLanguage_ = -1;
+    int shownScore_ = -1;
+    int shownRecord_ = -1;
+    int menuTextsLanguage_ = -1;
+    unsigned menuTextsMode_ = 0;
+    unsigned menuTextsNumGames_ = 0;
+    int menuTextsBestOverall_ = -1;
+
+    // Элементы, к которым обращается код (индекс - UIElementHandle).
+    PODVector<UIElement*> elements_;
+
+    template <class T> T* GetElement(UIElementHandle handle) const { return static_cast<T*>(elements_[handle]); }
+
+    // Создает элементы из стиля и макетов. Стиль root должен быть уже выбран.
+    static void CreateFromXML(Context* context, UIElement* root);
     void PlayClick();
 };
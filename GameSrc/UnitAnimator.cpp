@@ -1,13 +1,16 @@
 #include "UnitAnimator.h"
 #include "Utils.h"
+#include "Urho3DAliases.h"
 
 static const float UNIT_MOVE_SPEED = 20.0f;
 static const float UNIT_SCALE_SPEED = 2.0f;
 static const float UNIT_ROTATE_SPEED = 90.0f;
+// Без графики невозможно определить, что юнит вылетел за пределы экрана,
+// поэтому он удаляется спустя фиксированное время.
+static const float UNIT_HEADLESS_REMOVE_TIME = 2.0f;
 
 UnitAnimator::UnitAnimator(Context* context) : Component(context)
 {
-    SubscribeToEvent(E_ANIMATEUNIT, URHO3D_HANDLER(UnitAnimator, Animate));
 }
 
 void UnitAnimator::RegisterObject(Context* context)
@@ -15,56 +18,79 @@ void UnitAnimator::RegisterObject(Context* context)
     context->RegisterFactory<UnitAnimator>();
 }
 
-void UnitAnimator::Animate(StringHash eventType, VariantMap& eventData)
+bool UnitAnimator::Animate(BoardLogic* board, float timeStep)
 {
-    float timeStep = eventData[AnimateUnit::P_TIMESTEP].GetFloat();
+    if (!initialized_)
+    {
+        position_ = node_->GetPosition();
+        scale_ = node_->GetScale().x_;
+        rotation_ = node_->GetRotation();
+        initialized_ = true;
+    }
+
+    prevPosition_ = position_;
+    prevScale_ = scale_;
+    prevRotation_ = rotation_;
 
+    // После Remove компонент может быть уже удален вместе с нодой.
     if (node_->HasTag("Removed"))
-        Remove(timeStep);
-    else
-        Move(timeStep);
+        return Remove(timeStep);
+
+    bool moving = Move(board, timeStep);
+    if (moving)
+        interpolating_ = true;
+    return moving;
 }
 
-void UnitAnimator::Move(float timeStep)
+void UnitAnimator::Interpolate(float alpha)
 {
+    if (!interpolating_)
+        return;
+
+    node_->SetTransform(prevPosition_.Lerp(position_, alpha), prevRotation_.Slerp(rotation_, alpha),
+        Lerp(prevScale_, scale_, alpha));
+
+    // Юнит остановился, и нода уже в конечном положении.
+    if (prevPosition_ == position_ && prevScale_ == scale_ && prevRotation_ == rotation_)
+        interpolating_ = false;
+}
+
+bool UnitAnimator::Move(BoardLogic* board, float timeStep)
+{
+    bool moving = false;
+
     // Индексы ячейки, в которой должен находиться юнит.
     // Юнит будет плавно двигаться в эту ячейку из текущего положения.
     int gridX = node_->GetVar("GridX").GetInt();
     int gridY = node_->GetVar("GridY").GetInt();
     
     // Позиция, к которой стремится юнит.
-    Vector3 targetPos = BOARD_LOGIC->GetCellPos(gridX, gridY);
+    Vector3 targetPos = board->GetCellPos(gridX, gridY);
 
-    Vector3 currentPos = node_->GetPosition();
-
-    if (!currentPos.Equals(targetPos))
+    if (!position_.Equals(targetPos))
     {
-        Vector3 newPos = ToTarget(currentPos, targetPos, UNIT_MOVE_SPEED, timeStep);
-        node_->SetPosition(newPos);
+        position_ = ToTarget(position_, targetPos, UNIT_MOVE_SPEED, timeStep);
         
         // В данной итерации игрового цикла пользователь не сможет кликать по юнитам.
-        BOARD_LOGIC->needBreakUpdate_ = true;
+        moving = true;
     }
 
     // Масштабируем юнит до единицы, если нужно.
-    float currentScale = node_->GetScale().x_;
-
-    if (!Equals(currentScale, 1.0f))
+    if (!Equals(scale_, 1.0f))
     {
-        float newScale = ToTarget(currentScale, 1.0f, UNIT_SCALE_SPEED, timeStep);
-        node_->SetScale(newScale);
+        scale_ = ToTarget(scale_, 1.0f, UNIT_SCALE_SPEED, timeStep);
 
         // В данной итерации игрового цикла пользователь не сможет кликать по юнитам.
-        BOARD_LOGIC->needBreakUpdate_ = true;
+        moving = true;
     }
+
+    return moving;
 }
 
-void UnitAnimator::Remove(float timeStep)
+// Так как воспроизводится анимация удаления юнита, то в данной итерации
+// игрового цикла пользователь не сможет кликать по юнитам.
+bool UnitAnimator::Remove(float timeStep)
 {
-    // Так как воспроизводится анимация удаления юнита, то в данной итерации
-    // игрового цикла пользователь не сможет кликать по юнитам.
-    BOARD_LOGIC->needBreakUpdate_ = true;
-
     // Юнит поврочачивается вокруг оси и только потом начинает улетать.
     removeTimer_ += timeStep;
     // Поворот на 180 градусов за первые пол секунды.
@@ -72,24 +98,36 @@ void UnitAnimator::Remove(float timeStep)
     {
         Quaternion startRot = Quaternion(0.0f, 180.0f, 0.0f);
         Quaternion endRot = Quaternion(0.0f, 0.0f, 0.0f);
-        Quaternion rot = startRot.Slerp(endRot, removeTimer_ * 2.0f);
-        node_->SetRotation(rot);
-        return;
+        rotation_ = startRot.Slerp(endRot, removeTimer_ * 2.0f);
+        interpolating_ = true;
+        return true;
     }
     // Поворот еще на 180 градусов за другие пол секунды.
     if (removeTimer_ < 1.0f)
     {
         Quaternion startRot = Quaternion(0.0f, 0.0f, 0.0f);
         Quaternion endRot = Quaternion(0.0f, -180.0f, 0.0f);
-        Quaternion rot = startRot.Slerp(endRot, (removeTimer_ - 0.5f) * 2.0f);
-        node_->SetRotation(rot);
-        return;
+        rotation_ = startRot.Slerp(endRot, (removeTimer_ - 0.5f) * 2.0f);
+        interpolating_ = true;
+        return true;
     }
 
-    node_->Translate(Vector3::FORWARD * timeStep * UNIT_MOVE_SPEED);
+    // То же, что Node::Translate в локальных координатах.
+    position_ += rotation_ * Vector3::FORWARD * timeStep * UNIT_MOVE_SPEED;
+    interpolating_ = true;
+
+    if (ENGINE->IsHeadless())
+    {
+        if (removeTimer_ > UNIT_HEADLESS_REMOVE_TIME)
+            node_->Remove();
+        return true;
+    }
 
     // Если юнит вылетел за пределы экрана, то удаляем ноду.
+    // После этого к компоненту обращаться нельзя: он удален вместе с нодой.
     StaticModel* staticModel = node_->GetComponent<StaticModel>();
     if (!staticModel->IsInView())
         node_->Remove();
+
+    return true;
 }
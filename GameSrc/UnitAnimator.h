@@ -5,6 +5,9 @@
 //    Для апдейта используется функция Remove.
 // В каком именно состоянии находится юнит, можно узнать по наличию
 // или отсутствию тега Removed.
+// Юниты анимирует их доска (см. BoardLogic::AnimateUnits) с фиксированным шагом
+// (см. GameClock.h). Анимация меняет только сохраненное в компоненте положение юнита,
+// а нода получает положение между двумя последними шагами в функции Interpolate.
 
 #pragma once
 #include "Global.h"
@@ -18,11 +21,27 @@ public:
     UnitAnimator(Context* context);
     static void RegisterObject(Context* context);
 
+    // Возвращает true, если юнит еще движется. Может удалить ноду юнита.
+    bool Animate(BoardLogic* board, float timeStep);
+
+    // Переносит в ноду положение между предыдущим (alpha == 0) и последним (alpha == 1) шагом.
+    void Interpolate(float alpha);
+
 private:
     // Счетчик времени используется в функции Remove.
     float removeTimer_ = 0.0f;
 
-    void Animate(StringHash eventType, VariantMap& eventData);
-    void Move(float timeStep);
-    void Remove(float timeStep);
+    // Положение после последнего и предыдущего шагов. Берется из ноды при первом шаге.
+    bool initialized_ = false;
+    Vector3 position_;
+    Vector3 prevPosition_;
+    float scale_ = 1.0f;
+    float prevScale_ = 1.0f;
+    Quaternion rotation_;
+    Quaternion prevRotation_;
+    // Положение ноды еще не совпадает с последним шагом.
+    bool interpolating_ = false;
+
+    bool Move(BoardLogic* board, float timeStep);
+    bool Remove(float timeStep);
 };
@@ -15,6 +15,7 @@
 #define ENGINE GetSubsystem<Engine>()
 #define LOCALIZATION GetSubsystem<Localization>()
 #define AUDIO GetSubsystem<Audio>()
+#define WORK_QUEUE GetSubsystem<WorkQueue>()
 
 #define GET_MATERIAL CACHE->GetResource<Material>
 #define GET_MODEL CACHE->GetResource<Model>
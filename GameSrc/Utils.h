@@ -1,6 +1,10 @@
 #pragma once
 #include <Urho3D/Urho3DAll.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 // Плавное изменение числа в сторону целевого значения с определенной скоростью.
 float ToTarget(float currentValue, float targetValue, float speed, float timeStep);
 
@@ -9,3 +13,15 @@ Vector3 ToTarget(const Vector3& currentPosition, const Vector3& targetPosition,
 
 // Квадрат расстояния между двумя точками на экране.
 float DistanceSquared(const IntVector2& p1, const IntVector2& p2);
+
+// Номер младшего установленного бита. Значение не должно быть нулем.
+inline int CountTrailingZeros(unsigned value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (int)index;
+#else
+    return __builtin_ctz(value);
+#endif
+}
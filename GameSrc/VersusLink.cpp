@@ -0,0 +1,201 @@
+#include "VersusLink.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Датаграммы протокола намного меньше этого размера.
+static const unsigned MAX_DATAGRAM_SIZE = 1024;
+
+#ifdef _WIN32
+static const unsigned long long NO_SOCKET = (unsigned long long)INVALID_SOCKET;
+#else
+static const int NO_SOCKET = -1;
+#endif
+
+VersusLink::VersusLink() :
+    peer_(nullptr),
+    latency_(0),
+    jitter_(0),
+    lossRate_(0.0f),
+    numPacketsSent_(0),
+    numPacketsLost_(0),
+    numBytesSent_(0),
+    socket_(NO_SOCKET),
+    remotePort_(0)
+{
+}
+
+VersusLink::~VersusLink()
+{
+    Close();
+}
+
+bool VersusLink::IsSocketOpen() const
+{
+    return socket_ != NO_SOCKET;
+}
+
+bool VersusLink::Open(unsigned short localPort, unsigned short remotePort)
+{
+    Close();
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return false;
+#endif
+
+    socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (!IsSocketOpen())
+    {
+        Close();
+        return false;
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(localPort);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(socket_, (sockaddr*)&address, sizeof(address)) != 0)
+    {
+        URHO3D_LOGERROR("Can't bind UDP port " + String(localPort));
+        Close();
+        return false;
+    }
+
+    // Сокет не должен блокировать игровой цикл.
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(socket_, FIONBIO, &nonBlocking);
+#else
+    fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    remotePort_ = remotePort;
+    return true;
+}
+
+void VersusLink::Connect(VersusLink& first, VersusLink& second)
+{
+    first.Close();
+    second.Close();
+    first.peer_ = &second;
+    second.peer_ = &first;
+}
+
+void VersusLink::Close()
+{
+    if (IsSocketOpen())
+    {
+#ifdef _WIN32
+        closesocket(socket_);
+        WSACleanup();
+#else
+        close(socket_);
+#endif
+    }
+
+    if (peer_)
+        peer_->peer_ = nullptr;
+
+    socket_ = NO_SOCKET;
+    peer_ = nullptr;
+    outgoing_.Clear();
+    incoming_.Clear();
+}
+
+void VersusLink::SetSimulation(unsigned latency, unsigned jitter, float lossRate)
+{
+    latency_ = latency;
+    jitter_ = jitter;
+    lossRate_ = lossRate;
+}
+
+void VersusLink::Send(const VectorBuffer& packet)
+{
+    numPacketsSent_++;
+    numBytesSent_ += packet.GetSize();
+
+    if (lossRate_ > 0.0f && Random() < lossRate_)
+    {
+        numPacketsLost_++;
+        return;
+    }
+
+    DelayedPacket delayed;
+    delayed.deliveryTime_ = Time::GetSystemTime() + latency_ + (jitter_ ? Rand() % (jitter_ + 1) : 0);
+    delayed.data_.Resize(packet.GetSize());
+    if (packet.GetSize())
+        memcpy(&delayed.data_[0], packet.GetData(), packet.GetSize());
+
+    outgoing_.Push(delayed);
+}
+
+void VersusLink::Update()
+{
+    unsigned now = Time::GetSystemTime();
+
+    // Из-за разброса задержки пакеты могут прийти не в том порядке, в котором были отправлены.
+    for (unsigned i = 0; i < outgoing_.Size();)
+    {
+        if ((int)(now - outgoing_[i].deliveryTime_) >= 0)
+        {
+            Deliver(outgoing_[i].data_);
+            outgoing_.Erase(i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void VersusLink::Deliver(const PODVector<unsigned char>& data)
+{
+    if (peer_)
+    {
+        peer_->incoming_.Push(data);
+        return;
+    }
+
+    if (!IsSocketOpen() || data.Empty())
+        return;
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(remotePort_);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    sendto(socket_, (const char*)&data[0], data.Size(), 0, (sockaddr*)&address, sizeof(address));
+}
+
+bool VersusLink::Receive(VectorBuffer& packet)
+{
+    if (!incoming_.Empty())
+    {
+        packet.SetData(&incoming_[0][0], incoming_[0].Size());
+        incoming_.Erase(0);
+        return true;
+    }
+
+    if (!IsSocketOpen())
+        return false;
+
+    unsigned char buffer[MAX_DATAGRAM_SIZE];
+    int size = (int)recvfrom(socket_, (char*)buffer, MAX_DATAGRAM_SIZE, 0, nullptr, nullptr);
+    if (size <= 0)
+        return false;
+
+    packet.SetData(buffer, (unsigned)size);
+    return true;
+}
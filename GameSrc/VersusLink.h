@@ -0,0 +1,75 @@
+/*
+Канал для обмена датаграммами с соперником в режиме "на двоих".
+
+Канал - это либо UDP-сокет на локальной машине (соперник во втором процессе),
+либо пара связанных каналов внутри одного процесса (соперник-бот).
+Доставка не гарантируется, поэтому протокол сам повторяет неподтвержденные данные
+(см. VersusSession.h). Для проверки протокола канал умеет имитировать задержку
+и потерю пакетов на отправляющей стороне.
+*/
+
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+class VersusLink
+{
+public:
+    VersusLink();
+    ~VersusLink();
+
+    // Открывает UDP-сокет на 127.0.0.1:localPort. Пакеты отправляются на 127.0.0.1:remotePort.
+    bool Open(unsigned short localPort, unsigned short remotePort);
+    // Связывает два канала внутри одного процесса.
+    static void Connect(VersusLink& first, VersusLink& second);
+    void Close();
+
+    // Задержка доставки в одну сторону (мс), ее случайный разброс (мс) и доля теряемых пакетов (0 - 1).
+    void SetSimulation(unsigned latency, unsigned jitter, float lossRate);
+
+    // Пакет отправляется не сразу, а после имитируемой задержки (см. Update).
+    void Send(const VectorBuffer& packet);
+    // Отправляет пакеты, задержка которых истекла. Вызывается каждый кадр.
+    void Update();
+    // Возвращает false, если полученных пакетов больше нет.
+    bool Receive(VectorBuffer& packet);
+
+    // Статистика для проверки объема трафика.
+    unsigned GetNumPacketsSent() const { return numPacketsSent_; }
+    unsigned GetNumPacketsLost() const { return numPacketsLost_; }
+    unsigned GetNumBytesSent() const { return numBytesSent_; }
+
+private:
+    struct DelayedPacket
+    {
+        unsigned deliveryTime_;
+        PODVector<unsigned char> data_;
+    };
+
+    // Пакеты, ожидающие окончания имитируемой задержки.
+    Vector<DelayedPacket> outgoing_;
+    // Полученные пакеты при связи внутри процесса.
+    Vector<PODVector<unsigned char> > incoming_;
+    VersusLink* peer_;
+
+    unsigned latency_;
+    unsigned jitter_;
+    float lossRate_;
+
+    unsigned numPacketsSent_;
+    unsigned numPacketsLost_;
+    unsigned numBytesSent_;
+
+#ifdef _WIN32
+    unsigned long long socket_;
+#else
+    int socket_;
+#endif
+    unsigned short remotePort_;
+
+    bool IsSocketOpen() const;
+    void Deliver(const PODVector<unsigned char>& data);
+
+    // Копирование запрещено.
+    VersusLink(const VersusLink&);
+    VersusLink& operator =(const VersusLink&);
+};
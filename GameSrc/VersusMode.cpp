@@ -0,0 +1,276 @@
+#include "VersusMode.h"
+#include "BoardLogic.h"
+#include "Urho3DAliases.h"
+#include "TraceProfiler.h"
+
+// Промежуток между досками игрока и соперника (в клетках).
+static const float VERSUS_BOARD_GAP = 2.0f;
+
+// Бот-соперник думает над ходом не дольше этого времени (мс).
+static const unsigned VERSUS_BOT_TIME_BUDGET = 5;
+
+VersusMode::VersusMode(Context* context) :
+    Object(context)
+{
+}
+
+VersusMode::~VersusMode()
+{
+    delete botSolver_;
+}
+
+bool VersusMode::Start(const String& opponent, unsigned latency, float lossRate)
+{
+    BoardLogic* boardLogic = BOARD_LOGIC;
+    bool host = true;
+
+    if (opponent == "loopback")
+    {
+        hasBot_ = true;
+        VersusLink::Connect(link_, botLink_);
+        botLink_.SetSimulation(latency, latency / 2, lossRate);
+        botSession_.Start(&botLink_, false, 0, boardLogic->GetBoardMode());
+    }
+    else
+    {
+        StringVector ports = opponent.Split(':');
+        if (ports.Size() != 2)
+        {
+            URHO3D_LOGERROR("Versus opponent must be \"loopback\" or \"<local port>:<remote port>\"");
+            return false;
+        }
+
+        unsigned localPort = ToUInt(ports[0]);
+        unsigned remotePort = ToUInt(ports[1]);
+        if (!link_.Open((unsigned short)localPort, (unsigned short)remotePort))
+        {
+            URHO3D_LOGERROR("Versus: can't open UDP port " + ports[0]);
+            return false;
+        }
+
+        host = localPort < remotePort;
+    }
+
+    // Задержка имитируется с разбросом, поэтому пакеты могут приходить не по порядку.
+    link_.SetSimulation(latency, latency / 2, lossRate);
+    session_.Start(&link_, host, boardLogic->GetRandomSeed(), boardLogic->GetBoardMode());
+
+    opponentNode_ = GLOBAL->scene_->CreateChild("OpponentBoard");
+    BoardLogic* opponentLogic = opponentNode_->CreateComponent<BoardLogic>();
+    opponentLogic->SetDriven(true);
+    opponentLogic->SetBoardMode(boardLogic->GetBoardMode());
+    opponentLogic->SetRandomSeed(boardLogic->GetRandomSeed());
+    opponentLogic->CreateBoard();
+    PlaceBoards();
+
+    active_ = true;
+
+    SubscribeToEvent(E_BOARDREADY, URHO3D_HANDLER(VersusMode, HandleBoardReady));
+    SubscribeToEvent(E_UNITPUSHED, URHO3D_HANDLER(VersusMode, HandleUnitPushed));
+    SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(VersusMode, HandlePostUpdate));
+
+    URHO3D_LOGINFO("Versus: waiting for " + opponent + (host ? String(" (host)") : String(" (guest)")));
+    return true;
+}
+
+void VersusMode::StartMatch()
+{
+    BoardMode mode = session_.GetMode();
+    unsigned seed = session_.GetSeed();
+
+    BoardLogic* boardLogic = BOARD_LOGIC;
+    boardLogic->SetBoardMode(mode);
+    boardLogic->SetRandomSeed(seed);
+    boardLogic->CreateBoard();
+
+    BoardLogic* opponentLogic = opponentNode_->GetComponent<BoardLogic>();
+    opponentLogic->SetBoardMode(mode);
+    opponentLogic->SetRandomSeed(seed);
+    opponentLogic->CreateBoard();
+
+    PlaceBoards();
+
+    started_ = true;
+    expectedVersion_ = boardLogic->GetVersion();
+    shownRemoteInputs_ = 0;
+    shownRemoteEpoch_ = session_.GetRemoteEpoch();
+    GLOBAL->neededGameState_ = GS_GAMEPLAY;
+
+    URHO3D_LOGINFO("Versus: match started, seed " + String(seed) + ", mode " + mode.ToString());
+}
+
+void VersusMode::PlaceBoards()
+{
+    BoardLogic* boardLogic = BOARD_LOGIC;
+    float offset = (boardLogic->width_ + VERSUS_BOARD_GAP) * 0.5f;
+
+    GLOBAL->boardNode_->SetPosition(Vector3(-offset, 0.0f, 0.0f));
+    opponentNode_->SetPosition(Vector3(offset, 0.0f, 0.0f));
+}
+
+Vector2 VersusMode::GetSize() const
+{
+    BoardLogic* boardLogic = BOARD_LOGIC;
+    return Vector2(boardLogic->width_ * 2 + VERSUS_BOARD_GAP, (float)boardLogic->height_);
+}
+
+void VersusMode::HandleBoardReady(StringHash eventType, VariantMap& eventData)
+{
+    if (!started_)
+        return;
+
+    // Доска игрока готова к ходу, значит все каскады завершены.
+    BOARD_LOGIC->GetState(readyState_);
+    readyScore_ = BOARD_LOGIC->score_;
+}
+
+void VersusMode::HandleUnitPushed(StringHash eventType, VariantMap& eventData)
+{
+    if (!started_ || abandoned_)
+        return;
+
+    using namespace UnitPushed;
+    IntVector2 cell(eventData[P_GRIDX].GetInt(), eventData[P_GRIDY].GetInt());
+    session_.AddLocalInput(cell, readyState_, readyScore_);
+    expectedVersion_++;
+}
+
+void VersusMode::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    GAME_PROFILE(VersusUpdate);
+
+    session_.Update();
+    UpdateBot();
+
+    if (!started_)
+    {
+        if (session_.IsConnected())
+            StartMatch();
+        return;
+    }
+
+    if (abandoned_)
+        return;
+
+    // Доску можно пересоздать из меню. Ходы после этого соперник проверить не сможет.
+    BoardLogic* boardLogic = BOARD_LOGIC;
+    if (boardLogic->GetVersion() != expectedVersion_)
+    {
+        abandoned_ = true;
+        URHO3D_LOGWARNING("Versus: board was recreated, match abandoned");
+        return;
+    }
+
+    if (!session_.IsLocalFinished() && GLOBAL->neededGameState_ == GS_GAME_OVER)
+    {
+        BoardState state;
+        boardLogic->GetState(state);
+        session_.FinishLocal(state, boardLogic->score_);
+    }
+
+    UpdateOpponentBoard();
+}
+
+void VersusMode::UpdateOpponentBoard()
+{
+    BoardLogic* opponentLogic = opponentNode_->GetComponent<BoardLogic>();
+
+    // Копия доски соперника заменена снимком: показанная доска тоже разошлась с ней.
+    if (session_.GetRemoteEpoch() != shownRemoteEpoch_)
+    {
+        shownRemoteEpoch_ = session_.GetRemoteEpoch();
+        opponentLogic->SetState(session_.GetRemoteState(), session_.GetRemoteScore());
+        shownRemoteInputs_ = session_.GetNumRemoteInputs();
+    }
+
+    if (!opponentLogic->IsReady() || shownRemoteInputs_ >= session_.GetNumRemoteInputs())
+        return;
+
+    // Ходы соперника показываются не раньше, чем он их сделал.
+    const VersusInput& input = session_.GetRemoteInput(shownRemoteInputs_);
+    if (input.time_ > session_.GetTime())
+        return;
+
+    shownRemoteInputs_++;
+    if (!input.IsFinish())
+        opponentLogic->PushUnit(input.cell_.x_, input.cell_.y_);
+}
+
+void VersusMode::UpdateBot()
+{
+    if (!hasBot_)
+        return;
+
+    botSession_.Update();
+
+    if (!botSession_.IsConnected() || botSession_.IsLocalFinished())
+        return;
+
+    if (!botStarted_)
+    {
+        botState_.Reset(botSession_.GetMode(), botSession_.GetSeed());
+        botState_.Populate(botSession_.GetMode().population_);
+        botScore_ = botState_.Settle();
+        botSolver_ = new BoardSolver(16);
+        botNextMoveTime_ = VERSUS_BOT_MOVE_INTERVAL;
+        botStarted_ = true;
+    }
+
+    if (!botSearching_)
+    {
+        if (botSession_.GetTime() < botNextMoveTime_)
+            return;
+
+        botNextMoveTime_ += VERSUS_BOT_MOVE_INTERVAL;
+
+        // Ход ищется в рабочих потоках, а кадры тем временем рисуются.
+        if (!botState_.IsGameOver())
+            botSearching_ = botSolver_->StartSearch(WORK_QUEUE, botState_, VERSUS_BOT_TIME_BUDGET, 2);
+    }
+
+    if (botSearching_)
+    {
+        // Без рабочих потоков поиск выполняется только внутри FinishSearch.
+        if (!botSolver_->IsSearchFinished() && WORK_QUEUE->GetNumThreads())
+            return;
+
+        SolverResult result = botSolver_->FinishSearch();
+        botSearching_ = false;
+        botSession_.AddLocalInput(result.cell_, botState_, botScore_);
+        botState_.Push(result.cell_.x_, result.cell_.y_);
+        botScore_ += botState_.Settle();
+    }
+
+    if (botState_.IsGameOver())
+        botSession_.FinishLocal(botState_, botScore_);
+}
+
+String VersusMode::GetStatusText() const
+{
+    if (!active_)
+        return String::EMPTY;
+
+    if (!started_)
+        return LOCALIZATION->Get("Waiting for opponent");
+
+    BoardLogic* opponentLogic = opponentNode_->GetComponent<BoardLogic>();
+    String text = LOCALIZATION->Get("Opponent") + ": " + String(opponentLogic->score_);
+
+    if (abandoned_)
+        return text + "   " + LOCALIZATION->Get("Match abandoned");
+
+    if (session_.IsFailed())
+        return text + "   " + LOCALIZATION->Get("Desync");
+
+    if (!session_.IsLocalFinished() || !session_.IsRemoteFinished())
+        return text;
+
+    int localScore = BOARD_LOGIC->score_;
+    int remoteScore = session_.GetRemoteScore();
+
+    if (localScore > remoteScore)
+        return text + "   " + LOCALIZATION->Get("You Win");
+    if (localScore < remoteScore)
+        return text + "   " + LOCALIZATION->Get("You Lose");
+    return text + "   " + LOCALIZATION->Get("Draw");
+}
@@ -0,0 +1,90 @@
+/*
+Режим "на двоих" (ключ командной строки -versus): гонка двух игроков за счет
+на одинаковых досках. Протокол описан в VersusSession.h.
+
+Слева доска игрока (основная доска), справа - доска соперника. Доска соперника
+управляемая (см. BoardLogic::SetDriven): она повторяет проверенные ходы соперника
+не раньше, чем соперник их сделал. Если копия доски соперника заменяется снимком
+из-за рассинхронизации, то доска соперника просто перестраивается по копии.
+
+Соперник может быть:
+    loopback         - бот внутри этого же процесса, связь через имитируемую сеть;
+    <порт>:<порт>    - второй процесс на этой же машине (свой UDP-порт и порт соперника).
+                       Хостом становится процесс с меньшим портом, его зерно и режим
+                       получают оба игрока.
+Ключи -latency <мс> и -packet-loss <проценты> включают имитацию плохой сети.
+
+Доска игрока перед ходом запоминается по событию E_BOARDREADY, поэтому подсистема
+должна быть создана раньше InputScript (иначе скрипт походит раньше, чем доска будет получена).
+*/
+
+#pragma once
+#include "Global.h"
+#include "VersusSession.h"
+#include "BoardSolver.h"
+
+#define VERSUS GetSubsystem<VersusMode>()
+
+// Как часто ходит бот-соперник (мс).
+#define VERSUS_BOT_MOVE_INTERVAL 1000
+
+class VersusMode : public Object
+{
+    URHO3D_OBJECT(VersusMode, Object);
+
+public:
+    VersusMode(Context* context);
+    ~VersusMode();
+
+    // opponent - "loopback" или "<свой порт>:<порт соперника>".
+    bool Start(const String& opponent, unsigned latency, float lossRate);
+    bool IsActive() const { return active_; }
+
+    // Размер обеих досок вместе в единицах сцены (для камеры).
+    Vector2 GetSize() const;
+
+    // Строка состояния матча для интерфейса.
+    String GetStatusText() const;
+
+private:
+    bool active_ = false;
+    VersusLink link_;
+    VersusSession session_;
+    WeakPtr<Node> opponentNode_;
+
+    // Матч начался (доски созданы с общим зерном).
+    bool started_ = false;
+    // Игрок пересоздал свою доску, матч прерван.
+    bool abandoned_ = false;
+    // Доска и счет игрока в момент последней готовности к ходу.
+    BoardState readyState_;
+    int readyScore_ = 0;
+    // Версия доски игрока, которая ожидается, если он не пересоздавал доску.
+    unsigned expectedVersion_ = 0;
+    // Сколько ходов соперника уже показано на его доске и после какого снимка.
+    unsigned shownRemoteInputs_ = 0;
+    unsigned shownRemoteEpoch_ = 0;
+
+    // Соперник-бот и его канал связи.
+    bool hasBot_ = false;
+    VersusLink botLink_;
+    VersusSession botSession_;
+    BoardState botState_;
+    int botScore_ = 0;
+    BoardSolver* botSolver_ = nullptr;
+    bool botStarted_ = false;
+    unsigned botNextMoveTime_ = 0;
+    // Поиск хода бота запущен и еще не забран.
+    bool botSearching_ = false;
+
+    void StartMatch();
+    void UpdateBot();
+    // Повторяет ходы соперника на его доске.
+    void UpdateOpponentBoard();
+    // Расставляет доски рядом друг с другом.
+    void PlaceBoards();
+
+    void HandleBoardReady(StringHash eventType, VariantMap& eventData);
+    void HandleUnitPushed(StringHash eventType, VariantMap& eventData);
+    void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+};
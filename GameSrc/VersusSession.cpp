@@ -0,0 +1,546 @@
+#include "VersusSession.h"
+#include "TraceProfiler.h"
+
+enum VersusPacketType
+{
+    VPT_HELLO,
+    VPT_INPUTS,
+    VPT_STATE_REQUEST,
+    VPT_STATE
+};
+
+static const unsigned char VERSUS_MAGIC = 'V';
+
+// Размеры частей пакета INPUTS в байтах: 'V', тип, подтверждение, первый ход, количество
+// и время, x, y, хеш одного хода. Пакет без ходов (только подтверждение) состоит из одного заголовка.
+static const unsigned INPUTS_HEADER_SIZE = 1 + 1 + 2 + 2 + 1;
+static const unsigned INPUT_SIZE = 4 + 1 + 1 + 4;
+
+// Размеры пакетов STATE_REQUEST и заголовка STATE: 'V', тип, номер хода (и счет, зерно).
+static const unsigned STATE_REQUEST_SIZE = 1 + 1 + 2;
+static const unsigned STATE_HEADER_SIZE = 1 + 1 + 2 + 4 + 4;
+
+// Пустая клетка в пакете STATE.
+static const unsigned char EMPTY_CELL_BYTE = 255;
+
+// Клетка маркера конца партии в пакете.
+static const unsigned char FINISH_CELL = 255;
+
+// Режим, полученный от соперника, должен быть допустимым, иначе BoardState его не примет.
+static bool IsValidMode(const BoardMode& mode)
+{
+    return mode.width_ >= MIN_BOARD_WIDTH && mode.width_ <= MAX_BOARD_WIDTH &&
+        mode.height_ >= MIN_BOARD_HEIGHT && mode.height_ <= MAX_BOARD_HEIGHT &&
+        mode.numColors_ >= MIN_NUM_COLORS && mode.numColors_ <= MAX_NUM_COLORS &&
+        mode.population_ <= BoardMode::GetMaxPopulation(mode.width_, mode.height_) &&
+        mode.lineLength_ >= MIN_LINE_LENGTH &&
+        mode.lineLength_ <= BoardMode::GetMaxLineLength(mode.width_, mode.height_);
+}
+
+VersusSession::VersusSession() :
+    link_(nullptr),
+    host_(false),
+    connected_(false),
+    seed_(0),
+    startTime_(0),
+    lastSendTime_(0),
+    peerAck_(0),
+    hasNewInputs_(false),
+    remoteScore_(0),
+    receiveEpoch_(0),
+    numDesyncs_(0),
+    lastDesyncInput_(0),
+    desyncRetries_(0),
+    resyncPending_(false),
+    resyncInput_(0),
+    lastResyncRequestTime_(0),
+    failed_(false)
+{
+}
+
+void VersusSession::Start(VersusLink* link, bool host, unsigned seed, const BoardMode& mode)
+{
+    link_ = link;
+    host_ = host;
+    connected_ = false;
+    seed_ = seed;
+    mode_ = mode;
+    lastSendTime_ = Time::GetSystemTime() - VERSUS_RESEND_INTERVAL;
+
+    localInputs_.Clear();
+    localSnapshots_.Clear();
+    peerAck_ = 0;
+    hasNewInputs_ = false;
+
+    remoteInputs_.Clear();
+    receiveEpoch_ = 0;
+    numDesyncs_ = 0;
+    desyncRetries_ = 0;
+    resyncPending_ = false;
+    failed_ = false;
+}
+
+unsigned VersusSession::GetTime() const
+{
+    return connected_ ? Time::GetSystemTime() - startTime_ : 0;
+}
+
+void VersusSession::OnConnected()
+{
+    connected_ = true;
+    startTime_ = Time::GetSystemTime();
+    RebuildRemoteState();
+
+    // Гость сразу отвечает, чтобы хост узнал о подключении.
+    hasNewInputs_ = true;
+}
+
+void VersusSession::Update()
+{
+    GAME_PROFILE(VersusSessionUpdate);
+
+    if (!link_)
+        return;
+
+    VectorBuffer packet;
+    while (link_->Receive(packet))
+        HandlePacket(packet);
+
+    unsigned elapsed = Time::GetSystemTime() - lastSendTime_;
+
+    if (!connected_)
+    {
+        if (host_ && elapsed >= VERSUS_RESEND_INTERVAL)
+            SendHello();
+    }
+    else
+    {
+        bool hasUnacked = peerAck_ < localInputs_.Size();
+        unsigned interval = hasUnacked ? VERSUS_RESEND_INTERVAL : VERSUS_KEEPALIVE_INTERVAL;
+        if (hasNewInputs_ || elapsed >= interval)
+            SendInputs();
+
+        // Запрос снимка мог потеряться.
+        if (resyncPending_ && Time::GetSystemTime() - lastResyncRequestTime_ >= VERSUS_RESEND_INTERVAL)
+            SendStateRequest();
+    }
+
+    link_->Update();
+}
+
+void VersusSession::AddLocalInput(const IntVector2& cell, const BoardState& stateBefore, int scoreBefore)
+{
+    if (!connected_ || IsLocalFinished())
+        return;
+
+    VersusInput input;
+    input.time_ = GetTime();
+    input.cell_ = cell;
+    input.hash_ = (unsigned)stateBefore.GetHash();
+    localInputs_.Push(input);
+
+    Snapshot snapshot;
+    snapshot.randomSeed_ = stateBefore.GetRandomSeed();
+    snapshot.score_ = scoreBefore;
+    for (int y = 0; y < mode_.height_; y++)
+    {
+        for (int x = 0; x < mode_.width_; x++)
+            snapshot.cells_[y * mode_.width_ + x] = (signed char)stateBefore.GetCell(x, y);
+    }
+    localSnapshots_.Push(snapshot);
+
+    hasNewInputs_ = true;
+}
+
+void VersusSession::FinishLocal(const BoardState& finalState, int finalScore)
+{
+    AddLocalInput(IntVector2(-1, -1), finalState, finalScore);
+}
+
+bool VersusSession::IsLocalFinished() const
+{
+    return !localInputs_.Empty() && localInputs_.Back().IsFinish();
+}
+
+bool VersusSession::IsRemoteFinished() const
+{
+    return !remoteInputs_.Empty() && remoteInputs_.Back().IsFinish();
+}
+
+void VersusSession::SendHello()
+{
+    VectorBuffer packet;
+    packet.WriteUByte(VERSUS_MAGIC);
+    packet.WriteUByte(VPT_HELLO);
+    packet.WriteUInt(seed_);
+    packet.WriteUInt(mode_.Pack());
+
+    link_->Send(packet);
+    lastSendTime_ = Time::GetSystemTime();
+}
+
+void VersusSession::SendInputs()
+{
+    unsigned first = Min(peerAck_, localInputs_.Size());
+    unsigned count = Min(localInputs_.Size() - first, (unsigned)VERSUS_MAX_INPUTS_PER_PACKET);
+
+    VectorBuffer packet;
+    packet.WriteUByte(VERSUS_MAGIC);
+    packet.WriteUByte(VPT_INPUTS);
+    packet.WriteUShort((unsigned short)remoteInputs_.Size());
+    packet.WriteUShort((unsigned short)first);
+    packet.WriteUByte((unsigned char)count);
+
+    for (unsigned i = first; i < first + count; i++)
+    {
+        const VersusInput& input = localInputs_[i];
+        packet.WriteUInt(input.time_);
+        packet.WriteUByte(input.IsFinish() ? FINISH_CELL : (unsigned char)input.cell_.x_);
+        packet.WriteUByte(input.IsFinish() ? FINISH_CELL : (unsigned char)input.cell_.y_);
+        packet.WriteUInt(input.hash_);
+    }
+
+    link_->Send(packet);
+    lastSendTime_ = Time::GetSystemTime();
+    hasNewInputs_ = false;
+}
+
+void VersusSession::SendStateRequest()
+{
+    VectorBuffer packet;
+    packet.WriteUByte(VERSUS_MAGIC);
+    packet.WriteUByte(VPT_STATE_REQUEST);
+    packet.WriteUShort((unsigned short)resyncInput_);
+
+    link_->Send(packet);
+    lastResyncRequestTime_ = Time::GetSystemTime();
+}
+
+void VersusSession::SendState(unsigned inputIndex)
+{
+    const Snapshot& snapshot = localSnapshots_[inputIndex];
+
+    VectorBuffer packet;
+    packet.WriteUByte(VERSUS_MAGIC);
+    packet.WriteUByte(VPT_STATE);
+    packet.WriteUShort((unsigned short)inputIndex);
+    packet.WriteInt(snapshot.score_);
+    packet.WriteUInt(snapshot.randomSeed_);
+
+    for (int i = 0; i < mode_.width_ * mode_.height_; i++)
+        packet.WriteUByte(snapshot.cells_[i] == EMPTY_CELL ? EMPTY_CELL_BYTE : (unsigned char)snapshot.cells_[i]);
+
+    link_->Send(packet);
+}
+
+void VersusSession::HandlePacket(VectorBuffer& packet)
+{
+    if (packet.GetSize() < 2 || packet.ReadUByte() != VERSUS_MAGIC)
+        return;
+
+    unsigned type = packet.ReadUByte();
+
+    if (type == VPT_HELLO)
+    {
+        // Повторные приветствия приходят, пока хост не получил ответ.
+        if (host_ || connected_ || packet.GetSize() < 10)
+            return;
+
+        unsigned seed = packet.ReadUInt();
+        BoardMode mode = BoardMode::Unpack(packet.ReadUInt());
+        if (!IsValidMode(mode))
+        {
+            URHO3D_LOGERROR("Versus: invalid board mode from host");
+            return;
+        }
+
+        seed_ = seed;
+        mode_ = mode;
+        OnConnected();
+    }
+    else if (type == VPT_INPUTS)
+    {
+        if (!connected_)
+        {
+            // Гость не может получить ходы раньше приветствия.
+            if (!host_)
+                return;
+            OnConnected();
+        }
+
+        HandleInputs(packet);
+    }
+    else if (type == VPT_STATE_REQUEST)
+    {
+        if (connected_)
+            HandleStateRequest(packet);
+    }
+    else if (type == VPT_STATE)
+    {
+        if (connected_)
+            HandleState(packet);
+    }
+}
+
+void VersusSession::HandleInputs(VectorBuffer& packet)
+{
+    if (packet.GetSize() < INPUTS_HEADER_SIZE)
+        return;
+
+    // Пакеты могут приходить не по порядку, а принятые ходы никогда не отбрасываются.
+    unsigned ack = packet.ReadUShort();
+    peerAck_ = Min(Max(peerAck_, ack), localInputs_.Size());
+
+    // Пока нет снимка, ходы применять не к чему. Соперник повторит их позже.
+    if (resyncPending_)
+        return;
+
+    unsigned first = packet.ReadUShort();
+    unsigned count = packet.ReadUByte();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (packet.GetSize() - packet.GetPosition() < INPUT_SIZE)
+            return;
+
+        VersusInput input;
+        input.time_ = packet.ReadUInt();
+        int x = packet.ReadUByte();
+        int y = packet.ReadUByte();
+        input.cell_ = x == FINISH_CELL ? IntVector2(-1, -1) : IntVector2(x, y);
+        input.hash_ = packet.ReadUInt();
+
+        unsigned index = first + i;
+
+        // Уже принятый ход.
+        if (index < remoteInputs_.Size())
+            continue;
+
+        // Пропуск: более ранние ходы придут в следующих пакетах.
+        if (index > remoteInputs_.Size() || failed_ || IsRemoteFinished())
+            return;
+
+        if (!ApplyRemoteInput(input))
+            return;
+
+        // Соперник перестанет повторять ход, как только узнает о приеме.
+        hasNewInputs_ = true;
+    }
+}
+
+void VersusSession::HandleStateRequest(VectorBuffer& packet)
+{
+    if (packet.GetSize() < STATE_REQUEST_SIZE)
+        return;
+
+    unsigned inputIndex = packet.ReadUShort();
+    if (inputIndex >= localSnapshots_.Size())
+        return;
+
+    SendState(inputIndex);
+
+    // Ходы после снимка нужны сопернику сразу, не дожидаясь интервала повтора.
+    hasNewInputs_ = true;
+}
+
+void VersusSession::HandleState(VectorBuffer& packet)
+{
+    int numCells = mode_.width_ * mode_.height_;
+    if (packet.GetSize() < STATE_HEADER_SIZE + (unsigned)numCells)
+        return;
+
+    // Повторные снимки приходят, если запрос был отправлен несколько раз.
+    unsigned inputIndex = packet.ReadUShort();
+    if (!resyncPending_ || inputIndex != resyncInput_ || inputIndex != remoteInputs_.Size())
+        return;
+
+    int score = packet.ReadInt();
+    unsigned randomSeed = packet.ReadUInt();
+
+    remoteState_.Reset(mode_, randomSeed);
+    for (int i = 0; i < numCells; i++)
+    {
+        int color = packet.ReadUByte();
+        if (color == EMPTY_CELL_BYTE)
+            continue;
+
+        if (color >= mode_.numColors_)
+        {
+            URHO3D_LOGERROR("Versus: invalid board snapshot from opponent");
+            failed_ = true;
+            return;
+        }
+
+        remoteState_.SetCell(i % mode_.width_, i / mode_.width_, color);
+    }
+
+    remoteScore_ = score;
+    resyncPending_ = false;
+    receiveEpoch_++;
+
+    URHO3D_LOGINFO("Versus: board resynchronized at move " + String(inputIndex));
+}
+
+bool VersusSession::ApplyRemoteInput(const VersusInput& input)
+{
+    unsigned index = remoteInputs_.Size();
+
+    // Доска перед ходом отличается (или сам ход недопустим), значит копия уже разошлась с доской соперника.
+    if (input.hash_ != (unsigned)remoteState_.GetHash() ||
+        (input.IsFinish() ? !remoteState_.IsGameOver() : !remoteState_.Push(input.cell_.x_, input.cell_.y_)))
+    {
+        RequestState(index);
+        return false;
+    }
+
+    if (!input.IsFinish())
+        remoteScore_ += remoteState_.Settle();
+
+    remoteInputs_.Push(input);
+    return true;
+}
+
+void VersusSession::RequestState(unsigned inputIndex)
+{
+    numDesyncs_++;
+
+    if (inputIndex == lastDesyncInput_)
+        desyncRetries_++;
+    else
+        desyncRetries_ = 1;
+    lastDesyncInput_ = inputIndex;
+
+    if (desyncRetries_ > VERSUS_MAX_DESYNC_RETRIES)
+    {
+        URHO3D_LOGERROR("Versus: unrecoverable desync at move " + String(inputIndex));
+        failed_ = true;
+        return;
+    }
+
+    URHO3D_LOGWARNING("Versus: desync at move " + String(inputIndex) + ", requesting board snapshot");
+
+    resyncPending_ = true;
+    resyncInput_ = inputIndex;
+    SendStateRequest();
+}
+
+void VersusSession::RebuildRemoteState()
+{
+    remoteState_.Reset(mode_, seed_);
+    remoteState_.Populate(mode_.population_);
+    remoteScore_ = remoteState_.Settle();
+
+    foreach(const VersusInput& input, remoteInputs_)
+    {
+        if (!input.IsFinish())
+        {
+            remoteState_.Push(input.cell_.x_, input.cell_.y_);
+            remoteScore_ += remoteState_.Settle();
+        }
+    }
+}
+
+bool VersusSession::SelfTest()
+{
+    BoardMode mode;
+    mode.FromString("w6h6c6p8l3d1");
+
+    VersusLink hostLink;
+    VersusLink guestLink;
+    VersusLink::Connect(hostLink, guestLink);
+
+    VersusSession host;
+    VersusSession guest;
+    host.Start(&hostLink, true, 1, mode);
+    guest.Start(&guestLink, false, 0, BoardMode());
+
+    // Задержки нет, поэтому каждый Update доставляет пакеты соперника без ожидания.
+    host.Update();
+    guest.Update();
+    host.Update();
+    if (!host.IsConnected() || !guest.IsConnected())
+    {
+        URHO3D_LOGERROR("Versus self-test: sessions are not connected");
+        return false;
+    }
+
+    // Первый допустимый ход на доске хоста.
+    BoardState state;
+    state.Reset(mode, host.GetSeed());
+    state.Populate(mode.population_);
+    int score = state.Settle();
+
+    IntVector2 pushes[MAX_BORDER_CELLS];
+    if (state.GetPushes(pushes) == 0)
+    {
+        URHO3D_LOGERROR("Versus self-test: no valid move");
+        return false;
+    }
+
+    // Гость принимает ход и сразу подтверждает его пакетом без ходов (своих ходов у него нет).
+    host.AddLocalInput(pushes[0], state, score);
+    host.Update();
+    unsigned bytesBefore = guestLink.GetNumBytesSent();
+    guest.Update();
+    if (guest.GetNumRemoteInputs() != 1)
+    {
+        URHO3D_LOGERROR("Versus self-test: guest did not accept the input");
+        return false;
+    }
+
+    if (guestLink.GetNumBytesSent() - bytesBefore != INPUTS_HEADER_SIZE)
+    {
+        URHO3D_LOGERROR("Versus self-test: unexpected size of an empty INPUTS packet");
+        return false;
+    }
+
+    host.Update();
+    if (host.GetNumLocalAcked() != 1)
+    {
+        URHO3D_LOGERROR("Versus self-test: acknowledgement without inputs was dropped");
+        return false;
+    }
+
+    // Доска хоста после хода отличается от копии у гостя одной клеткой,
+    // как будто логика соперников по-разному обработала ход.
+    state.Push(pushes[0].x_, pushes[0].y_);
+    score += state.Settle();
+    for (int i = 0; i < mode.width_ * mode.height_; i++)
+    {
+        int color = state.GetCell(i % mode.width_, i / mode.width_);
+        if (color != EMPTY_CELL)
+        {
+            state.SetCell(i % mode.width_, i / mode.width_, (color + 1) % mode.numColors_);
+            break;
+        }
+    }
+
+    if (state.GetPushes(pushes) == 0)
+    {
+        URHO3D_LOGERROR("Versus self-test: no valid second move");
+        return false;
+    }
+
+    // Гость видит чужой хеш, запрашивает снимок, получает его и принимает тот же ход.
+    host.AddLocalInput(pushes[0], state, score);
+    host.Update();
+    guest.Update();
+    host.Update();
+    guest.Update();
+    if (guest.GetNumRemoteInputs() != 2 || guest.GetNumDesyncs() != 1 || guest.GetRemoteEpoch() != 1 || guest.IsFailed())
+    {
+        URHO3D_LOGERROR("Versus self-test: desync was not repaired by a board snapshot");
+        return false;
+    }
+
+    state.Push(pushes[0].x_, pushes[0].y_);
+    score += state.Settle();
+    if (guest.GetRemoteState().GetHash() != state.GetHash() || guest.GetRemoteScore() != score)
+    {
+        URHO3D_LOGERROR("Versus self-test: opponent board differs after resync");
+        return false;
+    }
+
+    URHO3D_LOGINFO("Versus self-test passed");
+    return true;
+}
@@ -0,0 +1,167 @@
+/*
+Протокол режима "на двоих": гонка на одинаковых досках.
+
+Оба игрока получают одинаковые доски (общие зерно и режим), а потом каждый играет
+на своей доске. Игровая логика детерминирована (см. BoardState.h), поэтому соперникам
+достаточно обмениваться только своими ходами: каждый участник сам проигрывает ходы
+соперника на копии его доски. Состояние доски передается только при рассинхронизации.
+
+Ход соперника - это клетка толчка, время хода от начала матча и 32 бита хеша доски
+перед ходом. Копия доски применяет ходы строго по порядку (lockstep) и перед каждым
+ходом сверяет свой хеш с присланным. Последний ход игрока - маркер конца партии
+с хешем итоговой доски.
+
+Пакеты (все числа little-endian):
+    HELLO:  'V', 0, зерно (u32), упакованный режим (u32)
+    INPUTS: 'V', 1, количество принятых ходов соперника (u16),
+            номер первого хода (u16), количество ходов (u8),
+            ходы: время (u32), x (u8), y (u8), хеш (u32)
+    STATE_REQUEST: 'V', 2, номер хода (u16)
+    STATE:  'V', 3, номер хода (u16), счет (i32), зерно генератора (u32),
+            цвета клеток по строкам (u8, 255 - пустая клетка)
+Каждый пакет INPUTS повторяет все ходы, которые соперник еще не подтвердил (но не
+больше VERSUS_MAX_INPUTS_PER_PACKET), поэтому потерянный пакет не требует
+отдельного запроса: следующий пакет содержит те же ходы.
+
+Рассинхронизация (хеш не совпал или ход недопустим) означает, что копия доски
+уже отличается от доски соперника, и повтор тех же ходов ее не исправит. Поэтому
+копия запрашивает у соперника снимок его доски перед этим ходом (STATE_REQUEST,
+повторяется, пока не придет STATE), заменяет им свое состояние и продолжает
+принимать ходы с того же места. Для этого каждый участник хранит снимки своей
+доски перед каждым своим ходом.
+
+Хост (сторона, которая начинает матч) рассылает HELLO, пока не получит ответ.
+Гость принимает зерно и режим хоста и отвечает пакетами INPUTS.
+*/
+
+#pragma once
+#include "BoardState.h"
+#include "VersusLink.h"
+
+// Сколько ходов помещается в один пакет.
+#define VERSUS_MAX_INPUTS_PER_PACKET 16
+
+// Интервал повтора неподтвержденных ходов и пакетов HELLO (мс).
+#define VERSUS_RESEND_INTERVAL 50
+
+// Интервал пакетов без новых данных, которые только подтверждают прием (мс).
+#define VERSUS_KEEPALIVE_INTERVAL 250
+
+// Сколько раз подряд можно синхронизироваться на одном и том же ходе.
+// Если не помогает даже снимок доски, то соперники по-разному применяют сам ход.
+#define VERSUS_MAX_DESYNC_RETRIES 3
+
+// Ход одного из соперников.
+struct VersusInput
+{
+    // Время хода в миллисекундах от начала матча.
+    unsigned time_;
+    // Клетка толчка. (-1, -1) - маркер конца партии.
+    IntVector2 cell_;
+    // Младшие 32 бита хеша доски перед ходом.
+    unsigned hash_;
+
+    bool IsFinish() const { return cell_.x_ < 0; }
+};
+
+class VersusSession
+{
+public:
+    VersusSession();
+
+    // Хост сразу знает зерно и режим, гость получит их от хоста.
+    void Start(VersusLink* link, bool host, unsigned seed, const BoardMode& mode);
+    // Обрабатывает полученные пакеты и отправляет свои. Вызывается каждый кадр.
+    void Update();
+
+    // Соперники обменялись приветствиями, зерно и режим известны обоим.
+    bool IsConnected() const { return connected_; }
+    unsigned GetSeed() const { return seed_; }
+    const BoardMode& GetMode() const { return mode_; }
+    // Миллисекунды от начала матча.
+    unsigned GetTime() const;
+
+    // Ход игрока. stateBefore и scoreBefore - доска и счет игрока перед ходом
+    // (снимок отправляется сопернику при рассинхронизации).
+    void AddLocalInput(const IntVector2& cell, const BoardState& stateBefore, int scoreBefore);
+    // Партия игрока закончена. finalState и finalScore - итоговая доска и счет.
+    void FinishLocal(const BoardState& finalState, int finalScore);
+    bool IsLocalFinished() const;
+    unsigned GetNumLocalInputs() const { return localInputs_.Size(); }
+    // Сколько ходов игрока соперник подтвердил.
+    unsigned GetNumLocalAcked() const { return peerAck_; }
+
+    // Ходы соперника, уже проверенные и примененные к копии его доски.
+    unsigned GetNumRemoteInputs() const { return remoteInputs_.Size(); }
+    const VersusInput& GetRemoteInput(unsigned index) const { return remoteInputs_[index]; }
+    bool IsRemoteFinished() const;
+    // Копия доски соперника после всех принятых ходов.
+    const BoardState& GetRemoteState() const { return remoteState_; }
+    int GetRemoteScore() const { return remoteScore_; }
+
+    // Увеличивается каждый раз, когда копия доски соперника заменяется снимком.
+    unsigned GetRemoteEpoch() const { return receiveEpoch_; }
+    unsigned GetNumDesyncs() const { return numDesyncs_; }
+    // Логика соперников разошлась, и снимок доски не помог.
+    bool IsFailed() const { return failed_; }
+
+    // Проводит два сеанса через связанные каналы (только через пакеты) и проверяет,
+    // что ход доходит до гостя, подтверждение без ходов доходит до хоста,
+    // а расхождение досок исправляется снимком.
+    static bool SelfTest();
+
+private:
+    VersusLink* link_;
+    bool host_;
+    bool connected_;
+    unsigned seed_;
+    BoardMode mode_;
+    unsigned startTime_;
+    unsigned lastSendTime_;
+
+    // Доска и счет игрока перед ходом.
+    struct Snapshot
+    {
+        unsigned randomSeed_;
+        int score_;
+        signed char cells_[MAX_BOARD_CELLS];
+    };
+
+    PODVector<VersusInput> localInputs_;
+    // Снимки доски игрока перед каждым его ходом (в том же порядке).
+    PODVector<Snapshot> localSnapshots_;
+    // Сколько ходов игрока подтвердил соперник.
+    unsigned peerAck_;
+    // Есть ходы, которые еще ни разу не отправлялись, или новое подтверждение.
+    bool hasNewInputs_;
+
+    PODVector<VersusInput> remoteInputs_;
+    BoardState remoteState_;
+    int remoteScore_;
+    unsigned receiveEpoch_;
+    unsigned numDesyncs_;
+    // Ход, на котором произошла последняя рассинхронизация, и сколько раз подряд.
+    unsigned lastDesyncInput_;
+    unsigned desyncRetries_;
+    // Копия ждет снимок доски соперника перед ходом resyncInput_ и пока не принимает ходы.
+    bool resyncPending_;
+    unsigned resyncInput_;
+    unsigned lastResyncRequestTime_;
+    bool failed_;
+
+    void OnConnected();
+    void HandlePacket(VectorBuffer& packet);
+    void HandleInputs(VectorBuffer& packet);
+    void HandleStateRequest(VectorBuffer& packet);
+    void HandleState(VectorBuffer& packet);
+    // Проверяет ход соперника и применяет его к копии доски. Возвращает false при рассинхронизации.
+    bool ApplyRemoteInput(const VersusInput& input);
+    // Запрашивает снимок доски соперника перед ходом с указанным номером.
+    void RequestState(unsigned inputIndex);
+    // Заново проигрывает копию доски соперника с начала партии.
+    void RebuildRemoteState();
+    void SendHello();
+    void SendInputs();
+    void SendStateRequest();
+    void SendState(unsigned inputIndex);
+};